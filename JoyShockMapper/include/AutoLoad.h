@@ -1,6 +1,8 @@
 #pragma once
 #include "InputHelpers.h"
 
+#include <unordered_map>
+
 class CmdRegistry;
 
 
@@ -12,10 +14,19 @@ class AutoLoad : public PollingThread
 public:
 	AutoLoad(CmdRegistry* commandRegistry, bool start);
 
-	virtual ~AutoLoad() = default;
+	virtual ~AutoLoad();
 
 private:
 	bool AutoLoadPoll(void* param);
+
+	// Returns the file name of the profile matching the module, or an empty string
+	string findProfile(const string& noextmodule);
+
+	string _lastModuleName;
+	bool _firstPoll = true;
+	string _folder;
+	unique_ptr<DirectoryWatcher> _folderWatcher;
+	unordered_map<string, string> _profiles; // lower case name without extension -> file name
 };
 
-} //JSM
\ No newline at end of file
+} //JSM
@@ -0,0 +1,24 @@
+#pragma once
+#include "InputHelpers.h"
+
+class CmdRegistry;
+
+
+namespace JSM
+{
+
+// Watches the configuration files that were loaded, nested ones included. When one is saved,
+// only the assignments that changed in it are run again, so nothing else gets reset.
+class AutoReload : public PollingThread
+{
+public:
+	AutoReload(CmdRegistry* commandRegistry, bool start);
+	virtual ~AutoReload();
+
+private:
+	bool AutoReloadPoll(void* param);
+	CmdRegistry* _commandRegistry;
+	FileWatcher _watcher;
+};
+
+} //JSM
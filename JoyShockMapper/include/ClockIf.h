@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+// Where the mapping pipeline reads the time of each tick from. Hold, tap, turbo, flick and smoothing timings
+// all derive from it, so a simulated clock makes recorded input play back deterministically and as fast as it can be fed.
+class ClockIf
+{
+public:
+	using TimePoint = std::chrono::steady_clock::time_point;
+	using Duration = std::chrono::steady_clock::duration;
+
+	virtual ~ClockIf() = default;
+
+	virtual TimePoint now() const = 0;
+};
+
+// The real time
+class SteadyClock : public ClockIf
+{
+public:
+	TimePoint now() const override
+	{
+		return std::chrono::steady_clock::now();
+	}
+};
+
+// Time only moves when told to. Starts at an arbitrary non zero time, since a zero time point means "never" in places.
+class SimulatedClock : public ClockIf
+{
+public:
+	TimePoint now() const override
+	{
+		return TimePoint(Duration(_ticks.load(std::memory_order_acquire)));
+	}
+
+	void advance(Duration duration)
+	{
+		_ticks.fetch_add(duration.count(), std::memory_order_acq_rel);
+	}
+
+	void set(TimePoint time)
+	{
+		_ticks.store(time.time_since_epoch().count(), std::memory_order_release);
+	}
+
+private:
+	std::atomic<Duration::rep> _ticks = std::chrono::duration_cast<Duration>(std::chrono::hours(1)).count();
+};
@@ -2,10 +2,18 @@
 
 #include "JoyShockMapper.h"
 
+#include <atomic>
+#include <filesystem>
 #include <functional>
+#include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string_view>
+#include <vector>
+
+class JSMVariableBase;
+struct FrozenVariable;
 
 // This is a base class for any Command line operation. It binds a command name to a parser function
 // Derivatives from this class have a default parser function and performs specific operations.
@@ -32,6 +40,9 @@ protected:
 	// Some task to perform when this object is destroyed
 	TaskOnDestruction _taskOnDestruction;
 
+	// Whether the last call to parseData() could not do what was asked
+	bool _failed = false;
+
 public:
 	// Name of the command. Cannot be changed after construction.
 	// I don't mind leaving this public since it can't be changed.
@@ -67,6 +78,18 @@ public:
 
 	// Request this command to parse the command arguments. Returns true if the command was processed.
 	virtual bool parseData(string_view arguments, string_view label);
+
+	// Whether the command was processed but reported an error, like an invalid value
+	inline bool hasFailed() const
+	{
+		return _failed;
+	}
+
+	// The variable the command assigns, if it is an assignment
+	virtual const JSMVariableBase* variable() const
+	{
+		return nullptr;
+	}
 };
 
 // The command registry holds all JSMCommands object and should not care what the derived type is.
@@ -77,6 +100,19 @@ public:
 // commands until one returns true. This can enable multiple parsers for the same command.
 class CmdRegistry
 {
+public:
+	// The settings and bindings that loading config files builds
+	class ConfigStateIf
+	{
+	public:
+		virtual ~ConfigStateIf() = default;
+
+		// Make the current state the one that was captured
+		virtual void restore() const = 0;
+	};
+
+	typedef function<shared_ptr<const ConfigStateIf>()> CaptureDelegate;
+
 private:
 	typedef multimap<string_view, unique_ptr<JSMCommand>> CmdMap;
 
@@ -87,12 +123,71 @@ private:
 
 	static bool findCommandWithName(string_view name, const CmdMap::value_type& pair);
 
+	// The line of an assignment, numbered in the order assignments were processed, across all the files
+	struct Assignment
+	{
+		string line;
+		uint64_t sequence = 0;
+	};
+
+	// A file loaded since the last reset, with the last assignment of each setting or binding it made
+	struct LoadedFile
+	{
+		string path;
+		uint64_t start = 0;                    // Sequence number of the last assignment processed before the file
+		vector<pair<string, uint64_t>> lines; // Its commands, with the sequence number of the last assignment processed once each was done
+		map<string, Assignment> assignments;
+	};
+
+	// In the order they finished loading, so a nested file comes before the one that loads it. Read by the AUTORELOAD thread.
+	vector<LoadedFile> _loadedFiles;
+	mutable mutex _loadedFilesLock;
+	atomic<uint64_t> _assignmentSequence = 0; // Of the last assignment processed
+
+	// Tells if the line assigns a setting or binding, and which
+	static bool assignmentKey(string_view line, string& key);
+
+	// A file that resets and then only assigns settings and bindings builds the same state every time, as
+	// long as none of the files it loads changes. The last few of them are kept, to restore that state
+	// rather than process the files again.
+	struct CachedFile
+	{
+		string path;
+		vector<pair<string, filesystem::file_time_type>> sources; // The files it loaded, with their time of modification
+		vector<pair<SettingID, shared_ptr<const FrozenVariable>>> keptSettings; // A reset leaves them alone, but the files can depend on them
+		vector<LoadedFile> loadedFiles;
+		shared_ptr<const ConfigStateIf> state;
+	};
+
+	static constexpr size_t MAX_CACHED_FILES = 4;
+	list<CachedFile> _cachedFiles; // Most recently used first
+	CaptureDelegate _captureState;
+	int _loadDepth = 0;
+	int _resetCount = 0;     // Number of clearLoadedFiles() calls, which RESET_MAPPINGS makes
+	bool _cacheable = false; // Whether the lines of the file being loaded only reset and assign
+
+	bool restoreCachedFile(const string& path);
+
+	void cacheFile(const string& path);
+
 public:
 	CmdRegistry();
 
 	// Not string_view because the string is modified inside
 	bool loadConfigFile(string fileName);
 
+	// Paths of the files loaded since the last call to clearLoadedFiles(), nested ones included
+	vector<string> getLoadedFiles() const;
+
+	void clearLoadedFiles();
+
+	// Without a capture, files are always processed line by line
+	void setStateCapture(CaptureDelegate capture);
+
+	// Read a loaded file again and return the lines of the assignments that changed since it was last read.
+	// Assignments that another file made later are left out, since they don't make the current state.
+	vector<string> getChangedAssignments(string_view path);
+
 	// Add a command to the registry. The regisrty takes ownership of the memory of this pointer.
 	// You can use _ASSERT() on the return value of this function to make sure the commands are
 	// accepted.
@@ -104,15 +199,18 @@ public:
 
 	bool isCommandValid(string_view line) const;
 
-	// Process a command entered by the user
+	// Process a command entered by the user. Returns false if the command is unknown or failed.
 	// intentionally dont't use const ref
-	void processLine(const string& line);
+	bool processLine(const string& line);
 
 	// Fill vector with registered command names
 	void GetCommandList(vector<string_view>& outList) const;
 
 	// Return help string for provided command
 	string_view GetHelp(string_view command) const;
+
+	// Return the variable the command assigns, or nullptr if it is not an assignment
+	const JSMVariableBase* GetVariable(string_view command) const;
 };
 
 // Macro commands are simple function calls when recognized. But it could do different things
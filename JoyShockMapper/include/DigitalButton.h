@@ -4,6 +4,7 @@
 #include "JoyShockMapper.h"
 #include "Gamepad.h"
 #include "MotionIf.h"
+#include "ClockIf.h"
 #include <chrono>
 #include <deque>
 #include <mutex>
@@ -13,6 +14,7 @@ class JSMButton;
 class DigitalButton;      // Finite State Machine
 struct DigitalButtonImpl; // Button implementation
 class MapIterator;
+class SettingsSnapshot;
 
 // The enum values match the concrete class names
 enum class BtnState
@@ -119,7 +121,7 @@ public:
 	// It enables the _buttons to synchronize and be aware of the state of the whole controller, access gyro etc...
 	struct Context
 	{
-		Context(Gamepad::Callback virtualControllerCallback, shared_ptr<MotionIf> mainMotion);
+		Context(Gamepad::Callback virtualControllerCallback, shared_ptr<MotionIf> mainMotion, shared_ptr<ClockIf> clock);
 		deque<pair<ButtonID, KeyCode>> gyroActionQueue; // Queue of gyro control actions currently in effect
 		deque<pair<ButtonID, KeyCode>> activeTogglesQueue;
 		deque<ButtonID> chordStack; // Represents the current active _buttons in order from most recent to latest
@@ -130,6 +132,8 @@ public:
 		mutex callback_lock;                                    // Needs to be in the common struct for both joycons to use the same
 		shared_ptr<MotionIf> rightMainMotion = nullptr;
 		shared_ptr<MotionIf> leftMotion = nullptr;
+		shared_ptr<ClockIf> clock; // Time source of the controller ticks
+		shared_ptr<const SettingsSnapshot> settings; // Settings and bindings of the current tick, same as JoyShock::_settings
 		int nn = 0;
 
 		void updateChordStack(bool isPressed, ButtonID index);
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "JslWrapper.h"
+#include "TriggerEffectGenerator.h"
+
+#include <cstdint>
+
+// Output report of the DualSense carrying rumble, trigger effects and lights, shared by the backends that talk to it directly.
+
+typedef struct
+{
+	uint8_t ucEnableBits1;              /* 0 */
+	uint8_t ucEnableBits2;              /* 1 */
+	uint8_t ucRumbleRight;              /* 2 */
+	uint8_t ucRumbleLeft;               /* 3 */
+	uint8_t ucHeadphoneVolume;          /* 4 */
+	uint8_t ucSpeakerVolume;            /* 5 */
+	uint8_t ucMicrophoneVolume;         /* 6 */
+	uint8_t ucAudioEnableBits;          /* 7 */
+	uint8_t ucMicLightMode;             /* 8 */
+	uint8_t ucAudioMuteBits;            /* 9 */
+	uint8_t rgucRightTriggerEffect[11]; /* 10 */
+	uint8_t rgucLeftTriggerEffect[11];  /* 21 */
+	uint8_t rgucUnknown1[6];            /* 32 */
+	uint8_t ucLedFlags;                 /* 38 */
+	uint8_t rgucUnknown2[2];            /* 39 */
+	uint8_t ucLedAnim;                  /* 41 */
+	uint8_t ucLedBrightness;            /* 42 */
+	uint8_t ucPadLights;                /* 43 */
+	uint8_t ucLedRed;                   /* 44 */
+	uint8_t ucLedGreen;                 /* 45 */
+	uint8_t ucLedBlue;                  /* 46 */
+} DS5EffectsState_t;
+
+// Write the adaptive trigger setting in the format of the DualSense
+inline void LoadTriggerEffect(uint8_t *rgucTriggerEffect, const AdaptiveTriggerSetting *trigger_effect)
+{
+	using namespace ExtendInput::DataTools::DualSense;
+	rgucTriggerEffect[0] = (uint8_t)trigger_effect->mode;
+	switch (trigger_effect->mode)
+	{
+	case AdaptiveTriggerMode::RESISTANCE_RAW:
+	{
+		TriggerEffectGenerator::Simple_Feedback(rgucTriggerEffect, 0, trigger_effect->start, trigger_effect->force);
+	}
+	break;
+	case AdaptiveTriggerMode::SEGMENT:
+		rgucTriggerEffect[1] = trigger_effect->start;
+		rgucTriggerEffect[2] = trigger_effect->end;
+		rgucTriggerEffect[3] = trigger_effect->force;
+		break;
+	case AdaptiveTriggerMode::RESISTANCE:
+		TriggerEffectGenerator::Feedback(rgucTriggerEffect, 0, trigger_effect->start, trigger_effect->force);
+		break;
+	case AdaptiveTriggerMode::BOW:
+		TriggerEffectGenerator::Bow(rgucTriggerEffect, 0, trigger_effect->start, trigger_effect->end, trigger_effect->force, trigger_effect->forceExtra);
+		break;
+	case AdaptiveTriggerMode::GALLOPING:
+		TriggerEffectGenerator::Galloping(rgucTriggerEffect, 0, trigger_effect->start, trigger_effect->end, trigger_effect->force, trigger_effect->forceExtra, trigger_effect->frequency);
+		break;
+    case AdaptiveTriggerMode::SEMI_AUTOMATIC:
+		TriggerEffectGenerator::Simple_Weapon(rgucTriggerEffect, 0, trigger_effect->start, trigger_effect->end, trigger_effect->force);
+		break;
+	case AdaptiveTriggerMode::AUTOMATIC:
+		TriggerEffectGenerator::Simple_Vibration(rgucTriggerEffect, 0, trigger_effect->start, trigger_effect->force, trigger_effect->frequency);
+		break;
+	case AdaptiveTriggerMode::MACHINE:
+		TriggerEffectGenerator::Machine(rgucTriggerEffect, 0, trigger_effect->start, trigger_effect->end, trigger_effect->force, trigger_effect->forceExtra, trigger_effect->frequency, trigger_effect->frequencyExtra);
+		break;
+	default:
+		rgucTriggerEffect[0] = 0x05; // no effect
+	}
+}
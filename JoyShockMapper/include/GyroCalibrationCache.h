@@ -0,0 +1,45 @@
+#pragma once
+
+#include "JoyShockMapper.h"
+#include "MotionIf.h"
+
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+// Remembers the gyro calibration of each controller across reconnections and restarts, so gyro
+// aiming is usable right away instead of after the calibration settles again.
+// Controllers are identified by the string given by JslWrapper::GetControllerIdentity().
+class GyroCalibrationCache
+{
+public:
+	GyroCalibrationCache() = default;
+
+	// Read the calibrations saved in the file, which will also be the one written by save()
+	void load(string_view path);
+
+	// Give the saved calibration of the controller to its motion, if there is one
+	bool restore(string_view identity, MotionIf &motion) const;
+
+	// Remember the current calibration of the controller
+	void store(string_view identity, MotionIf &motion);
+
+	// Write the calibrations to the file if any changed
+	void save();
+
+private:
+	struct Offsets
+	{
+		float x = 0.f;
+		float y = 0.f;
+		float z = 0.f;
+	};
+
+	// How many calibration samples a restored offset is worth. Low enough that a new calibration takes over quickly.
+	static constexpr int RESTORED_WEIGHT = 100;
+
+	string _path;
+	unordered_map<string, Offsets> _offsets;
+	bool _dirty = false;
+	mutable mutex _lock;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "JoyShockMapper.h"
+
+#include <span>
+
+// Turns the calibrated gyro of the controller into rotation speeds around the mouse axes, according to GYRO_SPACE.
+// The axes derived from gravity are cached and only computed again when gravity moves noticeably,
+// so most ticks only cost a 2x3 matrix product.
+class GyroSpaceTransform
+{
+public:
+	// Call every tick before apply(). Cheap if the settings are the same and gravity barely moved.
+	void update(GyroSpace space, GyroAxisMask mouseXAxes, GyroAxisMask mouseYAxes, float gravX, float gravY, float gravZ);
+
+	FloatXY apply(float gyroX, float gyroY, float gyroZ) const;
+
+	// Same as apply() on each sample. The samples are given as separate arrays for each axis so the compiler can vectorize the loop.
+	void apply(span<const float> gyroX, span<const float> gyroY, span<const float> gyroZ, span<float> outX, span<float> outY) const;
+
+private:
+	void computeBasis();
+
+	// Relative change of the gravity vector that makes the basis be computed again
+	static constexpr float GRAVITY_EPSILON = 0.001f;
+
+	bool _hasBasis = false;
+	GyroSpace _space = GyroSpace::INVALID;
+	GyroAxisMask _mouseXAxes = GyroAxisMask::INVALID;
+	GyroAxisMask _mouseYAxes = GyroAxisMask::INVALID;
+	float _gravity[3] = { 0.f, 0.f, 0.f }; // Gravity the basis was computed for
+
+	// The output is the product of the gyro with these rows...
+	float _xRow[3] = { 0.f, 0.f, 0.f };
+	float _yRow[3] = { 0.f, 0.f, 0.f };
+	// ...except in the PLAYER spaces, where X is relaxed: sign(x) * min(|x| * _relax, length of gyro Y and Z) * _xScale.
+	float _relax = 0.f;
+	float _xScale = 1.f;
+};
@@ -11,25 +11,20 @@
 #include <atomic>
 #include <thread>
 #ifndef _WIN32
-#include <queue>
-#include <mutex>
-#include <condition_variable>
-
-enum class CommandSource { CONSOLE, FIFO, INTERNAL };
+enum class CommandSource { CONSOLE, FIFO, SOCKET, INTERNAL };
 
 struct Command {
     std::string text;
     CommandSource source;
+    int client = 0; // Control socket connection the command came from
 };
-#endif
-// Setup the input pipe for console input 
-#ifndef _WIN32
-extern int input_pipe_fd[2];
 
-extern std::queue<Command> commandQueue;
-extern std::mutex commandQueueMutex;
-extern std::condition_variable commandQueueCV;
+// Blocks until a command comes from the console, the FIFO, the control socket, a termination signal or WriteToConsole().
+// A command from the control socket holds a whole batch of lines and expects a ReplyToCommand().
+Command WaitForCommand();
 
+// Sends the response to a batch received from the control socket. Does nothing for other sources.
+void ReplyToCommand(const Command &command, string_view response);
 #endif
 
 
@@ -43,8 +38,18 @@ int pressMouse(KeyCode vkKey, bool isPressed);
 // send key press
 int pressKey(KeyCode vkKey, bool pressed);
 
+// move the mouse by the given amount, paced according to setMouseOutputRate()
 void moveMouse(float x, float y);
 
+// move the mouse right away. Fractions of pixels are kept for the next call
+void sendMouseMove(float x, float y);
+
+// send the motion given to moveMouse() in even slices, this many times per second. 0 sends it right away
+void setMouseOutputRate(float rate);
+
+// send the motion moveMouse() is still pacing right away, so that the output that follows doesn't overtake it
+void flushMouseMove();
+
 void setMouseNorm(float x, float y);
 
 // delta time will apply to shaped movement, but the extra (velocity parameters after deltaTime) is
@@ -61,14 +66,62 @@ BOOL WINAPI ConsoleCtrlHandler(DWORD dwCtrlType);
 
 // just setting up the console with standard stuff
 void initConsole();
-void initConsole(std::function<void()>);
 #ifndef _WIN32
 void initFifoCommandListener();
+
+// Listen for control clients on $XDG_RUNTIME_DIR/jsm_control.sock
+void initControlSocket();
+
+// Resident memory of the process in kilobytes. 0 if unknown.
+long GetResidentMemoryKb();
+
+// Milliseconds since the process started, including the time the loader took. 0 if unknown.
+float GetProcessAgeMs();
 #endif
 tuple<string, string> GetActiveWindowName();
 
+// Blocks until the focused window changes or the timeout expires. Returns false on timeout.
+// Where focus notifications are not available, this just sleeps and returns true.
+bool WaitForActiveWindowChange(unsigned int timeoutMs);
+
 vector<string> ListDirectory(string directory);
 
+// Tells whether files were added to, removed from or renamed in a directory
+class DirectoryWatcher
+{
+public:
+	DirectoryWatcher(string_view directory);
+	~DirectoryWatcher();
+
+	// Returns true if the directory content changed since the last call, or if it cannot be watched
+	bool hasChanged();
+
+private:
+	struct Impl;
+	unique_ptr<Impl> _impl;
+};
+
+// Tells which of a set of files were written, including by editors that save to a new file and rename it
+class FileWatcher
+{
+public:
+	FileWatcher();
+	~FileWatcher();
+
+	// Start watching a file. Does nothing if it is already watched.
+	void watch(string_view path);
+
+	// Paths, as given to watch(), of the files that may have been written since the last call
+	vector<string> changedFiles();
+
+	// Blocks until a watched file may have been written or the timeout expires. Returns false on timeout.
+	bool wait(unsigned int timeoutMs);
+
+private:
+	struct Impl;
+	unique_ptr<Impl> _impl;
+};
+
 string GetCWD();
 
 bool SetCWD(string_view newCWD);
@@ -93,15 +146,7 @@ public:
 
 	virtual ~PollingThread()
 	{
-		if (_continue)
-		{
-			Stop();
-		}
-		if (_thread)
-		{
-			_thread->join();
-			_thread.reset();
-		}
+		Join();
 		// Let poll function cleanup
 	}
 
@@ -136,6 +181,18 @@ public:
 		return _thread && _continue;
 	}
 
+	// Stop and wait for the thread to end. Derived classes whose loop uses their own members call it in their
+	// destructor, since these are destroyed before this base class is.
+	void Join()
+	{
+		Stop();
+		if (_thread)
+		{
+			_thread->join();
+			_thread.reset();
+		}
+	}
+
 	const char *_label;
 
 private:
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "JoyShockMapper.h"
+#include "JslWrapper.h"
+#include "ClockIf.h"
+
+#include <fstream>
+#include <mutex>
+#include <set>
+
+// The controller input of every tick, as read by the poll callback, so it can be played back through the mapper.
+// It is a text file with one entry per line:
+//   DEVICE <handle> <controller type> <split type>
+//   <milliseconds> <handle> <buttons> <left trigger> <right trigger> <left x> <left y> <right x> <right y> <accel x> <accel y> <accel z> <gyro x> <gyro y> <gyro z>
+// Empty lines and lines starting with # are ignored.
+struct InputTrace
+{
+	struct Device
+	{
+		int handle = 0;
+		int type = 0;
+		int splitType = JS_SPLIT_TYPE_FULL;
+	};
+
+	struct Record
+	{
+		double timeMs = 0.;
+		int handle = 0;
+		JOY_SHOCK_STATE state{};
+		IMU_STATE imu{};
+	};
+
+	vector<Device> devices;
+	vector<Record> records; // In time order
+
+	bool load(string_view path);
+};
+
+// Writes the input of each tick to a trace file
+class InputTraceRecorder
+{
+public:
+	bool open(string_view path);
+
+	void record(int handle, int type, int splitType, ClockIf::TimePoint time, const JOY_SHOCK_STATE &state, const IMU_STATE &imu);
+
+private:
+	ofstream _file;
+	set<int> _devices;
+	ClockIf::TimePoint _start;
+	bool _started = false;
+	mutex _lock;
+};
+
+// A backend whose controllers are the devices of a trace
+class TraceReplay : public JslWrapper
+{
+public:
+	// Send every record of the trace to the callback, after moving the clock to the time of the record.
+	// Runs as fast as the mapper can process the records. Returns how many it sent.
+	virtual size_t run(SimulatedClock &clock) = 0;
+
+	static TraceReplay *getNew(InputTrace trace);
+};
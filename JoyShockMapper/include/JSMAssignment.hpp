@@ -30,6 +30,7 @@ protected:
 		smatch results;
 		_ASSERT_EXPR(_parse, L"There is no function defined to parse this command.");
 		const string argStr(arguments);
+		_failed = false;
 		if (arguments.empty())
 		{
 			displayCurrentValue();
@@ -48,6 +49,7 @@ protected:
 			}
 			else if (!_parse(this, assignment, label))
 			{
+				_failed = true;
 				CERR << "Error assigning ";
 				COUT_INFO << assignment;
 				CERR << " to " << _displayName << '\n';
@@ -61,6 +63,7 @@ protected:
 		else if (!_help.empty())
 		{
 			// Parsing has failed.
+			_failed = true;
 			CERR << "Error when processing the assignment. See the ";
 			COUT_INFO << "README";
 			CERR << " for details on valid assignment values\n";
@@ -234,6 +237,11 @@ public:
 		}
 	}
 
+	const JSMVariableBase* variable() const override
+	{
+		return &_var;
+	}
+
 	// This setter enables custom parsers to perform assignments
 	inline T operator=(T newVal)
 	{
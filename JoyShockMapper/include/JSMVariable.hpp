@@ -2,11 +2,90 @@
 
 #include "JoyShockMapper.h"
 #include "Mapping.h"
+#include <algorithm>
+#include <deque>
 #include <sstream>
 
 // Global ID generator
 static unsigned int _delegateID = 1;
 
+// While a NotificationBatch exists, variables hold off calling their deferrable listeners until the
+// outermost batch of the thread ends. Each variable then notifies only once, with its final value,
+// and not at all if it went back to its initial value.
+class NotificationBatch
+{
+public:
+	NotificationBatch()
+	{
+		++_depth;
+	}
+
+	~NotificationBatch()
+	{
+		if (--_depth == 0)
+		{
+			// Variables changed by the listeners below notify right away: the batch is over.
+			while (!_pending.empty())
+			{
+				auto notify = move(_pending.front().second);
+				_pending.pop_front();
+				notify();
+			}
+		}
+	}
+
+	NotificationBatch(const NotificationBatch &) = delete;
+	NotificationBatch &operator=(const NotificationBatch &) = delete;
+
+	// Returns false if no batch is ongoing, in which case the caller should notify right away.
+	// Only the first notification of a variable is kept.
+	static bool defer(const void *variable, function<void()> notify)
+	{
+		if (_depth == 0)
+			return false;
+		if (find_if(_pending.begin(), _pending.end(), [variable](auto &pending) { return pending.first == variable; }) == _pending.end())
+			_pending.emplace_back(variable, move(notify));
+		return true;
+	}
+
+	// The variable is going away
+	static void cancel(const void *variable)
+	{
+		erase_if(_pending, [variable](auto &pending) { return pending.first == variable; });
+	}
+
+private:
+	static inline thread_local int _depth = 0;
+	static inline thread_local deque<pair<const void *, function<void()>>> _pending;
+};
+
+// An immutable copy of the values of a variable, that other threads can read while the variable changes.
+struct FrozenVariable
+{
+	virtual ~FrozenVariable() = default;
+};
+
+template<typename T>
+struct FrozenValues : public FrozenVariable
+{
+	T value;
+	bool chorded = false; // Only chorded variables answer chordedValue()
+	map<ButtonID, T> chords;
+
+	// Same as ChordedVariable::chordedValue()
+	optional<T> chordedValue(ButtonID chord) const
+	{
+		if (!chorded)
+			return nullopt;
+		if (chord > ButtonID::NONE)
+		{
+			auto existingChord = chords.find(chord);
+			return existingChord != chords.end() ? optional<T>(existingChord->second) : nullopt;
+		}
+		return chord != ButtonID::INVALID ? optional(value) : nullopt;
+	}
+};
+
 class JSMVariableBase
 {
 public:
@@ -24,6 +103,15 @@ public:
 
 	virtual JSMVariableBase *reset() = 0;
 
+	// Copy the current values
+	virtual shared_ptr<const FrozenVariable> freeze() const = 0;
+
+	// Set back the values of a copy made by freeze(). Listeners are notified of the values that change.
+	virtual void thaw(const FrozenVariable &frozen) = 0;
+
+	// Whether the current values are those of a copy made by freeze()
+	virtual bool matches(const FrozenVariable &frozen) const = 0;
+
 private:
 	// a user provided label
 	string _label;
@@ -52,6 +140,9 @@ protected:
 	// Parts of the code can be notified of when _value changes.
 	map<unsigned int, OnChangeDelegate> _onChangeListeners;
 
+	// Listeners that can wait for the end of a NotificationBatch
+	map<unsigned int, OnChangeDelegate> _deferrableListeners;
+
 	// The filtering function of the variable.
 	FilterDelegate _filter;
 
@@ -68,6 +159,7 @@ public:
 	JSMVariable(T defaultValue = T())
 	  : _value(defaultValue)
 	  , _onChangeListeners()
+	  , _deferrableListeners()
 	  , _filter(&noFiltering) // _filter is always valid
 	  , _defVal(defaultValue)
 	{
@@ -77,6 +169,7 @@ public:
 	JSMVariable(const JSMVariable &copy, T defaultValue)
 	  : _value(defaultValue)
 	  , _onChangeListeners() // Don't copy listeners. This is a different variable!
+	  , _deferrableListeners()
 	  , _filter(copy._filter)
 	  , _defVal(defaultValue)
 	{
@@ -84,7 +177,9 @@ public:
 
 	virtual ~JSMVariable()
 	{
+		NotificationBatch::cancel(this);
 		_onChangeListeners.clear();
+		_deferrableListeners.clear();
 	}
 
 	// Sets the filtering function for this variable. Also applies
@@ -97,12 +192,14 @@ public:
 	}
 
 	// Remember to call this listener when the value changes.
-	virtual unsigned int addOnChangeListener(OnChangeDelegate listener, bool callListener = false)
+	// A deferrable listener only needs the final value after a NotificationBatch.
+	virtual unsigned int addOnChangeListener(OnChangeDelegate listener, bool callListener = false, bool deferrable = false)
 	{
-		_onChangeListeners[_delegateID] = listener;
+		auto &listeners = deferrable ? _deferrableListeners : _onChangeListeners;
+		listeners[_delegateID] = listener;
 		if (callListener)
 		{
-			_onChangeListeners[_delegateID](_value);
+			listeners[_delegateID](_value);
 		}
 		return _delegateID++;
 	}
@@ -110,13 +207,7 @@ public:
 	// Remove the listener from list
 	virtual bool removeOnChangeListener(unsigned int id)
 	{
-		auto found = _onChangeListeners.find(id);
-		if (found != _onChangeListeners.end())
-		{
-			_onChangeListeners.erase(found);
-			return true;
-		}
-		return false;
+		return _onChangeListeners.erase(id) > 0 || _deferrableListeners.erase(id) > 0;
 	}
 
 	// reset the variable by assigning it its default value.
@@ -144,6 +235,25 @@ public:
 		return _defVal;
 	}
 
+	shared_ptr<const FrozenVariable> freeze() const override
+	{
+		auto frozen = make_shared<FrozenValues<T>>();
+		frozen->value = _value;
+		return frozen;
+	}
+
+	void thaw(const FrozenVariable &frozen) override
+	{
+		if (auto values = dynamic_cast<const FrozenValues<T> *>(&frozen))
+			set(values->value);
+	}
+
+	bool matches(const FrozenVariable &frozen) const override
+	{
+		auto values = dynamic_cast<const FrozenValues<T> *>(&frozen);
+		return values && values->value == _value;
+	}
+
 	// Value can be written by using set()
 	// N.B.: It's important to always use either function
 	// for changing the member _value
@@ -154,11 +264,23 @@ public:
 		if (_value != oldValue)
 		{
 			// Notify listeners of the change if there's a change
-			for (auto listener : _onChangeListeners)
+			for (auto &listener : _onChangeListeners)
 				listener.second(_value);
+			if (!_deferrableListeners.empty() && !NotificationBatch::defer(this, [this, oldValue]() { notifyDeferrableListeners(oldValue); }))
+				notifyDeferrableListeners(oldValue);
 		}
 		return _value; // Return actual value assign. Can be different from newValue because of filtering.
 	}
+
+private:
+	void notifyDeferrableListeners(const T &valueBefore)
+	{
+		if (_value != valueBefore)
+		{
+			for (auto &listener : _deferrableListeners)
+				listener.second(_value);
+		}
+	}
 };
 
 // A chorded variable alternate values depending on _buttons enabling the chorded value
@@ -216,6 +338,39 @@ public:
 		return Base::value();
 	}
 
+	shared_ptr<const FrozenVariable> freeze() const override
+	{
+		auto frozen = make_shared<FrozenValues<T>>();
+		freezeChords(*frozen);
+		return frozen;
+	}
+
+	// Chords the copy doesn't have are removed
+	void thaw(const FrozenVariable &frozen) override
+	{
+		auto values = dynamic_cast<const FrozenValues<T> *>(&frozen);
+		if (!values)
+			return;
+		this->set(values->value);
+		erase_if(_chordedVariables, [values](auto &chord)
+		  { return !values->chords.contains(chord.first); });
+		for (auto &[chord, value] : values->chords)
+		{
+			atChord(chord)->set(value);
+		}
+	}
+
+	bool matches(const FrozenVariable &frozen) const override
+	{
+		auto values = dynamic_cast<const FrozenValues<T> *>(&frozen);
+		if (!values || !(values->value == Base::_value) || values->chords.size() != _chordedVariables.size())
+			return false;
+		return all_of(_chordedVariables.begin(), _chordedVariables.end(), [values](auto &chord)
+		  {
+			auto frozenChord = values->chords.find(chord.first);
+			return frozenChord != values->chords.end() && frozenChord->second == chord.second.value(); });
+	}
+
 	// Resetting a chorded var always clears all chords.
 	virtual ChordedVariable<T> *reset() override
 	{
@@ -223,6 +378,17 @@ public:
 		_chordedVariables.clear();
 		return this;
 	}
+
+protected:
+	void freezeChords(FrozenValues<T> &frozen) const
+	{
+		frozen.value = Base::_value;
+		frozen.chorded = true;
+		for (auto &[chord, variable] : _chordedVariables)
+		{
+			frozen.chords.emplace(chord, variable.value());
+		}
+	}
 };
 
 // A Setting for JSM can be chorded normally. It also has its own setting ID
@@ -269,16 +435,16 @@ public:
 	}
 };
 
-// A combo map is an item of _simMappings below. It holds an alternative variable when ButtonID is pressed.
-typedef pair<const ButtonID, JSMVariable<Mapping>> ComboMap;
+// A combo map is an item of the sim and diagonal presses of a frozen button. It holds an alternative mapping when ButtonID is pressed.
+typedef pair<const ButtonID, Mapping> ComboMap;
 
 class MapIterator
 {
-	const map<ButtonID, JSMVariable<Mapping>> *_mapping;
-	map<ButtonID, JSMVariable<Mapping>>::const_iterator _iter;
+	const map<ButtonID, Mapping> *_mapping;
+	map<ButtonID, Mapping>::const_iterator _iter;
 
 public:
-	MapIterator(const map<ButtonID, JSMVariable<Mapping>> &mapping)
+	MapIterator(const map<ButtonID, Mapping> &mapping)
 	  : _mapping(&mapping)
 	  , _iter(_mapping->begin())
 	{
@@ -300,99 +466,59 @@ public:
 	}
 };
 
-
-// Button mappings includes not only chorded mappings, but also simultaneous press mappings
-class JSMButton : public ChordedVariable<Mapping>
+// A copy of a button also has its sim and diagonal presses. The input thread reads the bindings from it.
+struct FrozenButton : public FrozenValues<Mapping>
 {
-public:
-	// Identifier of the variable. Cannot be changed after construction.
-	const ButtonID _id;
-
-protected:
-	map<ButtonID, JSMVariable<Mapping>> _simMappings;
-	map<ButtonID, JSMVariable<Mapping>> _diagMappings;
-
-	// Store listener IDs for its sim presses. This is required for Cross updates
-	map<ButtonID, unsigned int> _mapping;
-
-public:
-	JSMButton(ButtonID id, Mapping def)
-	  : ChordedVariable(def)
-	  , _id(id)
-	  , _simMappings()
-	  , _diagMappings()
-	  , _mapping()
-	{
-	}
-
-	virtual ~JSMButton()
-	{
-		for (auto id : _mapping)
-		{
-			if (!_simMappings[id.first].removeOnChangeListener(id.second))
-			{
-				_diagMappings[id.first].removeOnChangeListener(id.second);
-			}
-		}
-	}
+	ButtonID id = ButtonID::INVALID;
+	map<ButtonID, Mapping> simPresses;
+	map<ButtonID, Mapping> diagPresses;
 
-	// Obtain the Variable for a sim press if any.
+	// Iterate over the sim presses
 	MapIterator getSimMapIter() const
 	{
-		return MapIterator(_simMappings);
+		return MapIterator(simPresses);
 	}
 
-	// Obtain the Variable for a sim press if any.
+	// Iterate over the diagonal presses
 	MapIterator getDiagMapIter() const
 	{
-		return MapIterator(_diagMappings);
+		return MapIterator(diagPresses);
 	}
 
-	// Double Press mappings are stored in the chorded variables
+	// Double Press mappings are stored in the chords
 	const ComboMap *getDblPressMap() const
 	{
-		auto existingChord = _chordedVariables.find(_id);
-		return existingChord != _chordedVariables.end() ? &*existingChord : nullptr;
+		auto existingChord = chords.find(id);
+		return existingChord != chords.end() ? &*existingChord : nullptr;
 	}
 
-	// Indicate whether any sim press mappings are present
-	inline bool hasSimMappings() const
+	optional<Mapping> simPress(ButtonID simBtn) const
 	{
-		return !_simMappings.empty();
+		auto existingSim = simPresses.find(simBtn);
+		return existingSim != simPresses.end() ? optional(existingSim->second) : nullopt;
 	}
 
-	inline bool hasDiagMappings() const
+	// Indicate whether any sim press mappings are present
+	inline bool hasSimMappings() const
 	{
-		return !_diagMappings.empty();
+		return !simPresses.empty();
 	}
 
-	virtual Mapping set(Mapping baseValue) override
+	inline bool hasDiagMappings() const
 	{
-		return JSMVariable<Mapping>::set(baseValue);
+		return !diagPresses.empty();
 	}
 
 	// Returns the display name of the chorded press if provided, or itself
 	string getName(ButtonID chord = ButtonID::NONE) const
 	{
-		stringstream ss;
-		if (chord > ButtonID::NONE)
-		{
-			ss << chord << ',' << _id;
-			return ss.str();
-		}
-		else if (chord != ButtonID::INVALID)
-		{
-			ss << _id;
-			return ss.str();
-		}
-		else
-			return string();
+		return chordName(id, chord);
 	}
 
 	// Returns the sim press name of itself with simBtn.
 	string getSimPressName(ButtonID simBtn) const
 	{
-		if (simBtn == _id)
+		if (simBtn == id)
 		{
 			// It's actually a double press, not a sim press
 			return getName(simBtn);
@@ -400,7 +526,7 @@ public:
 		if (simBtn > ButtonID::NONE)
 		{
 			stringstream ss;
-			ss << simBtn << '+' << _id;
+			ss << simBtn << '+' << id;
 			return ss.str();
 		}
 		return string();
@@ -411,12 +537,75 @@ public:
 		if (simBtn > ButtonID::NONE)
 		{
 			stringstream ss;
-			ss << simBtn << '*' << _id;
+			ss << simBtn << '*' << id;
 			return ss.str();
 		}
 		return string();
 	}
 
+	static string chordName(ButtonID id, ButtonID chord)
+	{
+		stringstream ss;
+		if (chord > ButtonID::NONE)
+		{
+			ss << chord << ',' << id;
+			return ss.str();
+		}
+		else if (chord != ButtonID::INVALID)
+		{
+			ss << id;
+			return ss.str();
+		}
+		else
+			return string();
+	}
+};
+
+class JSMButton : public ChordedVariable<Mapping>
+{
+public:
+	// Identifier of the variable. Cannot be changed after construction.
+	const ButtonID _id;
+
+protected:
+	map<ButtonID, JSMVariable<Mapping>> _simMappings;
+	map<ButtonID, JSMVariable<Mapping>> _diagMappings;
+
+	// Store listener IDs for its sim presses. This is required for Cross updates
+	map<ButtonID, unsigned int> _mapping;
+
+public:
+	JSMButton(ButtonID id, Mapping def)
+	  : ChordedVariable(def)
+	  , _id(id)
+	  , _simMappings()
+	  , _diagMappings()
+	  , _mapping()
+	{
+	}
+
+	virtual ~JSMButton()
+	{
+		for (auto id : _mapping)
+		{
+			if (!_simMappings[id.first].removeOnChangeListener(id.second))
+			{
+				_diagMappings[id.first].removeOnChangeListener(id.second);
+			}
+		}
+	}
+
+	virtual Mapping set(Mapping baseValue) override
+	{
+		return JSMVariable<Mapping>::set(baseValue);
+	}
+
+	// Returns the display name of the chorded press if provided, or itself
+	string getName(ButtonID chord = ButtonID::NONE) const
+	{
+		return FrozenButton::chordName(_id, chord);
+	}
+
 	// Resetting a button also clears all assigned sim presses
 	virtual JSMButton *reset() override
 	{
@@ -431,6 +620,39 @@ public:
 		return this;
 	}
 
+	shared_ptr<const FrozenVariable> freeze() const override
+	{
+		return freezeButton();
+	}
+
+	shared_ptr<const FrozenButton> freezeButton() const
+	{
+		auto frozen = make_shared<FrozenButton>();
+		frozen->id = _id;
+		freezeChords(*frozen);
+		for (auto &[chord, variable] : _simMappings)
+		{
+			frozen->simPresses.emplace(chord, variable.value());
+		}
+		for (auto &[chord, variable] : _diagMappings)
+		{
+			frozen->diagPresses.emplace(chord, variable.value());
+		}
+		return frozen;
+	}
+
+	// The partner buttons get the sim and diagonal presses through their listeners, but have to be thawed as well
+	// to remove the ones the copy doesn't have.
+	void thaw(const FrozenVariable &frozen) override
+	{
+		ChordedVariable<Mapping>::thaw(frozen);
+		if (auto button = dynamic_cast<const FrozenButton *>(&frozen))
+		{
+			thawPresses(_simMappings, button->simPresses, &JSMButton::atSimPress);
+			thawPresses(_diagMappings, button->diagPresses, &JSMButton::atDiagPress);
+		}
+	}
+
 	// Get the SimPress variable, creating one if required.
 	// An additional listener is required for the complementary sim press
 	// to be updated when this value changes.
@@ -475,6 +697,24 @@ public:
 		return existingSim != _diagMappings.end() ? &existingSim->second : nullptr;
 	}
 
+	void thawPresses(map<ButtonID, JSMVariable<Mapping>> &presses, const map<ButtonID, Mapping> &frozen, JSMVariable<Mapping> *(JSMButton::*atPress)(ButtonID))
+	{
+		for (auto press = presses.begin(); press != presses.end();)
+		{
+			if (frozen.contains(press->first))
+			{
+				++press;
+				continue;
+			}
+			press->second.removeOnChangeListener(_mapping[press->first]);
+			press = presses.erase(press);
+		}
+		for (auto &[chord, mapping] : frozen)
+		{
+			(this->*atPress)(chord)->set(mapping);
+		}
+	}
+
 	void processChordRemoval(ButtonID chord, const JSMVariable<Mapping> *value)
 	{
 		if (value && value->value() == Mapping::NO_MAPPING)
@@ -4,15 +4,18 @@
 #include "MotionIf.h"
 #include "DigitalButton.h"
 #include "Stick.h"
+#include "StickCurve.h"
 #include "JslWrapper.h"
 #include "SettingsManager.h"
+#include "GyroSpaceTransform.h"
 #include "../src/quatMaths.cpp"
 
 // An instance of this class represents a single controller device that JSM is listening to.
 class JoyShock
 {
 public:
-	JoyShock(int uniqueHandle, int controllerSplitType, shared_ptr<DigitalButton::Context> sharedButtonCommon = nullptr);
+	// The clock is only used when no context is shared: a shared context brings its own
+	JoyShock(int uniqueHandle, int controllerSplitType, shared_ptr<ClockIf> clock, shared_ptr<DigitalButton::Context> sharedButtonCommon = nullptr);
 
 	~JoyShock();
 
@@ -60,15 +63,47 @@ public:
 
 	bool processGyroStick(float stickX, float stickY, float stickLength, StickMode stickMode, bool forceOutput);
 
+	// Response curves for the current settings. The tables are only rebuilt when a value changes.
+	const PowerCurve &getStickPowerCurve();
+	const VirtualStickCurve &getVirtualStickCurve(bool isLeft);
+
 	shared_ptr<DigitalButton::Context> _context;
 	vector<DigitalButton> _buttons;
 	vector<DigitalButton> _gridButtons;
 	vector<TouchStick> _touchpads;
 	chrono::steady_clock::time_point _timeNow;
+	// Average milliseconds between ticks of this device. Smoothing windows given in time use it to know how many samples they span.
+	float _tickTime;
+	// Whether the last tick let the backend tick this device less often. The interval after it is left out of the timings.
+	bool _atRest = false;
+	// Smallest change the sticks of this device can make, as measured by the backend. Until known, about one step of an 8 bit stick.
+	float _stickStep = 0.01f;
+	// Settings values in use for the current tick. Refreshed at the start of each callback.
+	shared_ptr<const SettingsSnapshot> _settings = SettingsManager::snapshot();
+
+	// Poll callback timings since the last time they were queried. Guarded by the callback lock.
+	struct TickStats
+	{
+		int ticks = 0;
+		float totalInterval = 0.f; // seconds between callbacks
+		float maxInterval = 0.f;
+		float totalProcessing = 0.f; // seconds spent in the callback
+		float maxProcessing = 0.f;
+	} _tickStats;
 	shared_ptr<MotionIf> _motion;
+	Switch _autoCalibrateGyro = Switch::INVALID; // Calibration mode last given to _motion
+	GyroSpaceTransform _gyroSpaceTransform;
 	int _handle;
 	int _controllerType;
 	int _splitType = 0;
+	string _identity; // See JslWrapper::GetControllerIdentity()
+	// Size of the touchpad, asked once on connection. Empty if the device has none.
+	optional<FloatXY> _touchpadSize;
+	TOUCH_STATE _lastTouch{}; // Touch state of the previous tick
+	// A merged Joy-Con pair is mapped as one controller. The half created last drives it: each of its ticks reads
+	// the input of both halves. The other half is passive and its own ticks do nothing.
+	shared_ptr<JoyShock> _pairedHalf;
+	bool _passive = false;
 
 
 	float neutralQuatW = 1.0f;
@@ -86,6 +121,9 @@ public:
 	Stick _leftStick;
 	Stick _rightStick;
 	Stick _motionStick;
+	PowerCurve _stickPowerCurve;
+	VirtualStickCurve _leftVirtualStickCurve;
+	VirtualStickCurve _rightVirtualStickCurve;
 
 	bool processed_gyro_stick = false;
 	static constexpr int NUM_LAST_GYRO_SAMPLES = 100;
@@ -137,19 +175,26 @@ private:
 	ScrollAxis _touchScrollY;
 
 	vector<DstState> _triggerState; // State of analog triggers when skip mode is active
-	vector<deque<float>> _prevTriggerPosition;
+
+	// Latest positions of an analog trigger, for hair trigger detection
+	struct TriggerHistory
+	{
+		// Positions are stored in steps of 1 / STEPS, finer than any trigger reports, so the sums stay exact
+		static constexpr int32_t STEPS = 65535;
+		static constexpr int WINDOW = 3; // Samples in an average
+
+		array<int32_t, WINDOW> positions = {}; // The last WINDOW positions, oldest at next
+		array<int32_t, WINDOW> sums = {};      // Sum of WINDOW positions on each of the last WINDOW ticks, oldest at next
+		int next = 0;
+	};
+	static_assert(2 * TriggerHistory::WINDOW - 1 == MAGIC_TRIGGER_SMOOTHING);
+	array<TriggerHistory, NUM_ANALOG_TRIGGERS> _triggerHistory;
 };
 
 template<typename E>
 optional<E> JoyShock::getSettingAtChord(SettingID id, ButtonID chord)
 {
-	auto setting = SettingsManager::get<E>(id);
-	if (setting)
-	{
-		auto chordedValue = setting->chordedValue(chord);
-		return chordedValue ? optional<E>(setting->chordedValue(chord)) : nullopt;
-	}
-	return nullopt;
+	return _settings->chordedValue<E>(id, chord);
 }
 
 template<typename E>
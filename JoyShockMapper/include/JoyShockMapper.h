@@ -233,6 +233,19 @@ enum class SettingID
 	MOUSELIKE_FACTOR,
 	RETURN_DEADZONE_ANGLE,
 	RETURN_DEADZONE_ANGLE_CUTOFF,
+	DEVICE_TICK_TIME, // Unchorded setting
+	DS4_REPORT_INTERVAL, // Unchorded setting
+	MOUSE_OUTPUT_RATE, // Unchorded setting
+	IDLE_TICK_TIME, // Unchorded setting
+	AUTORELOAD,
+};
+
+// The settings go past the default range of magic_enum, which ends at 127
+template<>
+struct magic_enum::customize::enum_range<SettingID>
+{
+	static constexpr int min = -1;
+	static constexpr int max = 255;
 };
 
 // constexpr are like #define but with respect to typeness
@@ -569,13 +582,27 @@ protected:
 
 	static streambuf *makeBuffer(Level level);
 
+	// What this thread logs is also written there, without colors, while it is set
+	static inline thread_local ostream *_capture = nullptr;
+
 public:
 	Log(Level level)
 	  : _buf(makeBuffer(level))
 	  , _str(_buf.get())
 	{
 	}
-	~Log() { }
+	~Log()
+	{
+		if (auto text = dynamic_cast<stringbuf *>(_buf.get()); text && _capture)
+			*_capture << text->str();
+	}
+
+	// Copy what the calling thread logs to the stream, until it is called again with nullptr.
+	// Other threads keep logging to the console only.
+	static void setThreadCapture(ostream *capture)
+	{
+		_capture = capture;
+	}
 
 	ostream _str;
 };
@@ -1,8 +1,11 @@
 // JoyShockLibrary.h - Contains declarations of functions
 #pragma once
 
+#include <chrono>
 #include <cstdint>
 #include <iostream>
+#include <string>
+#include <thread>
 
 enum class AdaptiveTriggerMode : unsigned char
 {
@@ -187,12 +190,19 @@ public:
 
 	virtual int ConnectDevices() = 0;
 	virtual int GetDeviceCount() = 0;
+	// Blocks until a device may have been added or removed, or the timeout expires. Returns false on timeout.
+	// Backends without hotplug notifications just sleep and return true, so the caller polls GetDeviceCount().
+	virtual bool WaitForDeviceChange(unsigned int timeoutMs)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+		return true;
+	}
 	virtual int GetConnectedDeviceHandles(int* deviceHandleArray, int size) = 0;
 	virtual void DisconnectAndDisposeAll() = 0;
 	virtual JOY_SHOCK_STATE GetSimpleState(int deviceId) = 0;
 	virtual IMU_STATE GetIMUState(int deviceId) = 0;
 	virtual MOTION_STATE GetMotionState(int deviceId) = 0;
-	virtual TOUCH_STATE GetTouchState(int deviceId, bool previous = false) = 0;
+	virtual TOUCH_STATE GetTouchState(int deviceId) = 0;
 	virtual bool GetTouchpadDimension(int deviceId, int& sizeX, int& sizeY) = 0;
 	virtual int GetButtons(int deviceId) = 0;
 	virtual float GetLeftX(int deviceId) = 0;
@@ -220,13 +230,21 @@ public:
 	virtual void GetCalibrationOffset(int deviceId, float& xOffset, float& yOffset, float& zOffset) = 0;
 	virtual void SetCalibrationOffset(int deviceId, float xOffset, float yOffset, float zOffset) = 0;
 	virtual void SetCallback(void (*callback)(int, JOY_SHOCK_STATE, JOY_SHOCK_STATE, IMU_STATE, IMU_STATE, float)) = 0;
-	virtual void SetTouchCallback(void (*callback)(int, TOUCH_STATE, TOUCH_STATE, float)) = 0;
 	virtual int GetControllerType(int deviceId) = 0;
 	virtual int GetControllerSplitType(int deviceId) = 0;
+	// Identifies the physical controller across reconnections, or empty if the backend can't tell
+	virtual std::string GetControllerIdentity(int deviceId)
+	{
+		return std::string();
+	}
 	virtual int GetControllerColour(int deviceId) = 0;
 	virtual void SetLightColour(int deviceId, int colour) = 0;
 	virtual void SetRumble(int deviceId, int smallRumble, int bigRumble) = 0;
 	virtual void SetPlayerNumber(int deviceId, int number) = 0;
 	virtual void SetTriggerEffect(int deviceId, const AdaptiveTriggerSetting &_leftTriggerEffect, const AdaptiveTriggerSetting &_rightTriggerEffect) { };
 	virtual void SetMicLight(int deviceId, unsigned char mode) { }
+	// Told on each tick whether the mapping of the device is at rest. While it is, the backend may wait up to IDLE_TICK_TIME
+	// before the next tick, but must tick as soon as the input moves away from what it was when the device came to rest.
+	// The device maps the input of the paired device too, if there is one: the input of that device must wake it as well.
+	virtual void SetIdle(int deviceId, bool idle, int pairedDeviceId = -1) { }
 };
@@ -3,24 +3,68 @@
 #include "JoyShockMapper.h"
 #include "PlatformDefinitions.h"
 
+class EventActionIf;
+
+// What a single key of a mapping does when it is applied and when it is released
+struct KeyAction
+{
+	enum class Kind : uint8_t
+	{
+		Key,       // Press and release a key or button
+		Gyro,      // Add and remove a gyro action
+		Calibrate, // Start and finish the continuous calibration
+		Command,   // Run a console command, nothing on release
+		Rumble,    // Start and stop rumbling
+	};
+
+	Kind kind = Kind::Key;
+	KeyCode key;
+	int smallRumble = 0;
+	int bigRumble = 0;
+
+	void apply(EventActionIf &button) const;
+	void release(EventActionIf &button) const;
+
+	inline bool hasRelease() const
+	{
+		return kind != Kind::Command;
+	}
+};
+
+// A key action put aside by the button, to run when an instant event ends
+struct DeferredAction
+{
+	KeyAction action;
+	bool isApply = false;
+
+	inline void run(EventActionIf &button) const;
+};
+
 // The list of different function that can be bound in the mapping
 class EventActionIf
 {
 public:
-	typedef function<void(EventActionIf *)> Callback;
-
-	virtual void RegisterInstant(BtnEvent evt, Callback cb) = 0;
+	virtual void RegisterInstant(BtnEvent evt, const DeferredAction &action) = 0;
 	virtual void ApplyGyroAction(KeyCode gyroAction) = 0;
 	virtual void RemoveGyroAction() = 0;
 	virtual void SetRumble(int smallRumble, int bigRumble) = 0;
 	virtual void ApplyBtnPress(KeyCode key) = 0;
 	virtual void ApplyBtnRelease(KeyCode key) = 0;
-	virtual void ApplyButtonToggle(KeyCode key, Callback apply, Callback release) = 0;
+	// Apply the action, or release it if this button already toggled it on
+	virtual void ApplyButtonToggle(const KeyAction &action) = 0;
 	virtual void StartCalibration() = 0;
 	virtual void FinishCalibration() = 0;
 	virtual const char *getDisplayName() = 0;
 };
 
+inline void DeferredAction::run(EventActionIf &button) const
+{
+	if (isApply)
+		action.apply(button);
+	else
+		action.release(button);
+}
+
 // This structure handles the mapping of a button, buy processing and action
 // to be done on tap, hold, turbo and others. It holds a map of actions to perform
 // when a specific event happens. This replaces the old Mapping structure.
@@ -56,15 +100,44 @@ public:
 	friend ostream &operator<<(ostream &out, const Mapping &mapping);
 
 private:
+	// One instruction of the program run on a button event
+	struct ActionOp
+	{
+		enum class Type : uint8_t
+		{
+			Apply,          // Apply the action
+			Release,        // Release the action
+			Toggle,         // Apply the action, or release it if it is toggled on
+			InstantApply,   // Apply the action when instantEvent ends
+			InstantRelease, // Release the action when instantEvent ends
+		};
+
+		Type type;
+		uint8_t action; // Index in _actions
+		BtnEvent instantEvent = BtnEvent::INVALID;
+	};
+
+	static constexpr size_t NUM_EVENTS = size_t(BtnEvent::INVALID);
+
 	string _description = "no input";
 	string _command;
 
-	map<BtnEvent, EventActionIf::Callback> _eventMapping;
+	// The bindings are compiled when parsed: the ops of each event are contiguous in _program, in the order they
+	// were bound, and _eventOps gives where they start and how many there are.
+	vector<KeyAction> _actions;
+	vector<ActionOp> _program;
+	array<pair<uint8_t, uint8_t>, NUM_EVENTS> _eventOps = {};
 	float _tapDurationMs = MAGIC_TAP_DURATION;
 	bool _hasViGEmBtn = false;
 
-	void InsertEventMapping(BtnEvent evt, EventActionIf::Callback action);
-	static void RunBothActions(EventActionIf *btn, EventActionIf::Callback action1, EventActionIf::Callback action2);
+	void InsertOp(BtnEvent evt, ActionOp op);
+
+	inline bool hasOps(BtnEvent evt) const
+	{
+		return _eventOps[size_t(evt)].second > 0;
+	}
+
+	size_t countMappedEvents() const;
 
 public:
 	Mapping() = default;
@@ -103,7 +176,9 @@ public:
 
 	inline void clear()
 	{
-		_eventMapping.clear();
+		_actions.clear();
+		_program.clear();
+		_eventOps = {};
 		_description.clear();
 		_tapDurationMs = MAGIC_TAP_DURATION;
 		_hasViGEmBtn = false;
@@ -1,5 +1,28 @@
 #pragma once
 
+#include <span>
+
+// One reading of the IMU. Gyro in degrees per second, accel in g, deltaTime in seconds since the previous sample.
+struct MotionSample
+{
+	float gyroX = 0.f, gyroY = 0.f, gyroZ = 0.f;
+	float accelX = 0.f, accelY = 0.f, accelZ = 0.f;
+	float deltaTime = 0.f;
+};
+
+// The state after processing a batch of samples
+struct MotionResult
+{
+	// Calibrated gyro of the last sample
+	float gyroX = 0.f, gyroY = 0.f, gyroZ = 0.f;
+	float gravX = 0.f, gravY = 0.f, gravZ = 0.f;
+	float accelX = 0.f, accelY = 0.f, accelZ = 0.f; // Without gravity
+	float quatW = 1.f, quatX = 0.f, quatY = 0.f, quatZ = 0.f;
+	// Calibrated rotation in degrees over the whole batch, and the time it spans
+	float rotationX = 0.f, rotationY = 0.f, rotationZ = 0.f;
+	float deltaTime = 0.f;
+};
+
 class MotionIf
 {
 protected:
@@ -14,6 +37,9 @@ public:
 	virtual void ProcessMotion(float gyroX, float gyroY, float gyroZ,
 	  float accelX, float accelY, float accelZ, float deltaTime) = 0;
 
+	// Process all the samples received since the last call and read the resulting state at once
+	virtual MotionResult ProcessMotion(std::span<const MotionSample> samples) = 0;
+
 	// reading the current state
 	virtual void GetCalibratedGyro(float& x, float& y, float& z) = 0;
 	virtual void GetGravity(float& x, float& y, float& z) = 0;
@@ -26,6 +52,7 @@ public:
 	virtual void ResetContinuousCalibration() = 0;
 	virtual void GetCalibrationOffset(float& xOffset, float& yOffset, float& zOffset) = 0;
 	virtual void SetCalibrationOffset(float xOffset, float yOffset, float zOffset, int weight) = 0;
+	// Only call when the settings change: this restarts the calibration mode
 	virtual void SetAutoCalibration(bool enabled, float gyroThreshold, float accelThreshold) = 0;
 
 	void virtual ResetMotion() = 0;
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "JoyShockMapper.h"
+#include "ClockIf.h"
+#include "Gamepad.h"
+
+#include <initializer_list>
+#include <mutex>
+
+// Records what JSM emits instead of sending it to the system: keys, mouse motion and virtual controller state,
+// each with the time of the clock. --replay saves it to compare the output of an input trace with a golden output.
+// One line per event: <milliseconds> <kind> <target> <values...>
+class OutputCapture
+{
+public:
+	OutputCapture(shared_ptr<ClockIf> clock);
+
+	// While a capture is active, the output functions record into it and don't send anything
+	static void setActive(OutputCapture *capture);
+
+	// These record into the active capture and return true, or return false if there is none
+	static bool captureKey(KeyCode key, bool pressed);
+	static bool captureMouseMove(float x, float y);
+	static bool captureMouseAbsolute(float x, float y);
+
+	// A virtual controller of the scheme, or one that records into the active capture
+	static Gamepad *newGamepad(ControllerScheme scheme, Gamepad::Callback notification);
+
+	void record(string_view kind, string_view target, initializer_list<float> values);
+
+	bool save(string_view path);
+
+	// Compare two capture files line by line. Numbers may differ by the tolerance, everything else must match.
+	// Lists the differences in the report and returns true if there is none.
+	static bool compare(string_view expectedPath, string_view actualPath, float tolerance, ostream &report);
+
+private:
+	shared_ptr<ClockIf> _clock;
+	ClockIf::TimePoint _start;
+	vector<string> _lines;
+	mutex _lock;
+};
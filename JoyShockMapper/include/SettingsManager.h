@@ -3,6 +3,56 @@
 #include "JoyShockMapper.h"
 #include "JSMVariable.hpp"
 #include <unordered_map>
+#include <atomic>
+#include <vector>
+
+// The values of all settings and button bindings at one point in time. It never changes once published, so the
+// input thread can read it while commands modify the settings themselves.
+class SettingsSnapshot
+{
+public:
+	// Same as JSMSetting::chordedValue()
+	template<typename T>
+	optional<T> chordedValue(SettingID id, ButtonID chord) const
+	{
+		auto values = find<T>(id);
+		return values ? values->chordedValue(chord) : nullopt;
+	}
+
+	template<typename T>
+	optional<T> value(SettingID id) const
+	{
+		auto values = find<T>(id);
+		return values ? optional<T>(values->value) : nullopt;
+	}
+
+	// Bindings of the button, or nullptr if there is no such button
+	const FrozenButton *button(ButtonID id) const
+	{
+		size_t index = size_t(id);
+		return index < _buttons.size() ? _buttons[index].get() : nullptr;
+	}
+
+	// Increases with every publication
+	unsigned int version() const
+	{
+		return _version;
+	}
+
+private:
+	friend class SettingsManager;
+
+	template<typename T>
+	const FrozenValues<T> *find(SettingID id) const
+	{
+		size_t index = size_t(id);
+		return index < _values.size() ? dynamic_cast<const FrozenValues<T> *>(_values[index].get()) : nullptr;
+	}
+
+	unsigned int _version = 0;
+	vector<shared_ptr<const FrozenVariable>> _values; // Indexed by SettingID
+	vector<shared_ptr<const FrozenButton>> _buttons;  // Indexed by ButtonID
+};
 
 class SettingsManager
 {
@@ -39,11 +89,65 @@ public:
 		return nullptr;
 	}
 
+	// The buttons of the vector get published along with the settings. The vector can change size between publications.
+	static void addButtons(const vector<JSMButton> *buttons);
+
 	static void resetAllSettings();
 
+	// Settings that resetAllSettings() leaves alone
+	static bool isKeptOnReset(SettingID id);
+
+	// Same, for the variable of a command. Works for settings whose name magic_enum can't find.
+	static bool isKeptOnReset(const JSMVariableBase *setting);
+
+	// Copy the current values of the settings that resetAllSettings() leaves alone
+	static vector<pair<SettingID, shared_ptr<const FrozenVariable>>> freezeKeptSettings();
+
+	// Whether the settings that resetAllSettings() leaves alone still have the values of a copy
+	static bool keptSettingsMatch(const vector<pair<SettingID, shared_ptr<const FrozenVariable>>> &values);
+
+	// Copy the current values of the settings and buttons, without publishing them
+	static shared_ptr<SettingsSnapshot> freeze();
+
+	// Set the settings that resetAllSettings() resets back to the values of a copy. Listeners are notified of the
+	// values that change, and the next publication makes them visible.
+	static void thaw(const SettingsSnapshot &values);
+
+	// Make the current values of the settings visible to snapshot() readers.
+	// Call from the thread that processes commands, unless a Transaction is ongoing.
+	static void publish();
+
+	// The latest published values. Threads grab it once per tick and read settings from it.
+	static shared_ptr<const SettingsSnapshot> snapshot()
+	{
+		return _snapshot.load(memory_order_acquire);
+	}
+
+	// All the changes made while a transaction exists get published together, when the outermost one ends.
+	class Transaction
+	{
+	public:
+		Transaction()
+		{
+			++_transactionDepth;
+		}
+
+		~Transaction()
+		{
+			if (--_transactionDepth == 0)
+				publish();
+		}
+
+		Transaction(const Transaction &) = delete;
+		Transaction &operator=(const Transaction &) = delete;
+	};
+
 private:
 	using SettingsMap = unordered_map<SettingID, shared_ptr<JSMVariableBase>>;
 	static SettingsMap _settings;
+	static vector<const vector<JSMButton> *> _buttons;
+	static atomic<shared_ptr<const SettingsSnapshot>> _snapshot;
+	static int _transactionDepth;
 };
 
 extern map<int, ButtonID> nnm;
\ No newline at end of file
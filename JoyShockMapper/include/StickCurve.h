@@ -0,0 +1,52 @@
+#pragma once
+
+#include "JoyShockMapper.h"
+
+#include <array>
+
+// pow(x, exponent) for x between 0 and 1, interpolated from a table built when the exponent changes
+// so processing a stick doesn't call pow() on every tick.
+class PowerCurve
+{
+public:
+	// Build the table again if the exponent is different from the current one
+	void setExponent(float exponent);
+
+	inline float exponent() const
+	{
+		return _exponent;
+	}
+
+	// Whether operator() interpolates the table rather than calling pow()
+	inline bool usesTable() const
+	{
+		return _useTable;
+	}
+
+	// Same as pow(x, exponent()) to within MAX_ERROR
+	float operator()(float x) const;
+
+private:
+	static constexpr int SEGMENTS = 512;
+	// Largest difference with pow() allowed for the table to be used, finer than the 12 bit resolution of most sticks.
+	// Exponents the table can't follow this closely, like very small or very large ones, keep calling pow().
+	static constexpr float MAX_ERROR = 0.00025f;
+
+	float _exponent = 1.f;
+	bool _useTable = false;
+	// Entries are evenly spaced in sqrt(x), which keeps exponents below 1 accurate near 0 where they are steep.
+	// Exponents below 0.5 are still too steep there, and space them in the fourth root of x instead.
+	bool _fourthRoot = false;
+	array<float, SEGMENTS + 1> _table = {};
+};
+
+// Turns a strength into the deflection of a virtual stick and back, according to the UNDEADZONE and UNPOWER settings of that stick
+struct VirtualStickCurve
+{
+	float undeadzoneInner = 0.f;
+	float livezoneSize = 1.f; // Part of the stick range between the undeadzones
+	PowerCurve unpower; // Strength of a position in the livezone
+	PowerCurve inverse; // Position in the livezone for a strength
+
+	void update(float inner, float outer, float unpowerExponent);
+};
@@ -8,13 +8,21 @@ namespace JSM
 {
 
 AutoConnect::AutoConnect(shared_ptr<JslWrapper> joyshock, bool start)
-  : PollingThread("AutoConnect thread", std::bind(&AutoConnect::AutoConnectPoll, this, std::placeholders::_1), nullptr, 1000, start)
+  : PollingThread("AutoConnect thread", std::bind(&AutoConnect::AutoConnectPoll, this, std::placeholders::_1), nullptr, 0, false)
   , jsl(joyshock)
 {
+	// Start only once jsl is set
+	if (start)
+		Start();
 }
 
 bool AutoConnect::AutoConnectPoll(void* param)
 {
+	// Wake up on hotplug events only. The timeout lets the thread notice when it is stopped.
+	if (!jsl->WaitForDeviceChange(1000))
+	{
+		return true;
+	}
 	int realSize = jsl->GetDeviceCount() - Gamepad::getCount();
 	if(lastSize != realSize)
 	{
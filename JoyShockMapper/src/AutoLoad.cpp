@@ -1,49 +1,72 @@
 #include "AutoLoad.h"
 
-// https://stackoverflow.com/a/4119881/1130520 gives us case insensitive equality
-static bool iequals(const string& a, const string& b)
+static string toLower(string str)
 {
-	return equal(a.begin(), a.end(),
-	  b.begin(), b.end(),
-	  [](char a, char b)
-	  {
-		  return tolower(a) == tolower(b);
-	  });
+	transform(str.begin(), str.end(), str.begin(), [](char c)
+	  { return char(tolower(c)); });
+	return str;
 }
+
 namespace JSM
 {
 
 AutoLoad::AutoLoad(CmdRegistry* commandRegistry, bool start)
-  : PollingThread("AutoLoad thread", bind(&AutoLoad::AutoLoadPoll, this, placeholders::_1), (void*)commandRegistry, 1000, start)
+  : PollingThread("AutoLoad thread", bind(&AutoLoad::AutoLoadPoll, this, placeholders::_1), (void*)commandRegistry, 0, false)
+{
+	// Start only once the members used by the thread are constructed
+	if (start)
+		Start();
+}
+
+AutoLoad::~AutoLoad()
 {
+	// Before the members the loop uses are destroyed
+	Join();
+}
+
+string AutoLoad::findProfile(const string& noextmodule)
+{
+	string folder(AUTOLOAD_FOLDER());
+	bool folderChanged = folder != _folder || !_folderWatcher;
+	if (folderChanged)
+	{
+		_folder = folder;
+		_folderWatcher = make_unique<DirectoryWatcher>(_folder);
+	}
+	// The index is only rebuilt when files are added, removed or renamed
+	if (folderChanged || _folderWatcher->hasChanged())
+	{
+		_profiles.clear();
+		for (auto file : ListDirectory(_folder))
+		{
+			_profiles.emplace(toLower(file.substr(0, file.find_first_of('.'))), file);
+		}
+	}
+	auto found = _profiles.find(toLower(noextmodule));
+	return found != _profiles.end() ? found->second : string();
 }
 
 bool AutoLoad::AutoLoadPoll(void* param)
 {
-	auto registry = reinterpret_cast<CmdRegistry*>(param);
-	static string lastModuleName;
+	// Wake up on focus changes only. The timeout lets the thread notice when it is stopped.
+	if (!_firstPoll && !WaitForActiveWindowChange(1000))
+	{
+		return true;
+	}
+	_firstPoll = false;
 	string windowTitle, windowModule;
 	tie(windowModule, windowTitle) = GetActiveWindowName();
-	if (!windowModule.empty() && windowModule != lastModuleName && windowModule.compare("JoyShockMapper.exe") != 0)
+	if (!windowModule.empty() && windowModule != _lastModuleName && windowModule.compare("JoyShockMapper.exe") != 0)
 	{
-		lastModuleName = windowModule;
-		string path(AUTOLOAD_FOLDER());
-		auto files = ListDirectory(path);
+		_lastModuleName = windowModule;
 		auto noextmodule = windowModule.substr(0, windowModule.find_first_of('.'));
 		COUT_INFO << "[AUTOLOAD] \"" << windowTitle << "\" in focus: "; // looking for config : " , );
-		bool success = false;
-		for (auto file : files)
+		if (auto file = findProfile(noextmodule); !file.empty())
 		{
-			auto noextconfig = file.substr(0, file.find_first_of('.'));
-			if (iequals(noextconfig, noextmodule))
-			{
-				COUT_INFO << "loading \"AutoLoad\\" << noextconfig << ".txt\".\n";
-				WriteToConsole(path + file);
-				success = true;
-				break;
-			}
+			COUT_INFO << "loading \"AutoLoad\\" << file.substr(0, file.find_first_of('.')) << ".txt\".\n";
+			WriteToConsole(_folder + file);
 		}
-		if (!success)
+		else
 		{
 			COUT_INFO << "create ";
 			COUT << "AutoLoad\\" << noextmodule << ".txt";
@@ -53,4 +76,4 @@ bool AutoLoad::AutoLoadPoll(void* param)
 	return true;
 }
 
-} // namespace JSM
\ No newline at end of file
+} // namespace JSM
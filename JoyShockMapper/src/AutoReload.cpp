@@ -0,0 +1,50 @@
+#include "AutoReload.h"
+#include "CmdRegistry.h"
+
+
+namespace JSM
+{
+
+AutoReload::AutoReload(CmdRegistry* commandRegistry, bool start)
+  : PollingThread("AutoReload thread", std::bind(&AutoReload::AutoReloadPoll, this, std::placeholders::_1), nullptr, 0, false)
+  , _commandRegistry(commandRegistry)
+{
+	// Start only once the registry is set
+	if (start)
+		Start();
+}
+
+AutoReload::~AutoReload()
+{
+	// Before the members the loop uses are destroyed
+	Join();
+}
+
+bool AutoReload::AutoReloadPoll(void* param)
+{
+	// Files loaded since the last poll get watched from now on
+	for (auto& path : _commandRegistry->getLoadedFiles())
+	{
+		_watcher.watch(path);
+	}
+	// Wake up on file changes only. The timeout lets the thread notice when it is stopped or new files are loaded.
+	if (!_watcher.wait(500))
+	{
+		return true;
+	}
+	for (auto& path : _watcher.changedFiles())
+	{
+		auto changed = _commandRegistry->getChangedAssignments(path);
+		if (changed.empty())
+			continue;
+		COUT_INFO << "[AUTORELOAD] " << path << " changed: applying " << changed.size() << " assignment" << (changed.size() > 1 ? "s" : "") << ".\n";
+		// Run by the main thread, like commands typed in the console
+		for (auto& line : changed)
+		{
+			WriteToConsole(line);
+		}
+	}
+	return true;
+}
+
+} // namespace JSM
@@ -1,11 +1,14 @@
 #include "CmdRegistry.h"
+#include "JSMVariable.hpp"
 #include "PlatformDefinitions.h"
+#include "SettingsManager.h"
 
 #include <cctype>
 #include <iostream>
 #include <memory>
 #include <regex>
 #include <string>
+#include <sstream>
 #include <fstream>
 
 JSMCommand::JSMCommand(string_view name)
@@ -42,6 +45,7 @@ unique_ptr<JSMCommand> JSMCommand::getModifiedCmd(char op, string_view chord)
 bool JSMCommand::parseData(string_view arguments, string_view label)
 {
 	_ASSERT_EXPR(_parse, L"There is no function defined to parse this command.");
+	_failed = false;
 	if (arguments.compare("HELP") == 0)
 	{
 		// Parsing has failed. Show help.
@@ -49,6 +53,7 @@ bool JSMCommand::parseData(string_view arguments, string_view label)
 	}
 	else if (!_parse(this, arguments, label))
 	{
+		_failed = true;
 		CERR << _help << '\n';
 	}
 	return true; // Command is completely processed
@@ -72,27 +77,215 @@ bool CmdRegistry::loadConfigFile(string fileName)
 	if (*fileName.begin() == '\"' && *(fileName.end() - 1) == '\"')
 		fileName = fileName.substr(1, fileName.size() - 2);
 
-	ifstream file(fileName);
+	string path = fileName;
+	ifstream file(path);
 	if (!file.is_open())
 	{
-		file.open(string{ BASE_JSM_CONFIG_FOLDER() } + fileName);
+		path = string{ BASE_JSM_CONFIG_FOLDER() } + fileName;
+		file.open(path);
 	}
 	if (file)
 	{
 		COUT << "Loading commands from file ";
 		COUT_INFO << fileName << '\n';
+		if (_loadDepth == 0)
+		{
+			if (restoreCachedFile(path))
+				return true;
+			_cacheable = true;
+		}
+		int resetCount = _resetCount;
+		++_loadDepth;
 		// https://stackoverflow.com/questions/6892754/creating-a-simple-configuration-file-and-parser-in-c
 		string line;
-		while (getline(file, line))
+		string key;
+		LoadedFile loaded{ path, _assignmentSequence };
 		{
-			processLine(line);
+			// Listeners doing heavy work run once per file rather than once per line
+			NotificationBatch notificationBatch;
+			while (getline(file, line))
+			{
+				processLine(line);
+				// Numbered as it is processed, so the assignments of a nested file fall between those before and after it
+				auto trimmedLine = strtrim(line);
+				if (assignmentKey(trimmedLine, key))
+					loaded.assignments[key] = { string(trimmedLine), ++_assignmentSequence };
+				if (!trimmedLine.empty() && trimmedLine.front() != '#')
+					loaded.lines.emplace_back(trimmedLine, _assignmentSequence);
+			}
 		}
 		file.close();
+		--_loadDepth;
+
+		{
+			lock_guard guard(_loadedFilesLock);
+			erase_if(_loadedFiles, [&path](const LoadedFile& loaded)
+			  { return loaded.path == path; });
+			_loadedFiles.push_back(move(loaded));
+		}
+		// Without a reset, the state depends on what was there before
+		if (_loadDepth == 0 && _cacheable && _resetCount != resetCount && _captureState)
+			cacheFile(path);
 		return true;
 	}
 	return false;
 }
 
+bool CmdRegistry::assignmentKey(string_view line, string& key)
+{
+	// An assignment is keyed by what is left of the equal sign, without spaces: "GYRO_SENS", "R,S" or "L+R"
+	auto equal = line.find('=');
+	if (line.empty() || line.front() == '#' || equal == string_view::npos || line.find('#') < equal)
+		return false;
+	key.clear();
+	for (char c : line.substr(0, equal))
+	{
+		if (!isspace(c))
+			key.push_back(c);
+	}
+	return !key.empty();
+}
+
+vector<string> CmdRegistry::getLoadedFiles() const
+{
+	lock_guard guard(_loadedFilesLock);
+	vector<string> paths;
+	for (auto& loaded : _loadedFiles)
+	{
+		paths.push_back(loaded.path);
+	}
+	return paths;
+}
+
+void CmdRegistry::clearLoadedFiles()
+{
+	lock_guard guard(_loadedFilesLock);
+	_loadedFiles.clear();
+	++_resetCount;
+}
+
+void CmdRegistry::setStateCapture(CaptureDelegate capture)
+{
+	_captureState = capture;
+	_cachedFiles.clear();
+}
+
+bool CmdRegistry::restoreCachedFile(const string& path)
+{
+	auto cached = find_if(_cachedFiles.begin(), _cachedFiles.end(), [&path](const CachedFile& cached)
+	  { return cached.path == path; });
+	if (cached == _cachedFiles.end())
+		return false;
+	bool unchanged = all_of(cached->sources.begin(), cached->sources.end(), [](auto& source)
+	  {
+		error_code error;
+		auto time = filesystem::last_write_time(source.first, error);
+		return !error && time == source.second; });
+	if (!unchanged || !SettingsManager::keptSettingsMatch(cached->keptSettings))
+	{
+		_cachedFiles.erase(cached);
+		return false;
+	}
+	_cachedFiles.splice(_cachedFiles.begin(), _cachedFiles, cached);
+	{
+		// Only the values that differ from the current ones notify their listeners
+		NotificationBatch notificationBatch;
+		cached->state->restore();
+	}
+	lock_guard guard(_loadedFilesLock);
+	_loadedFiles = cached->loadedFiles;
+	return true;
+}
+
+void CmdRegistry::cacheFile(const string& path)
+{
+	CachedFile cached{ path };
+	{
+		lock_guard guard(_loadedFilesLock);
+		cached.loadedFiles = _loadedFiles;
+	}
+	for (auto& loaded : cached.loadedFiles)
+	{
+		error_code error;
+		auto time = filesystem::last_write_time(loaded.path, error);
+		if (error)
+			return;
+		cached.sources.emplace_back(loaded.path, time);
+	}
+	cached.keptSettings = SettingsManager::freezeKeptSettings();
+	cached.state = _captureState();
+	erase_if(_cachedFiles, [&path](const CachedFile& cached)
+	  { return cached.path == path; });
+	_cachedFiles.push_front(move(cached));
+	if (_cachedFiles.size() > MAX_CACHED_FILES)
+		_cachedFiles.pop_back();
+}
+
+vector<string> CmdRegistry::getChangedAssignments(string_view path)
+{
+	ifstream file{ string(path) };
+	if (!file)
+		return {};
+
+	lock_guard guard(_loadedFilesLock);
+	auto loaded = find_if(_loadedFiles.begin(), _loadedFiles.end(), [path](const LoadedFile& loaded)
+	  { return loaded.path == path; });
+	if (loaded == _loadedFiles.end())
+		return {};
+	// A line that was there before keeps its place among the assignments of all the files, nested ones included.
+	// A new line takes the place of the line before it.
+	vector<pair<string, uint64_t>> lines;
+	map<string, size_t> lastAssignments; // Index in lines of the last assignment of each key
+	uint64_t position = loaded->start;
+	auto match = loaded->lines.begin();
+	string key;
+	for (string line; getline(file, line);)
+	{
+		auto trimmedLine = strtrim(line);
+		if (trimmedLine.empty() || trimmedLine.front() == '#')
+			continue;
+		auto found = find_if(match, loaded->lines.end(), [trimmedLine](auto& previous)
+		  { return previous.first == trimmedLine; });
+		if (found != loaded->lines.end())
+		{
+			position = found->second;
+			match = found + 1;
+		}
+		if (assignmentKey(trimmedLine, key))
+			lastAssignments[key] = lines.size();
+		lines.emplace_back(trimmedLine, position);
+	}
+	// In the order of the file, since some assignments depend on others, like bindings on VIRTUAL_CONTROLLER
+	vector<size_t> order;
+	for (auto& [key, index] : lastAssignments)
+	{
+		order.push_back(index);
+	}
+	sort(order.begin(), order.end());
+	vector<string> changed;
+	map<string, Assignment> assignments;
+	for (size_t index : order)
+	{
+		auto& [line, sequence] = lines[index];
+		assignmentKey(line, key);
+		auto previous = loaded->assignments.find(key);
+		bool overridden = any_of(_loadedFiles.begin(), _loadedFiles.end(), [&](const LoadedFile& other)
+		  {
+			  auto assignment = other.assignments.find(key);
+			  return &other != &*loaded && assignment != other.assignments.end() && assignment->second.sequence > sequence; });
+		if ((previous == loaded->assignments.end() || previous->second.line != line) && !overridden)
+		{
+			changed.push_back(line);
+			sequence = ++_assignmentSequence;
+		}
+		assignments[key] = { line, sequence };
+	}
+	// Removed assignments keep their value until the file is loaded again
+	loaded->lines = move(lines);
+	loaded->assignments = move(assignments);
+	return changed;
+}
+
 string_view CmdRegistry::strtrim(string_view str)
 {
 	if (str.empty())
@@ -182,7 +375,7 @@ bool CmdRegistry::isCommandValid(string_view line) const
 	return cmd != _registry.end();
 }
 
-void CmdRegistry::processLine(const string& line)
+bool CmdRegistry::processLine(const string& line)
 {
 	auto trimmedLine = string{ strtrim(line) };
 
@@ -212,13 +405,20 @@ void CmdRegistry::processLine(const string& line)
 			label = results[6];
 		}
 
+		// A file can only be restored from the cache if its lines don't do anything else than reset and assign
+		string key;
+		if (name != "RESET_MAPPINGS" && (!assignmentKey(trimmedLine, key) || SettingsManager::isKeptOnReset(GetVariable(name))))
+			_cacheable = false;
+
 		bool hasProcessed = false;
+		bool hasFailed = false;
 		CmdMap::iterator cmd = find_if(_registry.begin(), _registry.end(), bind(&CmdRegistry::findCommandWithName, name, placeholders::_1));
 		while (cmd != _registry.end())
 		{
 			if (combo.empty())
 			{
 				hasProcessed |= cmd->second->parseData(arguments, label);
+				hasFailed |= cmd->second->hasFailed();
 			}
 			else
 			{
@@ -226,6 +426,7 @@ void CmdRegistry::processLine(const string& line)
 				if (modCommand)
 				{
 					hasProcessed |= modCommand->parseData(arguments, label);
+					hasFailed |= modCommand->hasFailed();
 				}
 				// Any task set to be run on destruction is done here.
 			}
@@ -238,8 +439,10 @@ void CmdRegistry::processLine(const string& line)
 			COUT_INFO << "HELP";
 			CERR << " to display all commands.\n";
 		}
+		return hasProcessed && !hasFailed;
 	}
 	// else ignore empty lines
+	return true;
 }
 
 void CmdRegistry::GetCommandList(vector<string_view>& outList) const
@@ -265,18 +468,28 @@ string_view CmdRegistry::GetHelp(string_view command) const
 	return "";
 }
 
+const JSMVariableBase* CmdRegistry::GetVariable(string_view command) const
+{
+	auto cmd = _registry.find(command);
+	return cmd != _registry.end() ? cmd->second->variable() : nullptr;
+}
+
 bool JSMMacro::DefaultParser(JSMCommand* cmd, string_view arguments, string_view label)
 {
 	// Default macro parser assumes no argument and calls macro when called.
 	auto macroCmd = static_cast<JSMMacro*>(cmd);
 	// Developper protection to remind you to set a parser.
 	_ASSERT_EXPR(macroCmd->_macro, L"No Macro was set for this command.");
-	if (!macroCmd->_macro(macroCmd, arguments) && !macroCmd->_help.empty())
+	if (!macroCmd->_macro(macroCmd, arguments))
 	{
-		COUT << macroCmd->_help << '\n';
-		COUT << "The "; // Parsing has failed. Show help.
-		COUT_INFO << "README";
-		COUT << " command can lead you to further details on this command.\n";
+		macroCmd->_failed = true;
+		if (!macroCmd->_help.empty())
+		{
+			COUT << macroCmd->_help << '\n';
+			COUT << "The "; // Parsing has failed. Show help.
+			COUT_INFO << "README";
+			COUT << " command can lead you to further details on this command.\n";
+		}
 	}
 	return true;
 }
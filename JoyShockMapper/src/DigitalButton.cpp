@@ -2,6 +2,7 @@
 #include "JSMVariable.hpp"
 #include "InputHelpers.h"
 #include "SettingsManager.h"
+#include "OutputCapture.h"
 
 void DigitalButton::Context::updateChordStack(bool isPressed, ButtonID id)
 {
@@ -40,9 +41,9 @@ struct Sync
 };
 
 // Hidden implementation of the digital button
-// This class holds all the logic related to a single digital button. It does not hold the mapping but only a reference
-// to it. It also contains its various states, flags and data. The concrete state of the state machine hands off the
-// instance to the next state, and so is persistent across states
+// This class holds all the logic related to a single digital button. It does not hold the mapping but reads it from the
+// settings of the current tick. It also contains its various states, flags and data. The concrete state of the state
+// machine hands off the instance to the next state, and so is persistent across states
 struct DigitalButtonImpl : public pocket_fsm::PimplBase, public EventActionIf
 {
 private:
@@ -52,7 +53,7 @@ private:
 	};
 
 public:
-	multimap<BtnEvent, Callback> _instantReleaseQueue;
+	multimap<BtnEvent, DeferredAction> _instantReleaseQueue;
 	unsigned int _turboApplies = 0;
 	unsigned int _turboReleases = 0;
 	DigitalButtonImpl(JSMButton &mapping, shared_ptr<DigitalButton::Context> context)
@@ -60,7 +61,6 @@ public:
 	  , _context(context)
 	  , _press_times()
 	  , _keyToRelease()
-	  , _mapping(mapping)
 	  , _instantReleaseQueue()
 	{
 	}
@@ -70,9 +70,27 @@ public:
 	shared_ptr<DigitalButton::Context> _context;
 	chrono::steady_clock::time_point _press_times;
 	optional<Mapping> _keyToRelease; // At key press, remember what to release
-	const JSMButton &_mapping;
 	DigitalButton *_masterPress = nullptr; // Who is this button's master in either sim or diag presses
 
+	// Bindings of this button in the settings of the current tick
+	const FrozenButton &mapping() const
+	{
+		static const FrozenButton unmapped = []()
+		{
+			FrozenButton button;
+			button.value = Mapping::NO_MAPPING;
+			button.chorded = true;
+			return button;
+		}();
+		auto button = _context->settings->button(_id);
+		return button ? *button : unmapped;
+	}
+
+	float SimPressWindow() const
+	{
+		return _context->settings->value<float>(SettingID::SIM_PRESS_WINDOW).value_or(50.f);
+	}
+
 	// Pretty wrapper
 	inline float GetPressDurationMS(chrono::steady_clock::time_point time_now)
 	{
@@ -104,7 +122,7 @@ public:
 		for (auto i = range.first; i != range.second; ++i)
 		{
 			// DEBUG_LOG << "Button " << _id << " releases instant " << instantEvent << '\n';
-			i->second(this);
+			i->second.run(*this);
 		}
 		_instantReleaseQueue.erase(range.first, range.second);
 		return true;
@@ -117,11 +135,11 @@ public:
 			// Look at active chord mappings starting with the latest activates chord
 			for (auto activeChord = _context->chordStack.cbegin(); activeChord != _context->chordStack.cend(); activeChord++)
 			{
-				auto binding = _mapping.chordedValue(*activeChord);
+				auto binding = mapping().chordedValue(*activeChord);
 				if (binding && *activeChord != _id)
 				{
 					_keyToRelease = *binding;
-					_nameToRelease = _mapping.getName(*activeChord);
+					_nameToRelease = mapping().getName(*activeChord);
 					return _keyToRelease;
 				}
 			}
@@ -131,13 +149,10 @@ public:
 		return _keyToRelease;
 	}
 
-	void RegisterInstant(BtnEvent evt, Callback cb) override
+	void RegisterInstant(BtnEvent evt, const DeferredAction &action) override
 	{
-		if (cb)
-		{
-			// DEBUG_LOG << "Button " << _id << " registers instant " << evt << '\n';
-			_instantReleaseQueue.emplace(evt, cb);
-		}
+		// DEBUG_LOG << "Button " << _id << " registers instant " << evt << '\n';
+		_instantReleaseQueue.emplace(evt, action);
 	}
 
 	void ApplyGyroAction(KeyCode gyroAction) override
@@ -212,22 +227,24 @@ public:
 		DEBUG_LOG << "Releasing key " << key.name << endl;
 	}
 
-	void ApplyButtonToggle(KeyCode key, EventActionIf::Callback apply, EventActionIf::Callback release) override
+	void ApplyButtonToggle(const KeyAction &action) override
 	{
-		auto currentlyActive = find_if(_context->activeTogglesQueue.begin(), _context->activeTogglesQueue.end(),
-		  [this, key](pair<ButtonID, KeyCode> pair)
-		  {
-			  return pair.first == _id && pair.second == key;
-		  });
-		if (currentlyActive == _context->activeTogglesQueue.end())
+		const KeyCode &key = action.key;
+		auto isThisToggle = [this, &key](const pair<ButtonID, KeyCode> &pair)
+		{
+			return pair.first == _id && pair.second == key;
+		};
+		if (find_if(_context->activeTogglesQueue.begin(), _context->activeTogglesQueue.end(), isThisToggle) == _context->activeTogglesQueue.end())
 		{
 			DEBUG_LOG << "Adding active toggle for " << key.name << '\n';
-			apply(this);
+			action.apply(*this);
 			_context->activeTogglesQueue.push_front({ _id, key });
 		}
 		else
 		{
-			release(this); // The bound action here should always erase the active toggle from the queue
+			// Key releases clear the toggles of the key themselves, but other kinds of actions like commands don't
+			action.release(*this);
+			erase_if(_context->activeTogglesQueue, isThisToggle);
 		}
 	}
 
@@ -513,16 +530,16 @@ class NoPress : public DigitalButtonState
 	{
 		DigitalButtonState::react(e);
 		pimpl()->_press_times = e.time_now;
-		if (pimpl()->_mapping.hasSimMappings() && pimpl()->GetPressDurationMS(e.time_now) < SettingsManager::getV<float>(SettingID::SIM_PRESS_WINDOW)->value())
+		if (pimpl()->mapping().hasSimMappings() && pimpl()->GetPressDurationMS(e.time_now) < pimpl()->SimPressWindow())
 		{
 			changeState<WaitSim>();
 		}
-		else if (pimpl()->_mapping.getDblPressMap())
+		else if (pimpl()->mapping().getDblPressMap())
 		{
 			// Start counting time between two start presses
 			changeState<DblPressStart>();
 		}
-		else if (pimpl()->_mapping.hasDiagMappings())
+		else if (pimpl()->mapping().hasDiagMappings())
 		{
 			size_t counter = 0;
 			optional<MapIterator> diag = nullopt;
@@ -531,8 +548,8 @@ class NoPress : public DigitalButtonState
 			{
 				// DEBUG_LOG << "Button " << pimpl()->_id << " enables diagonal press with " << btn->_id << " who is in state " << btn->getCurrentStateName() << '\n';
 				pimpl()->_masterPress = btn;
-				pimpl()->_nameToRelease = pimpl()->_mapping.getDiagPressName((*diag)->first);
-				pimpl()->_keyToRelease = (*diag)->second.value();
+				pimpl()->_nameToRelease = pimpl()->mapping().getDiagPressName((*diag)->first);
+				pimpl()->_keyToRelease = (*diag)->second;
 				Sync sync;
 				sync.nameToRelease = pimpl()->_nameToRelease;
 				sync.activeMapping = &*pimpl()->_keyToRelease;
@@ -687,9 +704,9 @@ class WaitSim : public DigitalButtonState
 		if (simBtn)
 		{
 			changeState<SimPressSlave>();
-			pimpl()->_press_times = e.time_now;                                          // reset Timer
-			pimpl()->_keyToRelease = pimpl()->_mapping.atSimPress(simBtn->_id)->value(); // Make a copy
-			pimpl()->_nameToRelease = pimpl()->_mapping.getSimPressName(simBtn->_id);
+			pimpl()->_press_times = e.time_now;                                // reset Timer
+			pimpl()->_keyToRelease = pimpl()->mapping().simPress(simBtn->_id); // Make a copy
+			pimpl()->_nameToRelease = pimpl()->mapping().getSimPressName(simBtn->_id);
 			pimpl()->_masterPress = simBtn; // Second to press is the slave
 
 			Sync sync;
@@ -700,15 +717,15 @@ class WaitSim : public DigitalButtonState
 			sync.dblPressWindow = e.dblPressWindow;
 			simBtn->sendEvent(sync);
 		}
-		else if (pimpl()->GetPressDurationMS(e.time_now) > SettingsManager::getV<float>(SettingID::SIM_PRESS_WINDOW)->value())
+		else if (pimpl()->GetPressDurationMS(e.time_now) > pimpl()->SimPressWindow())
 		{
 			// Button is still pressed but Sim delay did expire
-			if (pimpl()->_mapping.getDblPressMap())
+			if (pimpl()->mapping().getDblPressMap())
 			{
 				// Start counting time between two start presses
 				changeState<DblPressStart>();
 			}
-			else if (pimpl()->_mapping.hasDiagMappings())
+			else if (pimpl()->mapping().hasDiagMappings())
 			{
 				size_t counter = 0;
 				optional<MapIterator> diag = nullopt;
@@ -717,8 +734,8 @@ class WaitSim : public DigitalButtonState
 				{
 					// DEBUG_LOG << "Button " << pimpl()->_id << " enables diagonal press with " << btn->_id << " who is in state " << btn->getCurrentStateName() << '\n';
 					pimpl()->_masterPress = btn;
-					pimpl()->_nameToRelease = pimpl()->_mapping.getDiagPressName((*diag)->first);
-					pimpl()->_keyToRelease = (*diag)->second.value();
+					pimpl()->_nameToRelease = pimpl()->mapping().getDiagPressName((*diag)->first);
+					pimpl()->_keyToRelease = (*diag)->second;
 					Sync sync;
 					sync.nameToRelease = pimpl()->_nameToRelease;
 					sync.activeMapping = &*pimpl()->_keyToRelease;
@@ -751,7 +768,7 @@ class WaitSim : public DigitalButtonState
 	{
 		DigitalButtonState::react(e);
 		// Button was released before sim delay expired
-		if (pimpl()->_mapping.getDblPressMap())
+		if (pimpl()->mapping().getDblPressMap())
 		{
 			// Start counting time between two start presses
 			changeState<DblPressStart>();
@@ -841,7 +858,7 @@ class DiagPressSlave : public DigitalButtonState
 			{
 				// DEBUG_LOG << pimpl()->_id << " is performing the swap!\n";
 				pimpl()->_masterPress->swapState(*me);
-				//DEBUG_LOG << pimpl()->_id << " is now in state " << getState() << " with mapping " << pimpl()->_nameToRelease << " set to " << pimpl()->_mapping.value() << '\n';
+				//DEBUG_LOG << pimpl()->_id << " is now in state " << getState() << " with mapping " << pimpl()->_nameToRelease << " set to " << pimpl()->mapping().value() << '\n';
 				//DEBUG_LOG << pimpl()->_masterPress->_id << " is now in state " << pimpl()->_masterPress->getState() << '\n';
 			}
 			else
@@ -941,8 +958,8 @@ class DblPressNoPressTap : public DigitalButtonState
 		}
 		else
 		{
-			pimpl()->_keyToRelease = pimpl()->_mapping.getDblPressMap()->second;
-			pimpl()->_nameToRelease = pimpl()->_mapping.getName(pimpl()->_id);
+			pimpl()->_keyToRelease = pimpl()->mapping().getDblPressMap()->second;
+			pimpl()->_nameToRelease = pimpl()->mapping().getName(pimpl()->_id);
 			pimpl()->_press_times = e.time_now;
 			changeState<DblPressPress>();
 		}
@@ -975,8 +992,8 @@ class DblPressNoPressHold : public DigitalButtonState
 		{
 			changeState<DblPressPress>();
 			pimpl()->_press_times = e.time_now;
-			pimpl()->_keyToRelease = pimpl()->_mapping.getDblPressMap()->second;
-			pimpl()->_nameToRelease = pimpl()->_mapping.getName(pimpl()->_id);
+			pimpl()->_keyToRelease = pimpl()->mapping().getDblPressMap()->second;
+			pimpl()->_nameToRelease = pimpl()->mapping().getName(pimpl()->_id);
 		}
 	}
 
@@ -1000,8 +1017,8 @@ class DblPressPress : public pocket_fsm::NestedStateMachine<ActiveMappingState,
 	override
 	{
 		DigitalButtonState::react(e);
-		pimpl()->_keyToRelease = pimpl()->_mapping.getDblPressMap()->second;
-		pimpl()->_nameToRelease = pimpl()->_mapping.getName(pimpl()->_id);
+		pimpl()->_keyToRelease = pimpl()->mapping().getDblPressMap()->second;
+		pimpl()->_nameToRelease = pimpl()->mapping().getName(pimpl()->_id);
 		initialize(new ActiveStartPress(_pimpl));
 	}
 
@@ -1043,15 +1060,16 @@ DigitalButton::DigitalButton(shared_ptr<DigitalButton::Context> _context, JSMBut
 	initialize(new NoPress(new DigitalButtonImpl(mapping, _context)));
 }
 
-DigitalButton::Context::Context(Gamepad::Callback virtualControllerCallback, shared_ptr<MotionIf> mainMotion)
+DigitalButton::Context::Context(Gamepad::Callback virtualControllerCallback, shared_ptr<MotionIf> mainMotion, shared_ptr<ClockIf> clock)
   : rightMainMotion(mainMotion)
+  , clock(clock)
+  , settings(SettingsManager::snapshot())
 {
 	chordStack.push_front(ButtonID::NONE); // Always hold mapping none at the end to _handle modeshifts and chords
-#ifdef _WIN32
 	auto virtual_controller = SettingsManager::getV<ControllerScheme>(SettingID::VIRTUAL_CONTROLLER);
 	if (virtual_controller->value() != ControllerScheme::NONE)
 	{
-		_vigemController.reset(Gamepad::getNew(virtual_controller->value(), virtualControllerCallback));
+		_vigemController.reset(OutputCapture::newGamepad(virtual_controller->value(), virtualControllerCallback));
 		string error;
 		if (!_vigemController->isInitialized(&error))
 		{
@@ -1062,5 +1080,4 @@ DigitalButton::Context::Context(Gamepad::Callback virtualControllerCallback, sha
 			CERR << error << '\n';
 		}
 	}
-#endif
 }
@@ -0,0 +1,117 @@
+#include "GyroCalibrationCache.h"
+#include "PlatformDefinitions.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+// File layout, in native byte order:
+// magic, version, entry count, then for each entry: identity length, identity, x, y and z offsets
+constexpr char MAGIC[4] = { 'J', 'S', 'M', 'G' };
+constexpr uint32_t VERSION = 1;
+
+template<typename T>
+bool readValue(istream &in, T &value)
+{
+	return bool(in.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+
+template<typename T>
+void writeValue(ostream &out, const T &value)
+{
+	out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+} // namespace
+
+void GyroCalibrationCache::load(string_view path)
+{
+	lock_guard guard(_lock);
+	_path = path;
+	_offsets.clear();
+	_dirty = false;
+
+	ifstream file(_path, ios::binary);
+	if (!file)
+		return; // Nothing saved yet
+
+	char magic[sizeof(MAGIC)];
+	uint32_t version = 0, count = 0;
+	if (!file.read(magic, sizeof(magic)) || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+	  !readValue(file, version) || version != VERSION || !readValue(file, count))
+	{
+		CERR << "Ignoring the gyro calibrations in " << _path << ": the file is not recognized\n";
+		return;
+	}
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint16_t length = 0;
+		Offsets offsets;
+		if (!readValue(file, length))
+			break;
+		string identity(length, '\0');
+		if (!file.read(identity.data(), length) || !readValue(file, offsets.x) || !readValue(file, offsets.y) || !readValue(file, offsets.z))
+		{
+			CERR << "The gyro calibrations in " << _path << " are truncated\n";
+			break;
+		}
+		_offsets[identity] = offsets;
+	}
+}
+
+bool GyroCalibrationCache::restore(string_view identity, MotionIf &motion) const
+{
+	if (identity.empty())
+		return false;
+	lock_guard guard(_lock);
+	auto found = _offsets.find(string(identity));
+	if (found == _offsets.end())
+		return false;
+	motion.SetCalibrationOffset(found->second.x, found->second.y, found->second.z, RESTORED_WEIGHT);
+	return true;
+}
+
+void GyroCalibrationCache::store(string_view identity, MotionIf &motion)
+{
+	if (identity.empty())
+		return;
+	Offsets offsets;
+	motion.GetCalibrationOffset(offsets.x, offsets.y, offsets.z);
+	if (offsets.x == 0.f && offsets.y == 0.f && offsets.z == 0.f)
+		return; // Never calibrated
+
+	lock_guard guard(_lock);
+	auto &saved = _offsets[string(identity)];
+	if (saved.x != offsets.x || saved.y != offsets.y || saved.z != offsets.z)
+	{
+		saved = offsets;
+		_dirty = true;
+	}
+}
+
+void GyroCalibrationCache::save()
+{
+	lock_guard guard(_lock);
+	if (!_dirty || _path.empty())
+		return;
+
+	ofstream file(_path, ios::binary | ios::trunc);
+	if (!file)
+	{
+		CERR << "Cannot save the gyro calibrations to " << _path << '\n';
+		return;
+	}
+	file.write(MAGIC, sizeof(MAGIC));
+	writeValue(file, VERSION);
+	writeValue(file, uint32_t(_offsets.size()));
+	for (auto &[identity, offsets] : _offsets)
+	{
+		writeValue(file, uint16_t(identity.size()));
+		file.write(identity.data(), identity.size());
+		writeValue(file, offsets.x);
+		writeValue(file, offsets.y);
+		writeValue(file, offsets.z);
+	}
+	_dirty = !file;
+}
@@ -0,0 +1,174 @@
+#include "GyroSpaceTransform.h"
+
+#include <algorithm>
+#include <cmath>
+
+void GyroSpaceTransform::update(GyroSpace space, GyroAxisMask mouseXAxes, GyroAxisMask mouseYAxes, float gravX, float gravY, float gravZ)
+{
+	if (_hasBasis && space == _space && (space != GyroSpace::LOCAL || (mouseXAxes == _mouseXAxes && mouseYAxes == _mouseYAxes)))
+	{
+		if (space == GyroSpace::LOCAL)
+			return; // Gravity doesn't matter
+
+		float dx = gravX - _gravity[0], dy = gravY - _gravity[1], dz = gravZ - _gravity[2];
+		float cachedLengthSquared = _gravity[0] * _gravity[0] + _gravity[1] * _gravity[1] + _gravity[2] * _gravity[2];
+		if (dx * dx + dy * dy + dz * dz <= GRAVITY_EPSILON * GRAVITY_EPSILON * cachedLengthSquared)
+			return;
+	}
+	_space = space;
+	_mouseXAxes = mouseXAxes;
+	_mouseYAxes = mouseYAxes;
+	_gravity[0] = gravX;
+	_gravity[1] = gravY;
+	_gravity[2] = gravZ;
+	computeBasis();
+	_hasBasis = true;
+}
+
+void GyroSpaceTransform::computeBasis()
+{
+	fill(begin(_xRow), end(_xRow), 0.f);
+	fill(begin(_yRow), end(_yRow), 0.f);
+	_relax = 0.f;
+	_xScale = 1.f;
+
+	if (_space == GyroSpace::LOCAL)
+	{
+		int mouse_x_flag = int(_mouseXAxes);
+		int mouse_y_flag = int(_mouseYAxes);
+		_xRow[0] = (mouse_x_flag & int(GyroAxisMask::X)) ? 1.f : 0.f;
+		_xRow[1] = (mouse_x_flag & int(GyroAxisMask::Y)) ? -1.f : 0.f;
+		_xRow[2] = (mouse_x_flag & int(GyroAxisMask::Z)) ? -1.f : 0.f;
+		_yRow[0] = (mouse_y_flag & int(GyroAxisMask::X)) ? -1.f : 0.f;
+		_yRow[1] = (mouse_y_flag & int(GyroAxisMask::Y)) ? 1.f : 0.f;
+		_yRow[2] = (mouse_y_flag & int(GyroAxisMask::Z)) ? 1.f : 0.f;
+		return;
+	}
+
+	float gravLength = sqrtf(_gravity[0] * _gravity[0] + _gravity[1] * _gravity[1] + _gravity[2] * _gravity[2]);
+	float normGravX = 0.f;
+	float normGravY = 0.f;
+	float normGravZ = 0.f;
+	if (gravLength > 0.f)
+	{
+		float gravNormalizer = 1.f / gravLength;
+		normGravX = _gravity[0] * gravNormalizer;
+		normGravY = _gravity[1] * gravNormalizer;
+		normGravZ = _gravity[2] * gravNormalizer;
+	}
+
+	float flatness = abs(normGravY);
+	float upness = abs(normGravZ);
+	float sideReduction = clamp((max(flatness, upness) - 0.125f) / 0.125f, 0.f, 1.f);
+
+	// project local pitch axis (X) onto gravity plane
+	// super simple since our point is only non-zero in one axis
+	float gravDotPitchAxis = normGravX;
+	float pitchAxisX = 1.f - normGravX * gravDotPitchAxis;
+	float pitchAxisY = -normGravY * gravDotPitchAxis;
+	float pitchAxisZ = -normGravZ * gravDotPitchAxis;
+	float pitchAxisLengthSquared = pitchAxisX * pitchAxisX + pitchAxisY * pitchAxisY + pitchAxisZ * pitchAxisZ;
+	bool playerSpace = _space == GyroSpace::PLAYER_TURN || _space == GyroSpace::PLAYER_LEAN;
+	if (!playerSpace)
+	{
+		// Only the normalized pitch axis is used in world spaces
+		if (pitchAxisLengthSquared > 0.f)
+		{
+			float lengthReciprocal = 1.f / sqrtf(pitchAxisLengthSquared);
+			pitchAxisX *= lengthReciprocal;
+			pitchAxisY *= lengthReciprocal;
+			pitchAxisZ *= lengthReciprocal;
+		}
+	}
+
+	// world roll axis is cross (yaw, pitch)
+	float rollAxisX = pitchAxisY * normGravZ - pitchAxisZ * normGravY;
+	float rollAxisY = pitchAxisZ * normGravX - pitchAxisX * normGravZ;
+	float rollAxisZ = pitchAxisX * normGravY - pitchAxisY * normGravX;
+	float rollAxisLengthSquared = rollAxisX * rollAxisX + rollAxisY * rollAxisY + rollAxisZ * rollAxisZ;
+	bool hasRollAxis = pitchAxisLengthSquared > 0.f && rollAxisLengthSquared > 0.f;
+	if (hasRollAxis)
+	{
+		float lengthReciprocal = 1.f / sqrtf(rollAxisLengthSquared);
+		rollAxisX *= lengthReciprocal;
+		rollAxisY *= lengthReciprocal;
+		rollAxisZ *= lengthReciprocal;
+	}
+
+	switch (_space)
+	{
+	case GyroSpace::PLAYER_TURN:
+		// grav dot gyro axis (but only Y (yaw) and Z (roll))
+		_xRow[1] = normGravY;
+		_xRow[2] = normGravZ;
+		_relax = 2.f; // 60 degree buffer
+		_yRow[0] = -1.f;
+		break;
+	case GyroSpace::PLAYER_LEAN:
+		if (hasRollAxis)
+		{
+			_xRow[1] = rollAxisY;
+			_xRow[2] = rollAxisZ;
+			_xScale = sideReduction;
+		}
+		_relax = 1.41f; // 45 degree buffer
+		_yRow[0] = -1.f;
+		break;
+	default: // WORLD_TURN or WORLD_LEAN
+		if (pitchAxisLengthSquared > 0.f)
+		{
+			// global pitch factor, pinched towards the nonsense limit
+			_yRow[0] = -pitchAxisX * sideReduction;
+			_yRow[1] = -pitchAxisY * sideReduction;
+			_yRow[2] = -pitchAxisZ * sideReduction;
+		}
+		if (_space == GyroSpace::WORLD_TURN)
+		{
+			// grav dot gyro axis
+			_xRow[0] = normGravX;
+			_xRow[1] = normGravY;
+			_xRow[2] = normGravZ;
+		}
+		else if (_space == GyroSpace::WORLD_LEAN && hasRollAxis)
+		{
+			// global roll factor, pinched because we rely on a good pitch vector here
+			_xRow[0] = rollAxisX * sideReduction;
+			_xRow[1] = rollAxisY * sideReduction;
+			_xRow[2] = rollAxisZ * sideReduction;
+		}
+		break;
+	}
+}
+
+FloatXY GyroSpaceTransform::apply(float gyroX, float gyroY, float gyroZ) const
+{
+	float outX, outY;
+	apply(span(&gyroX, 1), span(&gyroY, 1), span(&gyroZ, 1), span(&outX, 1), span(&outY, 1));
+	return { outX, outY };
+}
+
+void GyroSpaceTransform::apply(span<const float> gyroX, span<const float> gyroY, span<const float> gyroZ, span<float> outX, span<float> outY) const
+{
+	const size_t count = min({ gyroX.size(), gyroY.size(), gyroZ.size(), outX.size(), outY.size() });
+	const float x0 = _xRow[0], x1 = _xRow[1], x2 = _xRow[2];
+	const float y0 = _yRow[0], y1 = _yRow[1], y2 = _yRow[2];
+	if (_relax > 0.f)
+	{
+		const float relax = _relax, scale = _xScale;
+		for (size_t i = 0; i < count; ++i)
+		{
+			float x = x0 * gyroX[i] + x1 * gyroY[i] + x2 * gyroZ[i];
+			float limit = sqrtf(gyroY[i] * gyroY[i] + gyroZ[i] * gyroZ[i]);
+			outX[i] = (x < 0.f ? -1.f : 1.f) * min(abs(x) * relax, limit) * scale;
+			outY[i] = y0 * gyroX[i] + y1 * gyroY[i] + y2 * gyroZ[i];
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			outX[i] = x0 * gyroX[i] + x1 * gyroY[i] + x2 * gyroZ[i];
+			outY[i] = y0 * gyroX[i] + y1 * gyroY[i] + y2 * gyroZ[i];
+		}
+	}
+}
@@ -0,0 +1,365 @@
+#include "InputTrace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <unordered_map>
+
+bool InputTrace::load(string_view path)
+{
+	ifstream file{ string(path) };
+	if (!file)
+	{
+		CERR << "Cannot open the input trace " << path << '\n';
+		return false;
+	}
+	devices.clear();
+	records.clear();
+	int lineNumber = 0;
+	for (string line; getline(file, line);)
+	{
+		++lineNumber;
+		if (line.empty() || line[0] == '#')
+			continue;
+		stringstream ss(line);
+		if (line.starts_with("DEVICE"))
+		{
+			string keyword;
+			Device device;
+			if (!(ss >> keyword >> device.handle >> device.type >> device.splitType))
+			{
+				CERR << path << ':' << lineNumber << ": expected DEVICE <handle> <controller type> <split type>\n";
+				return false;
+			}
+			devices.push_back(device);
+			continue;
+		}
+		Record record;
+		auto &s = record.state;
+		auto &imu = record.imu;
+		if (!(ss >> record.timeMs >> record.handle >> s.buttons >> s.lTrigger >> s.rTrigger >> s.stickLX >> s.stickLY >> s.stickRX >> s.stickRY >>
+		      imu.accelX >> imu.accelY >> imu.accelZ >> imu.gyroX >> imu.gyroY >> imu.gyroZ))
+		{
+			CERR << path << ':' << lineNumber << ": expected a time, a device handle and 13 input values\n";
+			return false;
+		}
+		if (none_of(devices.begin(), devices.end(), [&record](auto &device)
+		      { return device.handle == record.handle; }))
+		{
+			CERR << path << ':' << lineNumber << ": device " << record.handle << " isn't declared\n";
+			return false;
+		}
+		records.push_back(record);
+	}
+	// Ties keep their order in the file
+	stable_sort(records.begin(), records.end(), [](auto &lhs, auto &rhs)
+	  { return lhs.timeMs < rhs.timeMs; });
+	return true;
+}
+
+bool InputTraceRecorder::open(string_view path)
+{
+	lock_guard guard(_lock);
+	_file.open(string(path), ios::trunc);
+	_devices.clear();
+	_started = false;
+	if (!_file)
+	{
+		CERR << "Cannot write the input trace to " << path << '\n';
+		return false;
+	}
+	_file << "# JoyShockMapper input trace\n";
+	return true;
+}
+
+void InputTraceRecorder::record(int handle, int type, int splitType, ClockIf::TimePoint time, const JOY_SHOCK_STATE &state, const IMU_STATE &imu)
+{
+	lock_guard guard(_lock);
+	if (!_file)
+		return;
+	if (!_started)
+	{
+		_start = time;
+		_started = true;
+	}
+	if (_devices.insert(handle).second)
+	{
+		_file << "DEVICE " << handle << ' ' << type << ' ' << splitType << '\n';
+	}
+	// Enough digits for the floats to read back exactly
+	char line[320];
+	snprintf(line, sizeof(line), "%.3f %d %d %.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g\n",
+	  chrono::duration<double, milli>(time - _start).count(), handle, state.buttons, state.lTrigger, state.rTrigger,
+	  state.stickLX, state.stickLY, state.stickRX, state.stickRY, imu.accelX, imu.accelY, imu.accelZ, imu.gyroX, imu.gyroY, imu.gyroZ);
+	_file << line;
+}
+
+namespace
+{
+class TraceReplayImpl : public TraceReplay
+{
+	struct DeviceState
+	{
+		InputTrace::Device device;
+		InputTrace::Record current;
+		InputTrace::Record previous;
+	};
+
+	InputTrace _trace;
+	unordered_map<int, DeviceState> _devices;
+	void (*_callback)(int, JOY_SHOCK_STATE, JOY_SHOCK_STATE, IMU_STATE, IMU_STATE, float) = nullptr;
+
+	const InputTrace::Record &current(int deviceId)
+	{
+		static const InputTrace::Record none;
+		auto found = _devices.find(deviceId);
+		return found == _devices.end() ? none : found->second.current;
+	}
+
+public:
+	TraceReplayImpl(InputTrace trace)
+	  : _trace(move(trace))
+	{
+	}
+
+	size_t run(SimulatedClock &clock) override
+	{
+		auto start = clock.now();
+		size_t sent = 0;
+		for (auto &record : _trace.records)
+		{
+			auto found = _devices.find(record.handle);
+			if (found == _devices.end())
+				continue; // Not connected
+			++sent;
+			clock.set(start + chrono::duration_cast<ClockIf::Duration>(chrono::duration<double, milli>(record.timeMs)));
+			auto &device = found->second;
+			float deltaTime = float(record.timeMs - device.current.timeMs) / 1000.f;
+			device.previous = device.current;
+			device.current = record;
+			if (_callback)
+			{
+				_callback(record.handle, record.state, device.previous.state, record.imu, device.previous.imu, deltaTime);
+			}
+		}
+		return sent;
+	}
+
+	int ConnectDevices() override
+	{
+		_devices.clear();
+		for (auto &device : _trace.devices)
+		{
+			_devices[device.handle].device = device;
+		}
+		return int(_devices.size());
+	}
+
+	int GetDeviceCount() override
+	{
+		return int(_devices.size());
+	}
+
+	int GetConnectedDeviceHandles(int *deviceHandleArray, int size) override
+	{
+		int count = 0;
+		for (auto &device : _trace.devices)
+		{
+			if (count >= size)
+				break;
+			deviceHandleArray[count++] = device.handle;
+		}
+		return count;
+	}
+
+	void DisconnectAndDisposeAll() override
+	{
+		_devices.clear();
+	}
+
+	JOY_SHOCK_STATE GetSimpleState(int deviceId) override
+	{
+		return current(deviceId).state;
+	}
+
+	IMU_STATE GetIMUState(int deviceId) override
+	{
+		return current(deviceId).imu;
+	}
+
+	MOTION_STATE GetMotionState(int deviceId) override
+	{
+		return MOTION_STATE{ 1.f };
+	}
+
+	TOUCH_STATE GetTouchState(int deviceId) override
+	{
+		return TOUCH_STATE{};
+	}
+
+	bool GetTouchpadDimension(int deviceId, int &sizeX, int &sizeY) override
+	{
+		return false;
+	}
+
+	int GetButtons(int deviceId) override
+	{
+		return current(deviceId).state.buttons;
+	}
+
+	float GetLeftX(int deviceId) override
+	{
+		return current(deviceId).state.stickLX;
+	}
+
+	float GetLeftY(int deviceId) override
+	{
+		return current(deviceId).state.stickLY;
+	}
+
+	float GetRightX(int deviceId) override
+	{
+		return current(deviceId).state.stickRX;
+	}
+
+	float GetRightY(int deviceId) override
+	{
+		return current(deviceId).state.stickRY;
+	}
+
+	float GetLeftTrigger(int deviceId) override
+	{
+		return current(deviceId).state.lTrigger;
+	}
+
+	float GetRightTrigger(int deviceId) override
+	{
+		return current(deviceId).state.rTrigger;
+	}
+
+	float GetGyroX(int deviceId) override
+	{
+		return current(deviceId).imu.gyroX;
+	}
+
+	float GetGyroY(int deviceId) override
+	{
+		return current(deviceId).imu.gyroY;
+	}
+
+	float GetGyroZ(int deviceId) override
+	{
+		return current(deviceId).imu.gyroZ;
+	}
+
+	float GetAccelX(int deviceId) override
+	{
+		return current(deviceId).imu.accelX;
+	}
+
+	float GetAccelY(int deviceId) override
+	{
+		return current(deviceId).imu.accelY;
+	}
+
+	float GetAccelZ(int deviceId) override
+	{
+		return current(deviceId).imu.accelZ;
+	}
+
+	int GetTouchId(int deviceId, bool secondTouch = false) override
+	{
+		return -1;
+	}
+
+	bool GetTouchDown(int deviceId, bool secondTouch = false) override
+	{
+		return false;
+	}
+
+	float GetTouchX(int deviceId, bool secondTouch = false) override
+	{
+		return 0.f;
+	}
+
+	float GetTouchY(int deviceId, bool secondTouch = false) override
+	{
+		return 0.f;
+	}
+
+	float GetStickStep(int deviceId) override
+	{
+		return 0.f;
+	}
+
+	float GetTriggerStep(int deviceId) override
+	{
+		return 0.f;
+	}
+
+	float GetPollRate(int deviceId) override
+	{
+		return 0.f;
+	}
+
+	void ResetContinuousCalibration(int deviceId) override
+	{
+	}
+
+	void StartContinuousCalibration(int deviceId) override
+	{
+	}
+
+	void PauseContinuousCalibration(int deviceId) override
+	{
+	}
+
+	void GetCalibrationOffset(int deviceId, float &xOffset, float &yOffset, float &zOffset) override
+	{
+		xOffset = yOffset = zOffset = 0.f;
+	}
+
+	void SetCalibrationOffset(int deviceId, float xOffset, float yOffset, float zOffset) override
+	{
+	}
+
+	void SetCallback(void (*callback)(int, JOY_SHOCK_STATE, JOY_SHOCK_STATE, IMU_STATE, IMU_STATE, float)) override
+	{
+		_callback = callback;
+	}
+
+	int GetControllerType(int deviceId) override
+	{
+		auto found = _devices.find(deviceId);
+		return found == _devices.end() ? 0 : found->second.device.type;
+	}
+
+	int GetControllerSplitType(int deviceId) override
+	{
+		auto found = _devices.find(deviceId);
+		return found == _devices.end() ? JS_SPLIT_TYPE_FULL : found->second.device.splitType;
+	}
+
+	int GetControllerColour(int deviceId) override
+	{
+		return 0xFFFFFF;
+	}
+
+	void SetLightColour(int deviceId, int colour) override
+	{
+	}
+
+	void SetRumble(int deviceId, int smallRumble, int bigRumble) override
+	{
+	}
+
+	void SetPlayerNumber(int deviceId, int number) override
+	{
+	}
+};
+} // namespace
+
+TraceReplay *TraceReplay::getNew(InputTrace trace)
+{
+	return new TraceReplayImpl(move(trace));
+}
@@ -29,12 +29,13 @@ float angleBasedDeadzone(float theta, float returnDeadzone, float returnDeadzone
 
 AdaptiveTriggerSetting JoyShock::_unusedEffect;
 
-JoyShock::JoyShock(int uniqueHandle, int controllerSplitType, shared_ptr<DigitalButton::Context> sharedButtonCommon)
+JoyShock::JoyShock(int uniqueHandle, int controllerSplitType, shared_ptr<ClockIf> clock, shared_ptr<DigitalButton::Context> sharedButtonCommon)
   : _handle(uniqueHandle)
   , _splitType(controllerSplitType)
   , _controllerType(jsl->GetControllerType(uniqueHandle))
+  , _identity(jsl->GetControllerIdentity(uniqueHandle))
+  , _tickTime(SettingsManager::get<float>(SettingID::TICK_TIME)->value())
   , _triggerState(NUM_ANALOG_TRIGGERS, DstState::NoPress)
-  , _prevTriggerPosition(NUM_ANALOG_TRIGGERS, deque<float>(MAGIC_TRIGGER_SMOOTHING, 0.f))
   , _light_bar(SettingsManager::get<Color>(SettingID::LIGHT_BAR)->value())
   , _context(sharedButtonCommon)
   , _motion(MotionIf::getNew())
@@ -47,7 +48,7 @@ JoyShock::JoyShock(int uniqueHandle, int controllerSplitType, shared_ptr<Digital
 {
 	if (!sharedButtonCommon)
 	{
-		_context = make_shared<DigitalButton::Context>(bind(&JoyShock::onVirtualControllerNotification, this, placeholders::_1, placeholders::_2, placeholders::_3), _motion);
+		_context = make_shared<DigitalButton::Context>(bind(&JoyShock::onVirtualControllerNotification, this, placeholders::_1, placeholders::_2, placeholders::_3), _motion, clock);
 	}
 	_light_bar = getSetting<Color>(SettingID::LIGHT_BAR);
 
@@ -66,6 +67,11 @@ JoyShock::JoyShock(int uniqueHandle, int controllerSplitType, shared_ptr<Digital
 		SettingsManager::getV<ControllerScheme>(SettingID::VIRTUAL_CONTROLLER)->set(ControllerScheme::NONE);
 	}
 	jsl->SetLightColour(_handle, getSetting<Color>(SettingID::LIGHT_BAR).raw);
+	int tpSizeX, tpSizeY;
+	if (jsl->GetTouchpadDimension(_handle, tpSizeX, tpSizeY) && tpSizeX > 0 && tpSizeY > 0)
+	{
+		_touchpadSize = FloatXY{ float(tpSizeX), float(tpSizeY) };
+	}
 	for (int i = 0; i < MAX_NO_OF_TOUCH; ++i)
 	{
 		_touchpads.push_back(TouchStick(i, _context, _handle));
@@ -261,12 +267,10 @@ AxisSignPair JoyShock::getSetting<AxisSignPair>(SettingID index)
 
 DigitalButton *JoyShock::getMatchingSimBtn(ButtonID index)
 {
-	JSMButton *mapping = int(index) < mappings.size()        ? &mappings[int(index)] :
-	  int(index) - FIRST_TOUCH_BUTTON < grid_mappings.size() ? &grid_mappings[int(index) - FIRST_TOUCH_BUTTON] :
-	                                                           nullptr;
-	DigitalButton *button1 = int(index) < mappings.size()    ? &_buttons[int(index)] :
-	  int(index) - FIRST_TOUCH_BUTTON < grid_mappings.size() ? &_gridButtons[int(index) - FIRST_TOUCH_BUTTON] :
-	                                                           nullptr;
+	const FrozenButton *mapping = _settings->button(index);
+	DigitalButton *button1 = int(index) < mappings.size()   ? &_buttons[int(index)] :
+	  int(index) - FIRST_TOUCH_BUTTON < _gridButtons.size() ? &_gridButtons[int(index) - FIRST_TOUCH_BUTTON] :
+	                                                          nullptr;
 	if (!mapping)
 	{
 		CERR << "Cannot find the button " << index << '\n';
@@ -284,7 +288,7 @@ DigitalButton *JoyShock::getMatchingSimBtn(ButtonID index)
 		for (auto iter = mapping->getSimMapIter() ; iter ; ++iter)
 		{
 			DigitalButton *button2 = int(iter->first) < mappings.size()      ? &_buttons[int(iter->first)] :
-			  int(iter->first) - FIRST_TOUCH_BUTTON < grid_mappings.size() ? &_gridButtons[int(iter->first) - FIRST_TOUCH_BUTTON] :
+			  int(iter->first) - FIRST_TOUCH_BUTTON < _gridButtons.size() ? &_gridButtons[int(iter->first) - FIRST_TOUCH_BUTTON] :
 																				nullptr;
 
 			if (!button2)
@@ -302,12 +306,10 @@ DigitalButton *JoyShock::getMatchingSimBtn(ButtonID index)
 
 DigitalButton *JoyShock::getMatchingDiagBtn(ButtonID index, optional<MapIterator> &iter)
 {
-	JSMButton *mapping = int(index) < mappings.size()        ? &mappings[int(index)] :
-	  int(index) - FIRST_TOUCH_BUTTON < grid_mappings.size() ? &grid_mappings[int(index) - FIRST_TOUCH_BUTTON] :
-	                                                           nullptr;
-	DigitalButton *button1 = int(index) < mappings.size()    ? &_buttons[int(index)] :
-	  int(index) - FIRST_TOUCH_BUTTON < grid_mappings.size() ? &_gridButtons[int(index) - FIRST_TOUCH_BUTTON] :
-	                                                           nullptr;
+	const FrozenButton *mapping = _settings->button(index);
+	DigitalButton *button1 = int(index) < mappings.size()   ? &_buttons[int(index)] :
+	  int(index) - FIRST_TOUCH_BUTTON < _gridButtons.size() ? &_gridButtons[int(index) - FIRST_TOUCH_BUTTON] :
+	                                                          nullptr;
 	if (!mapping)
 	{
 		CERR << "Cannot find the button " << index << '\n';
@@ -324,8 +326,8 @@ DigitalButton *JoyShock::getMatchingDiagBtn(ButtonID index, optional<MapIterator
 		for (; *iter; ++*iter)
 		{
 			int i = int((*iter)->first);
-			DigitalButton *button2 = i < mappings.size()    ? &_buttons[i] :
-			  i - FIRST_TOUCH_BUTTON < grid_mappings.size() ? &_gridButtons[i - FIRST_TOUCH_BUTTON] :
+			DigitalButton *button2 = i < mappings.size()   ? &_buttons[i] :
+			  i - FIRST_TOUCH_BUTTON < _gridButtons.size() ? &_gridButtons[i - FIRST_TOUCH_BUTTON] :
 			                                                                 nullptr;
 
 			if (!button2)
@@ -476,8 +478,10 @@ float JoyShock::getTriggerEffectStartPos()
 
 void JoyShock::handleTriggerChange(ButtonID softIndex, ButtonID fullIndex, TriggerMode mode, float position, AdaptiveTriggerSetting &trigger_rumble)
 {
-	uint8_t offset = SettingsManager::getV<int>(softIndex == ButtonID::ZL ? SettingID::LEFT_TRIGGER_OFFSET : SettingID::RIGHT_TRIGGER_OFFSET)->value();
-	uint8_t range = SettingsManager::getV<int>(softIndex == ButtonID::ZL ? SettingID::LEFT_TRIGGER_RANGE : SettingID::RIGHT_TRIGGER_RANGE)->value();
+	// From the settings of this tick, like the rest of the mapping
+	bool left = softIndex == ButtonID::ZL;
+	uint8_t offset = _settings->value<int>(left ? SettingID::LEFT_TRIGGER_OFFSET : SettingID::RIGHT_TRIGGER_OFFSET).value_or(0);
+	uint8_t range = _settings->value<int>(left ? SettingID::LEFT_TRIGGER_RANGE : SettingID::RIGHT_TRIGGER_RANGE).value_or(0);
 	auto idxState = int(fullIndex) - FIRST_ANALOG_TRIGGER; // Get analog trigger index
 	if (idxState < 0 || idxState >= (int)_triggerState.size())
 	{
@@ -677,7 +681,7 @@ void JoyShock::handleTriggerChange(ButtonID softIndex, ButtonID fullIndex, Trigg
 		}
 		else // Soft Press is being held
 		{
-			float tick_time = SettingsManager::get<float>(SettingID::TICK_TIME)->value();
+			float tick_time = _tickTime;
 			if (mode == TriggerMode::NO_SKIP || mode == TriggerMode::MAY_SKIP || mode == TriggerMode::MAY_SKIP_R)
 			{
 				trigger_rumble.force = min(int(UINT16_MAX), trigger_rumble.force + int(1 / 30.f * tick_time * UINT16_MAX));
@@ -792,6 +796,25 @@ bool JoyShock::processDeadZones(float &x, float &y, float innerDeadzone, float o
 	return false;
 }
 
+const PowerCurve &JoyShock::getStickPowerCurve()
+{
+	_stickPowerCurve.setExponent(getSetting(SettingID::STICK_POWER));
+	return _stickPowerCurve;
+}
+
+const VirtualStickCurve &JoyShock::getVirtualStickCurve(bool isLeft)
+{
+	if (isLeft)
+	{
+		_leftVirtualStickCurve.update(getSetting(SettingID::LEFT_STICK_UNDEADZONE_INNER),
+		  getSetting(SettingID::LEFT_STICK_UNDEADZONE_OUTER), getSetting(SettingID::LEFT_STICK_UNPOWER));
+		return _leftVirtualStickCurve;
+	}
+	_rightVirtualStickCurve.update(getSetting(SettingID::RIGHT_STICK_UNDEADZONE_INNER),
+	  getSetting(SettingID::RIGHT_STICK_UNDEADZONE_OUTER), getSetting(SettingID::RIGHT_STICK_UNPOWER));
+	return _rightVirtualStickCurve;
+}
+
 void JoyShock::updateGridSize()
 {
 	while (_gridButtons.size() > grid_mappings.size())
@@ -815,37 +838,35 @@ bool JoyShock::isSoftPullPressed(int triggerIndex, float triggerPosition)
 	}
 	// else HAIR TRIGGER
 
-	// Calculate 3 sample averages with the last MAGIC_TRIGGER_SMOOTHING samples + new sample
-	float sum = 0.f;
-	for_each(_prevTriggerPosition[triggerIndex].begin(), _prevTriggerPosition[triggerIndex].begin() + 3, [&sum](auto data)
-	  { sum += data; });
-	float avg_tm3 = sum / 3.0f;
-	sum = sum - *(_prevTriggerPosition[triggerIndex].begin()) + *(_prevTriggerPosition[triggerIndex].end() - 2);
-	float avg_tm2 = sum / 3.0f;
-	sum = sum - *(_prevTriggerPosition[triggerIndex].begin() + 1) + *(_prevTriggerPosition[triggerIndex].end() - 1);
-	float avg_tm1 = sum / 3.0f;
-	sum = sum - *(_prevTriggerPosition[triggerIndex].begin() + 2) + triggerPosition;
-	float avg_t0 = sum / 3.0f;
-	// if (avg_t0 > 0) COUT << "Trigger: " << avg_t0 << '\n';
+	// Compare 3 sample averages over the last MAGIC_TRIGGER_SMOOTHING samples, including the new one.
+	// The sums of the previous ticks are kept, so only the new sum needs computing.
+	TriggerHistory &history = _triggerHistory[triggerIndex];
+	int32_t position = int32_t(lround(clamp(triggerPosition, 0.f, 1.f) * TriggerHistory::STEPS));
+	int32_t sum_tm3 = history.sums[history.next];
+	int32_t sum_tm2 = history.sums[(history.next + 1) % TriggerHistory::WINDOW];
+	int32_t sum_tm1 = history.sums[(history.next + 2) % TriggerHistory::WINDOW];
+	int32_t sum_t0 = sum_tm1 - history.positions[history.next] + position;
+	// if (sum_t0 > 0) COUT << "Trigger: " << float(sum_t0) / (TriggerHistory::WINDOW * TriggerHistory::STEPS) << '\n';
 
 	// Soft press is pressed if we got three averaged samples in a row that are pressed
 	bool isPressed;
-	if (avg_t0 > avg_tm1 && avg_tm1 > avg_tm2 && avg_tm2 > avg_tm3)
+	if (sum_t0 > sum_tm1 && sum_tm1 > sum_tm2 && sum_tm2 > sum_tm3)
 	{
-		// DEBUG_LOG << "Hair Trigger pressed: " << avg_t0 << " > " << avg_tm1 << " > " << avg_tm2 << " > " << avg_tm3 << '\n';
+		// DEBUG_LOG << "Hair Trigger pressed: " << sum_t0 << " > " << sum_tm1 << " > " << sum_tm2 << " > " << sum_tm3 << '\n';
 		isPressed = true;
 	}
-	else if (avg_t0 < avg_tm1 && avg_tm1 < avg_tm2 && avg_tm2 < avg_tm3)
+	else if (sum_t0 < sum_tm1 && sum_tm1 < sum_tm2 && sum_tm2 < sum_tm3)
 	{
-		// DEBUG_LOG << "Hair Trigger released: " << avg_t0 << " < " << avg_tm1 << " < " << avg_tm2 << " < " << avg_tm3 << '\n';
+		// DEBUG_LOG << "Hair Trigger released: " << sum_t0 << " < " << sum_tm1 << " < " << sum_tm2 << " < " << sum_tm3 << '\n';
 		isPressed = false;
 	}
 	else
 	{
 		isPressed = _triggerState[triggerIndex] != DstState::NoPress && _triggerState[triggerIndex] != DstState::QuickSoftTap;
 	}
-	_prevTriggerPosition[triggerIndex].pop_front();
-	_prevTriggerPosition[triggerIndex].push_back(triggerPosition);
+	history.positions[history.next] = position;
+	history.sums[history.next] = sum_t0;
+	history.next = (history.next + 1) % TriggerHistory::WINDOW;
 	return isPressed;
 }
 
@@ -899,7 +920,7 @@ float JoyShock::handleFlickStick(float stickX, float stickY, Stick &stick, float
 					stickAngle = 0.0f;
 				}
 
-				stick.started_flick = chrono::steady_clock::now();
+				stick.started_flick = _timeNow;
 				stick.delta_flick = stickAngle;
 				stick.flick_percent_done = 0.0f;
 				resetSmoothSample();
@@ -922,9 +943,8 @@ float JoyShock::handleFlickStick(float stickX, float stickY, Stick &stick, float
 				stick.flick_rotation_counter += angleChange; // track all rotation for this flick
 				float flickSpeedConstant = isMouse ? getSetting(SettingID::REAL_WORLD_CALIBRATION) * mouseCalibrationFactor / getSetting(SettingID::IN_GAME_SENS) : 1.f;
 				float flickSpeed = -(angleChange * flickSpeedConstant);
-				float tick_time = SettingsManager::get<float>(SettingID::TICK_TIME)->value();
-				int maxSmoothingSamples = min(NUM_SAMPLES, (int)ceil(64.0f / tick_time)); // target a max smoothing window size of 64ms
-				float stepSize = 0.01f;                                                   // and we only want full on smoothing when the stick change each time we poll it is approximately the minimum stick resolution
+				int maxSmoothingSamples = min(NUM_SAMPLES, (int)ceil(64.0f / _tickTime)); // target a max smoothing window size of 64ms
+				float stepSize = _stickStep;                                              // and we only want full on smoothing when the stick change each time we poll it is approximately the minimum stick resolution
 				                                                                          // the fact that we're using radians makes this really easy
 				auto rotate_smooth_override = getSetting(SettingID::ROTATE_SMOOTH_OVERRIDE);
 				if (rotate_smooth_override < 0.0f)
@@ -939,7 +959,7 @@ float JoyShock::handleFlickStick(float stickX, float stickY, Stick &stick, float
 				if (!isMouse)
 				{
 					// convert to a velocity
-					camSpeedX *= 180.0f / (M_PI * 0.001f * SettingsManager::get<float>(SettingID::TICK_TIME)->value());
+					camSpeedX *= 180.0f / (M_PI * 0.001f * _tickTime);
 				}
 			}
 		}
@@ -1090,7 +1110,7 @@ void JoyShock::processStick(float stickX, float stickY, Stick &stick, float mous
 		if (stickLength != 0.0f)
 		{
 			anyStickInput = true;
-			float warpedStickLengthX = pow(stickLength, getSetting(SettingID::STICK_POWER));
+			float warpedStickLengthX = getStickPowerCurve()(stickLength);
 			float warpedStickLengthY = warpedStickLengthX;
 			warpedStickLengthX *= getSetting<FloatXY>(SettingID::STICK_SENS).first * getSetting(SettingID::REAL_WORLD_CALIBRATION) / os_mouse_speed / getSetting(SettingID::IN_GAME_SENS);
 			warpedStickLengthY *= getSetting<FloatXY>(SettingID::STICK_SENS).second * getSetting(SettingID::REAL_WORLD_CALIBRATION) / os_mouse_speed / getSetting(SettingID::IN_GAME_SENS);
@@ -1190,37 +1210,20 @@ void JoyShock::processStick(float stickX, float stickY, Stick &stick, float mous
 			float angleDeadzoneOuter = getSetting(SettingID::ANGLE_TO_AXIS_DEADZONE_OUTER);
 			float absStickValue = clamp((absAngle - angleDeadzoneInner) / (90.f - angleDeadzoneOuter - angleDeadzoneInner), 0.f, 1.f);
 
-			absStickValue *= pow(stickLength, getSetting(SettingID::STICK_POWER));
+			absStickValue *= getStickPowerCurve()(stickLength);
 
 			// now actually convert to output stick value, taking deadzones and power curve into account
-			float undeadzoneInner, undeadzoneOuter, unpower;
-			if (isLeft)
-			{
-				undeadzoneInner = getSetting(SettingID::LEFT_STICK_UNDEADZONE_INNER);
-				undeadzoneOuter = getSetting(SettingID::LEFT_STICK_UNDEADZONE_OUTER);
-				unpower = getSetting(SettingID::LEFT_STICK_UNPOWER);
-			}
-			else
-			{
-				undeadzoneInner = getSetting(SettingID::RIGHT_STICK_UNDEADZONE_INNER);
-				undeadzoneOuter = getSetting(SettingID::RIGHT_STICK_UNDEADZONE_OUTER);
-				unpower = getSetting(SettingID::RIGHT_STICK_UNPOWER);
-			}
-
-			float livezoneSize = 1.f - undeadzoneOuter - undeadzoneInner;
-			if (livezoneSize > 0.f)
+			const VirtualStickCurve &virtualStick = getVirtualStickCurve(isLeft);
+			if (virtualStick.livezoneSize > 0.f)
 			{
 				anyStickInput = true;
 
 				// unpower curve
-				if (unpower != 0.f)
-				{
-					absStickValue = pow(absStickValue, 1.f / unpower);
-				}
+				absStickValue = virtualStick.inverse(absStickValue);
 
 				if (absStickValue < 1.f)
 				{
-					absStickValue = undeadzoneInner + absStickValue * livezoneSize;
+					absStickValue = virtualStick.undeadzoneInner + absStickValue * virtualStick.livezoneSize;
 				}
 
 				float signedStickValue = signAngle * absStickValue;
@@ -1287,34 +1290,17 @@ void JoyShock::processStick(float stickX, float stickY, Stick &stick, float mous
 			float windingRemapped = min(pow(newAbsWindingAngle / windingRange * 2.f, windingPower), 1.f);
 
 			// let's account for deadzone!
-			float undeadzoneInner, undeadzoneOuter, unpower;
-			if (isLeft)
-			{
-				undeadzoneInner = getSetting(SettingID::LEFT_STICK_UNDEADZONE_INNER);
-				undeadzoneOuter = getSetting(SettingID::LEFT_STICK_UNDEADZONE_OUTER);
-				unpower = getSetting(SettingID::LEFT_STICK_UNPOWER);
-			}
-			else
-			{
-				undeadzoneInner = getSetting(SettingID::RIGHT_STICK_UNDEADZONE_INNER);
-				undeadzoneOuter = getSetting(SettingID::RIGHT_STICK_UNDEADZONE_OUTER);
-				unpower = getSetting(SettingID::RIGHT_STICK_UNPOWER);
-			}
-
-			float livezoneSize = 1.f - undeadzoneOuter - undeadzoneInner;
-			if (livezoneSize > 0.f)
+			const VirtualStickCurve &virtualStick = getVirtualStickCurve(isLeft);
+			if (virtualStick.livezoneSize > 0.f)
 			{
 				anyStickInput = true;
 
 				// unpower curve
-				if (unpower != 0.f)
-				{
-					windingRemapped = pow(windingRemapped, 1.f / unpower);
-				}
+				windingRemapped = virtualStick.inverse(windingRemapped);
 
 				if (windingRemapped < 1.f)
 				{
-					windingRemapped = undeadzoneInner + windingRemapped * livezoneSize;
+					windingRemapped = virtualStick.undeadzoneInner + windingRemapped * virtualStick.livezoneSize;
 				}
 
 				float signedStickValue = newWindingSign * windingRemapped;
@@ -1391,10 +1377,11 @@ void JoyShock::processStick(float stickX, float stickY, Stick &stick, float mous
 		// compute output
 		FloatXY sticklikeFactor = getSetting<FloatXY>(SettingID::STICK_SENS);
 		FloatXY mouselikeFactor = getSetting<FloatXY>(SettingID::MOUSELIKE_FACTOR);
-		float outputX = sticklikeFactor.x() / 2.f * pow(magnitude, getSetting(SettingID::STICK_POWER)) * cos(angle) * deltaTime;
-		float outputY = sticklikeFactor.y() / 2.f * pow(magnitude, getSetting(SettingID::STICK_POWER)) * sin(angle) * deltaTime;
-		outputX += mouselikeFactor.x() * pow(stick.smallestMagnitude, getSetting(SettingID::STICK_POWER)) * cos(angle) * stick.edgePushAmount;
-		outputY += mouselikeFactor.y() * pow(stick.smallestMagnitude, getSetting(SettingID::STICK_POWER)) * sin(angle) * stick.edgePushAmount;
+		const PowerCurve &stickPower = getStickPowerCurve();
+		float outputX = sticklikeFactor.x() / 2.f * stickPower(magnitude) * cos(angle) * deltaTime;
+		float outputY = sticklikeFactor.y() / 2.f * stickPower(magnitude) * sin(angle) * deltaTime;
+		outputX += mouselikeFactor.x() * stickPower(stick.smallestMagnitude) * cos(angle) * stick.edgePushAmount;
+		outputY += mouselikeFactor.y() * stickPower(stick.smallestMagnitude) * sin(angle) * stick.edgePushAmount;
 		outputX += mouselikeFactor.x() * velocityX;
 		outputY += mouselikeFactor.y() * velocityY;
 
@@ -1516,34 +1503,20 @@ bool JoyShock::processGyroStick(float stickX, float stickY, float stickLength, S
 	bool isLeft = stickMode == StickMode::LEFT_STICK;
 	bool gyroMatchesStickMode = (gyroOutput == GyroOutput::LEFT_STICK && stickMode == StickMode::LEFT_STICK) || (gyroOutput == GyroOutput::RIGHT_STICK && stickMode == StickMode::RIGHT_STICK) || stickMode == StickMode::INVALID;
 
-	float undeadzoneInner, undeadzoneOuter, unpower, virtualScale;
-	if (isLeft)
-	{
-		undeadzoneInner = getSetting(SettingID::LEFT_STICK_UNDEADZONE_INNER);
-		undeadzoneOuter = getSetting(SettingID::LEFT_STICK_UNDEADZONE_OUTER);
-		unpower = getSetting(SettingID::LEFT_STICK_UNPOWER);
-		virtualScale = getSetting(SettingID::LEFT_STICK_VIRTUAL_SCALE);
-	}
-	else
-	{
-		undeadzoneInner = getSetting(SettingID::RIGHT_STICK_UNDEADZONE_INNER);
-		undeadzoneOuter = getSetting(SettingID::RIGHT_STICK_UNDEADZONE_OUTER);
-		unpower = getSetting(SettingID::RIGHT_STICK_UNPOWER);
-		virtualScale = getSetting(SettingID::RIGHT_STICK_VIRTUAL_SCALE);
-	}
+	const VirtualStickCurve &virtualStick = getVirtualStickCurve(isLeft);
+	float undeadzoneInner = virtualStick.undeadzoneInner;
+	float livezoneSize = virtualStick.livezoneSize;
+	float virtualScale = getSetting(isLeft ? SettingID::LEFT_STICK_VIRTUAL_SCALE : SettingID::RIGHT_STICK_VIRTUAL_SCALE);
 
 	// in order to correctly combine gyro and stick, we need to calculate what the stick aiming is supposed to be doing, add gyro result to it, and convert back to stick
 	float maxStickGameSpeed = getSetting(SettingID::VIRTUAL_STICK_CALIBRATION);
-	float livezoneSize = 1.f - undeadzoneOuter - undeadzoneInner;
 	if (livezoneSize <= 0.f || maxStickGameSpeed <= 0.f)
 	{
 		// can't do anything with that
 		processed_gyro_stick |= gyroMatchesStickMode;
 		return false;
 	}
-	if (unpower == 0.f)
-		unpower = 1.f;
-	float stickVelocity = pow(clamp<float>((stickLength - undeadzoneInner) / livezoneSize, 0.f, 1.f), unpower) * maxStickGameSpeed * virtualScale;
+	float stickVelocity = virtualStick.unpower(clamp<float>((stickLength - undeadzoneInner) / livezoneSize, 0.f, 1.f)) * maxStickGameSpeed * virtualScale;
 	float expectedX = 0.f;
 	float expectedY = 0.f;
 	if (stickVelocity > 0.f)
@@ -1562,10 +1535,7 @@ bool JoyShock::processGyroStick(float stickX, float stickY, float stickLength, S
 	// map gyro velocity to achievable range in 0-1
 	float gyroInStickStrength = targetGyroVelocity >= maxStickGameSpeed ? 1.f : targetGyroVelocity / maxStickGameSpeed;
 	// unpower curve
-	if (unpower != 0.f)
-	{
-		gyroInStickStrength = pow(gyroInStickStrength, 1.f / unpower);
-	}
+	gyroInStickStrength = virtualStick.inverse(gyroInStickStrength);
 	// remap to between inner and outer deadzones
 	float gyroStickX = 0.f;
 	float gyroStickY = 0.f;
@@ -44,9 +44,9 @@ public:
 		return JslGetMotionState(deviceId);
 	}
 
-	TOUCH_STATE GetTouchState(int deviceId, bool previous = false) override
+	TOUCH_STATE GetTouchState(int deviceId) override
 	{
-		return JslGetTouchState(deviceId, previous);
+		return JslGetTouchState(deviceId, false);
 	}
 
 	bool GetTouchpadDimension(int deviceId, int& sizeX, int& sizeY) override
@@ -184,11 +184,6 @@ public:
 		JslSetCallback(callback);
 	}
 
-	void SetTouchCallback(void (*callback)(int, TOUCH_STATE, TOUCH_STATE, float)) override
-	{
-		JslSetTouchCallback(callback);
-	}
-
 	int GetControllerType(int deviceId) override
 	{
 		return JslGetControllerType(deviceId);
@@ -99,67 +99,145 @@ Mapping::Mapping(string_view mapping)
 	}
 }
 
+void KeyAction::apply(EventActionIf &button) const
+{
+	switch (kind)
+	{
+	case Kind::Key:
+		button.ApplyBtnPress(key);
+		break;
+	case Kind::Gyro:
+		button.ApplyGyroAction(key);
+		break;
+	case Kind::Calibrate:
+		button.StartCalibration();
+		break;
+	case Kind::Command:
+		WriteToConsole(key.name);
+		break;
+	case Kind::Rumble:
+		button.SetRumble(smallRumble, bigRumble);
+		break;
+	}
+}
+
+void KeyAction::release(EventActionIf &button) const
+{
+	switch (kind)
+	{
+	case Kind::Key:
+		button.ApplyBtnRelease(key);
+		break;
+	case Kind::Gyro:
+		button.RemoveGyroAction();
+		break;
+	case Kind::Calibrate:
+		button.FinishCalibration();
+		break;
+	case Kind::Command:
+		break;
+	case Kind::Rumble:
+		button.SetRumble(0, 0);
+		break;
+	}
+}
+
 void Mapping::ProcessEvent(BtnEvent evt, EventActionIf &button) const
 {
 	// COUT << button._id << " processes event " << evt << '\n';
-	auto entry = _eventMapping.find(evt);
-	if (entry != _eventMapping.end() && entry->second) // Skip over empty entries
+	if (size_t(evt) >= NUM_EVENTS || !hasOps(evt)) // Skip over empty entries
+		return;
+
+	switch (evt)
+	{
+	case BtnEvent::OnPress:
+		COUT << button.getDisplayName() << ": true\n";
+		break;
+	case BtnEvent::OnRelease:
+	case BtnEvent::OnHoldRelease:
+		COUT << button.getDisplayName() << ": false\n";
+		break;
+	case BtnEvent::OnTap:
+		COUT << button.getDisplayName() << ": tapped\n";
+		break;
+	case BtnEvent::OnHold:
+		COUT << button.getDisplayName() << ": held\n";
+		break;
+	case BtnEvent::OnTurbo:
+		COUT << button.getDisplayName() << ": turbo\n";
+		break;
+	}
+
+	// DEBUG_LOG << button.getDisplayName() << " processes event " << evt << '\n';
+	auto [first, count] = _eventOps[size_t(evt)];
+	for (const ActionOp *op = &_program[first], *end = op + count; op != end; ++op)
 	{
-		switch (evt)
+		const KeyAction &action = _actions[op->action];
+		switch (op->type)
 		{
-		case BtnEvent::OnPress:
-			COUT << button.getDisplayName() << ": true\n";
+		case ActionOp::Type::Apply:
+			action.apply(button);
 			break;
-		case BtnEvent::OnRelease:
-		case BtnEvent::OnHoldRelease:
-			COUT << button.getDisplayName() << ": false\n";
+		case ActionOp::Type::Release:
+			action.release(button);
 			break;
-		case BtnEvent::OnTap:
-			COUT << button.getDisplayName() << ": tapped\n";
+		case ActionOp::Type::Toggle:
+			button.ApplyButtonToggle(action);
 			break;
-		case BtnEvent::OnHold:
-			COUT << button.getDisplayName() << ": held\n";
+		case ActionOp::Type::InstantApply:
+			button.RegisterInstant(op->instantEvent, { action, true });
 			break;
-		case BtnEvent::OnTurbo:
-			COUT << button.getDisplayName() << ": turbo\n";
+		case ActionOp::Type::InstantRelease:
+			button.RegisterInstant(op->instantEvent, { action, false });
 			break;
 		}
+	}
+}
 
-		if (entry->second)
+void Mapping::InsertOp(BtnEvent evt, ActionOp op)
+{
+	// The program is sorted by event: append after the other ops of the event and move the ops of later events
+	auto &[first, count] = _eventOps[size_t(evt)];
+	if (count == 0)
+	{
+		first = 0;
+		for (size_t i = 0; i < size_t(evt); ++i)
 		{
-			// DEBUG_LOG << button.getDisplayName() << " processes event " << evt << '\n';
-			entry->second(&button);
+			first = max<uint8_t>(first, _eventOps[i].first + _eventOps[i].second);
 		}
 	}
+	size_t position = first + count;
+	_program.insert(_program.begin() + position, op);
+	for (size_t i = size_t(evt) + 1; i < NUM_EVENTS; ++i)
+	{
+		if (_eventOps[i].second > 0)
+			++_eventOps[i].first;
+	}
+	++count;
 }
 
-void Mapping::InsertEventMapping(BtnEvent evt, EventActionIf::Callback action)
+size_t Mapping::countMappedEvents() const
 {
-	if (action)
-	{
-		auto existingActions = _eventMapping.find(evt);
-		_eventMapping[evt] = existingActions == _eventMapping.end() ? action :
-		                                                              bind(&RunBothActions, placeholders::_1, existingActions->second, action); // Chain with already existing mapping, if any
-	}
+	return count_if(_eventOps.begin(), _eventOps.end(), [](auto &ops)
+	  { return ops.second > 0; });
 }
 
 bool Mapping::AddMapping(KeyCode key, EventModifier evtMod, ActionModifier actMod)
 {
-	EventActionIf::Callback apply, apply2, release;
-	if (key.code == 0)
+	if (key.code == 0 || _actions.size() >= UINT8_MAX || _program.size() + 3 > UINT8_MAX)
 	{
 		return false;
 	}
+	KeyAction action;
+	action.key = key;
 	if (key.code == CALIBRATE)
 	{
-		apply = bind(&EventActionIf::StartCalibration, placeholders::_1);
-		release = bind(&EventActionIf::FinishCalibration, placeholders::_1);
+		action.kind = KeyAction::Kind::Calibrate;
 		_tapDurationMs = MAGIC_EXTENDED_TAP_DURATION; // Unused in regular press
 	}
 	else if (key.code >= GYRO_INV_X && key.code <= GYRO_TRACKBALL)
 	{
-		apply = bind(&EventActionIf::ApplyGyroAction, placeholders::_1, key);
-		release = bind(&EventActionIf::RemoveGyroAction, placeholders::_1);
+		action.kind = KeyAction::Kind::Gyro;
 		_tapDurationMs = MAGIC_EXTENDED_TAP_DURATION; // Unused in regular press
 	}
 	else if (key.code == COMMAND_ACTION)
@@ -170,26 +248,20 @@ bool Mapping::AddMapping(KeyCode key, EventModifier evtMod, ActionModifier actMo
 			COUT << "Error: \"" << key.name << "\" is not a valid command\n";
 			return false;
 		}
-		apply = bind(&WriteToConsole, key.name);
-		release = EventActionIf::Callback();
+		action.kind = KeyAction::Kind::Command;
 	}
 	else if (key.code == RUMBLE)
 	{
-		union Rumble
-		{
-			int raw;
-			array<uint8_t, 2> bytes;
-		} rumble;
-		rumble.raw = stoi(key.name.substr(1, 4), nullptr, 16);
-		apply = bind(&EventActionIf::SetRumble, placeholders::_1, rumble.bytes[0] << 8, rumble.bytes[1] << 8);
-		release = bind(&EventActionIf::SetRumble, placeholders::_1, 0, 0);
+		int rumble = stoi(key.name.substr(1, 4), nullptr, 16);
+		action.kind = KeyAction::Kind::Rumble;
+		action.smallRumble = (rumble & 0xFF) << 8;
+		action.bigRumble = ((rumble >> 8) & 0xFF) << 8;
 		_tapDurationMs = MAGIC_EXTENDED_TAP_DURATION; // Unused in regular press
 	}
 	else //
 	{
 		_hasViGEmBtn |= isControllerKey(key.code); // Set flag if vigem button
-		apply = bind(&EventActionIf::ApplyBtnPress, placeholders::_1, key);
-		release = bind(&EventActionIf::ApplyBtnRelease, placeholders::_1, key);
+		action.kind = KeyAction::Kind::Key;
 	}
 
 	BtnEvent applyEvt, releaseEvt;
@@ -220,46 +292,54 @@ bool Mapping::AddMapping(KeyCode key, EventModifier evtMod, ActionModifier actMo
 		return false;
 	}
 
+	uint8_t index = uint8_t(_actions.size());
+	using Type = ActionOp::Type;
 	switch (actMod)
 	{
+	case ActionModifier::None:
+		if (evtMod == EventModifier::TurboPress)
+		{
+			// Regular turbo holds key down and pulses up during the instant window:
+			// send key up and register key down on instant
+			InsertOp(applyEvt, { Type::Release, index });
+			InsertOp(applyEvt, { Type::InstantApply, index, applyEvt });
+		}
+		else
+		{
+			InsertOp(applyEvt, { Type::Apply, index });
+		}
+		if (action.hasRelease())
+		{
+			InsertOp(releaseEvt, { Type::Release, index });
+		}
+		break;
 	case ActionModifier::Toggle:
-		apply = bind(&EventActionIf::ApplyButtonToggle, placeholders::_1, key, apply, release);
-		release = nullptr;
+		InsertOp(applyEvt, { Type::Toggle, index });
 		break;
 	case ActionModifier::Instant:
-		apply2 = bind(&EventActionIf::RegisterInstant, placeholders::_1, applyEvt, release);
-		apply = bind(&Mapping::RunBothActions, placeholders::_1, apply, apply2);
-		release = nullptr;
+		InsertOp(applyEvt, { Type::Apply, index });
+		if (action.hasRelease())
+		{
+			InsertOp(applyEvt, { Type::InstantRelease, index, applyEvt });
+		}
 		break;
 	case ActionModifier::Release:
-		apply = release;
-		release = nullptr;
-		break;
-	case ActionModifier::INVALID:
-		return false;
-		// None applies no modification... Hey!
-	}
-
-	// Extra turbo handling
-	if (evtMod == EventModifier::TurboPress)
-	{
-		if (actMod == ActionModifier::None) // Regular turbo holds key down and pulses up during the instant window
+		if (action.hasRelease())
 		{
-			apply2 = bind(&EventActionIf::RegisterInstant, placeholders::_1, applyEvt, apply);// send key down on instant
-			apply = bind(&Mapping::RunBothActions, placeholders::_1, release, apply2); // send key up and register key down
+			InsertOp(applyEvt, { Type::Release, index });
 		}
-		// else handled already in instant case above
+		break;
+	default: // ActionModifier::INVALID
+		return false;
 	}
-
-	InsertEventMapping(applyEvt, apply);
-	InsertEventMapping(releaseEvt, release);
+	_actions.push_back(move(action));
 
 	stringstream ss;
 	// Update Description
 	if (_description.compare("no input") != 0)
 	{
 		ss << _description;
-		if (_eventMapping.size() > 2 && _eventMapping.find(BtnEvent::OnPress) != _eventMapping.end())
+		if (countMappedEvents() > 2 && hasOps(BtnEvent::OnPress))
 		{
 			ss << " on Start Press";
 		}
@@ -270,7 +350,7 @@ bool Mapping::AddMapping(KeyCode key, EventModifier evtMod, ActionModifier actMo
 		ss << actMod << " ";
 	}
 	ss << key.name;
-	if (_eventMapping.size() > 3 || evtMod != Mapping::EventModifier::StartPress)
+	if (countMappedEvents() > 3 || evtMod != Mapping::EventModifier::StartPress)
 	{
 		ss << " on " << evtMod;
 	}
@@ -308,11 +388,3 @@ bool Mapping::AppendToCommand(KeyCode key, EventModifier evtMod, ActionModifier
 	_command = ss.str();
 	return true;
 }
-
-void Mapping::RunBothActions(EventActionIf *btn, EventActionIf::Callback action1, EventActionIf::Callback action2)
-{
-	if (action1)
-		action1(btn);
-	if (action2)
-		action2(btn);
-}
@@ -20,6 +20,30 @@ public:
 		gamepadMotion.ProcessMotion(gyroX, gyroY, gyroZ, accelX, accelY, accelZ, deltaTime);
 	}
 
+	virtual MotionResult ProcessMotion(std::span<const MotionSample> samples) override
+	{
+		// Sensor fusion is a recurrence over the samples, so they go through one by one.
+		// What the batch saves is reading the state once instead of after each of them.
+		MotionResult result;
+		for (const MotionSample &sample : samples)
+		{
+			gamepadMotion.ProcessMotion(sample.gyroX, sample.gyroY, sample.gyroZ, sample.accelX, sample.accelY, sample.accelZ, sample.deltaTime);
+			gamepadMotion.GetCalibratedGyro(result.gyroX, result.gyroY, result.gyroZ);
+			result.rotationX += result.gyroX * sample.deltaTime;
+			result.rotationY += result.gyroY * sample.deltaTime;
+			result.rotationZ += result.gyroZ * sample.deltaTime;
+			result.deltaTime += sample.deltaTime;
+		}
+		if (samples.empty())
+		{
+			gamepadMotion.GetCalibratedGyro(result.gyroX, result.gyroY, result.gyroZ);
+		}
+		gamepadMotion.GetGravity(result.gravX, result.gravY, result.gravZ);
+		gamepadMotion.GetProcessedAcceleration(result.accelX, result.accelY, result.accelZ);
+		gamepadMotion.GetOrientation(result.quatW, result.quatX, result.quatY, result.quatZ);
+		return result;
+	}
+
 	// reading the current state
 	virtual void GetCalibratedGyro(float& x, float& y, float& z) override 
 	{
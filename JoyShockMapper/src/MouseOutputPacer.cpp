@@ -0,0 +1,151 @@
+#include "InputHelpers.h"
+#include "OutputCapture.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+using PacerClock = chrono::steady_clock;
+
+// Sends the mouse motion of each tick in even slices at a fixed rate, instead of all at once when the tick runs.
+// The motion of a tick is spread over the time the previous tick took, so it is all sent by the time the next one
+// is expected. If the next tick comes early, what is left is sent right away: motion is never late by more than a tick.
+class MouseOutputPacer
+{
+public:
+	~MouseOutputPacer()
+	{
+		setRate(0.f);
+	}
+
+	void setRate(float rate)
+	{
+		unique_lock lock(_mutex);
+		if (rate == _rate)
+			return;
+		_rate = rate;
+		if (_thread.joinable())
+		{
+			_running = false;
+			_wakeup.notify_all();
+			lock.unlock();
+			_thread.join();
+			lock.lock();
+		}
+		flush();
+		if (rate > 0.f)
+		{
+			_period = chrono::duration_cast<PacerClock::duration>(chrono::duration<double>(1.0 / rate));
+			_running = true;
+			_thread = thread(&MouseOutputPacer::run, this);
+		}
+	}
+
+	void move(float x, float y)
+	{
+		lock_guard lock(_mutex);
+		if (!_running)
+		{
+			sendMouseMove(x, y);
+			return;
+		}
+		auto now = PacerClock::now();
+		auto sinceLastTick = now - _lastTick;
+		if (sinceLastTick >= _period) // Calls closer than that belong to the same tick
+		{
+			flush();
+			if (sinceLastTick < MAX_TICK_INTERVAL)
+				_tickInterval = sinceLastTick; // Otherwise the mouse was idle: keep the last tick interval
+			_windowEnd = now + max(_tickInterval, _period);
+			_lastTick = now;
+		}
+		_remainingX += x;
+		_remainingY += y;
+	}
+
+	void sendPending()
+	{
+		lock_guard lock(_mutex);
+		flush();
+	}
+
+private:
+	// Longer than any TICK_TIME, so a longer time between ticks means the mouse wasn't moving
+	static constexpr PacerClock::duration MAX_TICK_INTERVAL = chrono::milliseconds(100);
+
+	void run()
+	{
+		unique_lock lock(_mutex);
+		auto next = PacerClock::now();
+		while (_running)
+		{
+			next += _period;
+			if (_wakeup.wait_until(lock, next, [this]()
+			      { return !_running; }))
+				break;
+
+			auto now = PacerClock::now();
+			if (now - next > _period)
+				next = now; // Woke up late: don't send a burst to catch up
+			if (_remainingX == 0.f && _remainingY == 0.f)
+				continue;
+			auto left = _windowEnd - now;
+			float share = left <= _period ? 1.f : float(chrono::duration<double>(_period) / left);
+			float x = _remainingX * share;
+			float y = _remainingY * share;
+			_remainingX -= x;
+			_remainingY -= y;
+			sendMouseMove(x, y);
+		}
+	}
+
+	// Send what is left right away
+	void flush()
+	{
+		if (_remainingX != 0.f || _remainingY != 0.f)
+		{
+			sendMouseMove(_remainingX, _remainingY);
+			_remainingX = 0.f;
+			_remainingY = 0.f;
+		}
+	}
+
+	mutex _mutex;
+	condition_variable _wakeup;
+	thread _thread;
+	bool _running = false;
+	float _rate = 0.f;
+	PacerClock::duration _period = PacerClock::duration::zero();
+	PacerClock::duration _tickInterval = PacerClock::duration::zero();
+	PacerClock::time_point _lastTick;
+	PacerClock::time_point _windowEnd;
+	float _remainingX = 0.f;
+	float _remainingY = 0.f;
+};
+
+MouseOutputPacer &pacer()
+{
+	static MouseOutputPacer pacer;
+	return pacer;
+}
+} // namespace
+
+void moveMouse(float x, float y)
+{
+	if (OutputCapture::captureMouseMove(x, y))
+		return;
+	pacer().move(x, y);
+}
+
+void setMouseOutputRate(float rate)
+{
+	pacer().setRate(rate);
+}
+
+void flushMouseMove()
+{
+	pacer().sendPending();
+}
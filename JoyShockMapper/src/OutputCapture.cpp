@@ -0,0 +1,252 @@
+#include "OutputCapture.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+namespace
+{
+atomic<OutputCapture *> activeCapture = nullptr;
+
+// Stands in for the virtual controller while capturing. Only changes are recorded, except for the gyro.
+class CapturingGamepad : public Gamepad
+{
+public:
+	CapturingGamepad(OutputCapture &capture, ControllerScheme scheme)
+	  : _capture(capture)
+	  , _scheme(scheme)
+	{
+	}
+
+	bool isInitialized(string *errorMsg = nullptr) const override
+	{
+		return true;
+	}
+
+	void setButton(KeyCode btn, bool pressed) override
+	{
+		_capture.record("PAD_BUTTON", btn.name, { pressed ? 1.f : 0.f });
+	}
+
+	void setLeftStick(float x, float y) override
+	{
+		setStick(x, y, true);
+	}
+
+	void setRightStick(float x, float y) override
+	{
+		setStick(x, y, false);
+	}
+
+	void setStick(float x, float y, bool isLeft) override
+	{
+		FloatXY &last = isLeft ? _leftStick : _rightStick;
+		if (last.x() != x || last.y() != y)
+		{
+			last = { x, y };
+			_capture.record("PAD_STICK", isLeft ? "LEFT" : "RIGHT", { x, y });
+		}
+	}
+
+	void setLeftTrigger(float value) override
+	{
+		setTrigger(value, true);
+	}
+
+	void setRightTrigger(float value) override
+	{
+		setTrigger(value, false);
+	}
+
+	void setGyro(TimePoint now, float accelX, float accelY, float accelZ, float gyroX, float gyroY, float gyroZ) override
+	{
+		_capture.record("PAD_GYRO", "-", { accelX, accelY, accelZ, gyroX, gyroY, gyroZ });
+	}
+
+	void setTouchState(optional<FloatXY> press1, optional<FloatXY> press2) override
+	{
+		_capture.record("PAD_TOUCH", "-", { press1 ? 1.f : 0.f, press1 ? press1->x() : 0.f, press1 ? press1->y() : 0.f, press2 ? 1.f : 0.f, press2 ? press2->x() : 0.f, press2 ? press2->y() : 0.f });
+	}
+
+	void update() override
+	{
+	}
+
+	ControllerScheme getType() const override
+	{
+		return _scheme;
+	}
+
+private:
+	void setTrigger(float value, bool isLeft)
+	{
+		float &last = isLeft ? _leftTrigger : _rightTrigger;
+		if (last != value)
+		{
+			last = value;
+			_capture.record("PAD_TRIGGER", isLeft ? "LEFT" : "RIGHT", { value });
+		}
+	}
+
+	OutputCapture &_capture;
+	ControllerScheme _scheme;
+	FloatXY _leftStick;
+	FloatXY _rightStick;
+	float _leftTrigger = 0.f;
+	float _rightTrigger = 0.f;
+};
+
+// Splits a capture line in words
+vector<string> splitWords(const string &line)
+{
+	vector<string> words;
+	stringstream ss(line);
+	for (string word; ss >> word;)
+	{
+		words.push_back(word);
+	}
+	return words;
+}
+
+bool readLines(string_view path, vector<string> &lines, ostream &report)
+{
+	ifstream file{ string(path) };
+	if (!file)
+	{
+		report << "Cannot read " << path << '\n';
+		return false;
+	}
+	for (string line; getline(file, line);)
+	{
+		if (!line.empty())
+			lines.push_back(line);
+	}
+	return true;
+}
+
+bool wordsMatch(const string &expected, const string &actual, float tolerance)
+{
+	if (expected == actual)
+		return true;
+	char *expectedEnd = nullptr;
+	char *actualEnd = nullptr;
+	double expectedValue = strtod(expected.c_str(), &expectedEnd);
+	double actualValue = strtod(actual.c_str(), &actualEnd);
+	return *expectedEnd == '\0' && *actualEnd == '\0' && !expected.empty() && !actual.empty() &&
+	  fabs(expectedValue - actualValue) <= tolerance;
+}
+} // namespace
+
+OutputCapture::OutputCapture(shared_ptr<ClockIf> clock)
+  : _clock(clock)
+  , _start(clock->now())
+{
+}
+
+void OutputCapture::setActive(OutputCapture *capture)
+{
+	activeCapture = capture;
+}
+
+bool OutputCapture::captureKey(KeyCode key, bool pressed)
+{
+	OutputCapture *capture = activeCapture;
+	if (!capture)
+		return false;
+	capture->record("KEY", key.name.empty() ? to_string(key.code) : key.name, { pressed ? 1.f : 0.f });
+	return true;
+}
+
+bool OutputCapture::captureMouseMove(float x, float y)
+{
+	OutputCapture *capture = activeCapture;
+	if (!capture)
+		return false;
+	capture->record("MOUSE_MOVE", "-", { x, y });
+	return true;
+}
+
+bool OutputCapture::captureMouseAbsolute(float x, float y)
+{
+	OutputCapture *capture = activeCapture;
+	if (!capture)
+		return false;
+	capture->record("MOUSE_ABSOLUTE", "-", { x, y });
+	return true;
+}
+
+Gamepad *OutputCapture::newGamepad(ControllerScheme scheme, Gamepad::Callback notification)
+{
+	OutputCapture *capture = activeCapture;
+	if (!capture)
+		return Gamepad::getNew(scheme, notification);
+	return new CapturingGamepad(*capture, scheme);
+}
+
+void OutputCapture::record(string_view kind, string_view target, initializer_list<float> values)
+{
+	char number[32];
+	snprintf(number, sizeof(number), "%.3f", chrono::duration<double, milli>(_clock->now() - _start).count());
+	string line(number);
+	line.append(" ").append(kind).append(" ").append(target);
+	for (float value : values)
+	{
+		snprintf(number, sizeof(number), " %.6g", value);
+		line.append(number);
+	}
+	lock_guard guard(_lock);
+	_lines.push_back(move(line));
+}
+
+bool OutputCapture::save(string_view path)
+{
+	ofstream file{ string(path), ios::trunc };
+	lock_guard guard(_lock);
+	for (auto &line : _lines)
+	{
+		file << line << '\n';
+	}
+	if (!file)
+	{
+		CERR << "Cannot write the output capture to " << path << '\n';
+		return false;
+	}
+	return true;
+}
+
+bool OutputCapture::compare(string_view expectedPath, string_view actualPath, float tolerance, ostream &report)
+{
+	static constexpr int MAX_REPORTED = 20;
+	vector<string> expected, actual;
+	if (!readLines(expectedPath, expected, report) || !readLines(actualPath, actual, report))
+		return false;
+
+	int differences = 0;
+	for (size_t i = 0; i < max(expected.size(), actual.size()); ++i)
+	{
+		const string *expectedLine = i < expected.size() ? &expected[i] : nullptr;
+		const string *actualLine = i < actual.size() ? &actual[i] : nullptr;
+		bool same = false;
+		if (expectedLine && actualLine)
+		{
+			auto expectedWords = splitWords(*expectedLine);
+			auto actualWords = splitWords(*actualLine);
+			same = expectedWords.size() == actualWords.size() &&
+			  equal(expectedWords.begin(), expectedWords.end(), actualWords.begin(), [tolerance](auto &lhs, auto &rhs)
+			    { return wordsMatch(lhs, rhs, tolerance); });
+		}
+		if (!same && ++differences <= MAX_REPORTED)
+		{
+			report << "Event " << i + 1 << ":\n"
+			       << "  expected: " << (expectedLine ? *expectedLine : "nothing") << '\n'
+			       << "  actual:   " << (actualLine ? *actualLine : "nothing") << '\n';
+		}
+	}
+	if (differences > MAX_REPORTED)
+	{
+		report << "... and " << differences - MAX_REPORTED << " more differences\n";
+	}
+	report << expected.size() << " events expected, " << actual.size() << " captured, " << differences << " different\n";
+	return differences == 0;
+}
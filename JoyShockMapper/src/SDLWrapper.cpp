@@ -1,53 +1,31 @@
 #include "JSMVariable.hpp"
 #include "JslWrapper.h"
 #include "JSMVariable.hpp"
- #include "TriggerEffectGenerator.h"
+#include "DualSenseEffects.h"
 #include "SettingsManager.h"
 #include "SDL3/SDL.h"
 #include <map>
 #include <mutex>
 #include <atomic>
+#include <condition_variable>
 #define _USE_MATH_DEFINES
 #include <math.h> // M_PI
 #include <algorithm>
 #include <memory>
 #include <iostream>
 #include <cstring>
+#include <cstdio>
 #include <span>
+#include <chrono>
 
-typedef struct
-{
-	Uint8 ucEnableBits1;              /* 0 */
-	Uint8 ucEnableBits2;              /* 1 */
-	Uint8 ucRumbleRight;              /* 2 */
-	Uint8 ucRumbleLeft;               /* 3 */
-	Uint8 ucHeadphoneVolume;          /* 4 */
-	Uint8 ucSpeakerVolume;            /* 5 */
-	Uint8 ucMicrophoneVolume;         /* 6 */
-	Uint8 ucAudioEnableBits;          /* 7 */
-	Uint8 ucMicLightMode;             /* 8 */
-	Uint8 ucAudioMuteBits;            /* 9 */
-	Uint8 rgucRightTriggerEffect[11]; /* 10 */
-	Uint8 rgucLeftTriggerEffect[11];  /* 21 */
-	Uint8 rgucUnknown1[6];            /* 32 */
-	Uint8 ucLedFlags;                 /* 38 */
-	Uint8 rgucUnknown2[2];            /* 39 */
-	Uint8 ucLedAnim;                  /* 41 */
-	Uint8 ucLedBrightness;            /* 42 */
-	Uint8 ucPadLights;                /* 43 */
-	Uint8 ucLedRed;                   /* 44 */
-	Uint8 ucLedGreen;                 /* 45 */
-	Uint8 ucLedBlue;                  /* 46 */
-} DS5EffectsState_t;
 
 struct ControllerDevice
 {
-	ControllerDevice(int id)
+	ControllerDevice(SDL_JoystickID id)
 	  : _has_accel(false)
 	  , _has_gyro(false)
+	  , _instanceId(id)
 	{
-		_prevTouchState.t0Down = false;
-		_prevTouchState.t1Down = false;
 		if (SDL_IsGamepad(id))
 		{
 			_sdlController = nullptr;
@@ -73,10 +51,15 @@ struct ControllerDevice
 					{
 						SDL_SetGamepadSensorEnabled(_sdlController, SDL_SENSOR_ACCEL, true);
 					}
-
 					int vid = SDL_GetGamepadVendor(_sdlController);
 					int pid = SDL_GetGamepadProduct(_sdlController);
 
+					// Without a serial number, all controllers of the same model share the same identity
+					const char *serial = SDL_GetGamepadSerial(_sdlController);
+					char identity[128];
+					snprintf(identity, sizeof(identity), "%04x:%04x:%s", vid, pid, serial ? serial : "");
+					_identity = identity;
+
 					auto sdl_ctrlr_type = SDL_GetGamepadType(_sdlController);
 					switch (sdl_ctrlr_type)
 					{
@@ -130,6 +113,15 @@ struct ControllerDevice
 						}
 						break;
 					}
+
+					// The gyro rate is the report rate times the motion samples in each report. Switch controllers
+					// send 3 of them in each report, about every 15 ms.
+					if (_ctrlr_type == JS_TYPE_JOYCON_LEFT || _ctrlr_type == JS_TYPE_JOYCON_RIGHT || _ctrlr_type == JS_TYPE_PRO_CONTROLLER)
+					{
+						_samplesPerReport = 3;
+					}
+					float dataRate = _has_gyro ? SDL_GetGamepadSensorDataRate(_sdlController, SDL_SENSOR_GYRO) : 0.f;
+					_reportInterval = dataRate > 0.f ? 1000.f * _samplesPerReport / dataRate : 0.f;
 				}// next attempt?
 			}
 		}
@@ -151,44 +143,40 @@ struct ControllerDevice
 		return _sdlController != nullptr;
 	}
 
-private:
-	void LoadTriggerEffect(uint8_t *rgucTriggerEffect, const AdaptiveTriggerSetting *trigger_effect)
+	// Milliseconds between reports: measured from the sensor timestamps once they came in, else what SDL says
+	float reportInterval() const
 	{
-		using namespace ExtendInput::DataTools::DualSense;
-		rgucTriggerEffect[0] = (uint8_t)trigger_effect->mode;
-		switch (trigger_effect->mode)
-		{
-		case AdaptiveTriggerMode::RESISTANCE_RAW:
+		return _measuredInterval > 0.f ? _measuredInterval : _reportInterval;
+	}
+
+	void onSensorUpdate(Uint64 timestamp, const float *gyro)
+	{
+		_gyroSum[0] += gyro[0];
+		_gyroSum[1] += gyro[1];
+		_gyroSum[2] += gyro[2];
+		++_gyroSamples;
+		if (_lastSensorTimestamp != 0 && timestamp > _lastSensorTimestamp)
 		{
-			TriggerEffectGenerator::Simple_Feedback(rgucTriggerEffect, 0, trigger_effect->start, trigger_effect->force);
+			// The samples of a report are spread over the time since the previous report.
+			// Long gaps, like the controller sleeping, shouldn't throw it off.
+			float interval = min(float(timestamp - _lastSensorTimestamp) / 1000000.f * _samplesPerReport, 100.f);
+			_measuredInterval = _measuredInterval == 0.f ? interval : _measuredInterval + (interval - _measuredInterval) * 0.05f;
 		}
-		break;
-		case AdaptiveTriggerMode::SEGMENT:
-			rgucTriggerEffect[1] = trigger_effect->start;
-			rgucTriggerEffect[2] = trigger_effect->end;
-			rgucTriggerEffect[3] = trigger_effect->force;
-			break;
-		case AdaptiveTriggerMode::RESISTANCE:
-			TriggerEffectGenerator::Feedback(rgucTriggerEffect, 0, trigger_effect->start, trigger_effect->force);
-			break;
-		case AdaptiveTriggerMode::BOW:
-			TriggerEffectGenerator::Bow(rgucTriggerEffect, 0, trigger_effect->start, trigger_effect->end, trigger_effect->force, trigger_effect->forceExtra);
-			break;
-		case AdaptiveTriggerMode::GALLOPING:
-			TriggerEffectGenerator::Galloping(rgucTriggerEffect, 0, trigger_effect->start, trigger_effect->end, trigger_effect->force, trigger_effect->forceExtra, trigger_effect->frequency);
-			break;
-	    case AdaptiveTriggerMode::SEMI_AUTOMATIC:
-			TriggerEffectGenerator::Simple_Weapon(rgucTriggerEffect, 0, trigger_effect->start, trigger_effect->end, trigger_effect->force);
-			break;
-		case AdaptiveTriggerMode::AUTOMATIC:
-			TriggerEffectGenerator::Simple_Vibration(rgucTriggerEffect, 0, trigger_effect->start, trigger_effect->force, trigger_effect->frequency);
-			break;
-		case AdaptiveTriggerMode::MACHINE:
-			TriggerEffectGenerator::Machine(rgucTriggerEffect, 0, trigger_effect->start, trigger_effect->end, trigger_effect->force, trigger_effect->forceExtra, trigger_effect->frequency, trigger_effect->frequencyExtra);
-			break;
-		default:
-			rgucTriggerEffect[0] = 0x05; // no effect
+		_lastSensorTimestamp = timestamp;
+	}
+
+	// Reads the axis and keeps the smallest change seen, which is the resolution of the controller
+	float readAxis(SDL_GamepadAxis axis)
+	{
+		Sint16 value = SDL_GetGamepadAxis(_sdlController, axis);
+		int change = abs(value - _lastAxis[axis]);
+		_lastAxis[axis] = value;
+		int &step = axis == SDL_GAMEPAD_AXIS_LEFT_TRIGGER || axis == SDL_GAMEPAD_AXIS_RIGHT_TRIGGER ? _triggerStep : _stickStep;
+		if (change > 0 && (step == 0 || change < step))
+		{
+			step = change;
 		}
+		return value / (float)SDL_JOYSTICK_AXIS_MAX;
 	}
 
 public:
@@ -220,15 +208,33 @@ public:
 
 	bool _has_gyro;
 	bool _has_accel;
+	SDL_JoystickID _instanceId;
 	int _split_type = JS_SPLIT_TYPE_FULL;
 	int _ctrlr_type = 0;
+	string _identity;
 	uint16_t _small_rumble = 0;
 	uint16_t _big_rumble = 0;
 	AdaptiveTriggerSetting _leftTriggerEffect;
 	AdaptiveTriggerSetting _rightTriggerEffect;
 	uint8_t _micLight = 0;
 	SDL_Gamepad *_sdlController = nullptr;
-	TOUCH_STATE _prevTouchState;
+	float _reportInterval = 0.f; // Milliseconds between reports from the device, 0 if unknown
+	float _measuredInterval = 0.f; // Same, from the timestamps of the motion samples
+	int _samplesPerReport = 1;     // Motion samples in each report from the device
+	Uint64 _lastSensorTimestamp = 0;
+	Sint16 _lastAxis[SDL_GAMEPAD_AXIS_COUNT] = {};
+	int _stickStep = 0; // Smallest change of the stick axes, 0 until one moved
+	int _triggerStep = 0; // Same for the triggers
+	float _gyroSum[3] = { 0.f, 0.f, 0.f }; // Gyro of the sensor reports since the last tick, in radians per second
+	int _gyroSamples = 0;
+	// Input when the mapping last said the device was at rest. See JslWrapper::SetIdle().
+	bool _idle = false;
+	int _idlePair = -1; // Other half of a merged pair of Joy-Cons, whose input wakes this device too
+	int _idleButtons = 0;
+	Sint16 _idleAxes[SDL_GAMEPAD_AXIS_COUNT] = {};
+	float _idleGyro[3] = { 0.f, 0.f, 0.f };
+	chrono::steady_clock::time_point _lastTick;
+	chrono::steady_clock::time_point _nextTick;
 };
 
 struct SdlInstance : public JslWrapper
@@ -257,45 +263,178 @@ public:
 		SDL_Quit();
 	}
 
+	// Milliseconds between two ticks of the device
+	static float getTickTime(const ControllerDevice &device, float tickTime, bool deviceTickTime)
+	{
+		if (deviceTickTime && device.reportInterval() > 0.f)
+		{
+			return clamp(device.reportInterval(), 1.f, 100.f);
+		}
+		return tickTime;
+	}
+
+	// Ask the controllers that support it for the report interval of the setting. SDL applies it to the connected ones too.
+	void applyReportInterval()
+	{
+		float interval = SettingsManager::get<float>(SettingID::DS4_REPORT_INTERVAL)->value();
+		if (interval != _ds4ReportInterval)
+		{
+			_ds4ReportInterval = interval;
+#ifdef SDL_HINT_JOYSTICK_HIDAPI_PS4_REPORT_INTERVAL
+			SDL_SetHint(SDL_HINT_JOYSTICK_HIDAPI_PS4_REPORT_INTERVAL, to_string(int(interval)).c_str());
+#endif
+		}
+	}
+
+	// Each device is ticked on its own period, and the thread sleeps until the next device is due
 	int pollDevices()
 	{
+		auto wakeUp = chrono::steady_clock::now();
 		while (keep_polling)
 		{
-			auto tick_time = SettingsManager::get<float>(SettingID::TICK_TIME)->value();
-			SDL_Delay(Uint32(tick_time));
+			auto now = chrono::steady_clock::now();
+			if (wakeUp > now)
+			{
+				SDL_DelayNS(chrono::duration_cast<chrono::nanoseconds>(wakeUp - now).count());
+			}
 
+			auto tick_time = SettingsManager::get<float>(SettingID::TICK_TIME)->value();
+			bool deviceTickTime = SettingsManager::get<Switch>(SettingID::DEVICE_TICK_TIME)->value() == Switch::ON;
+			auto idleTickTime = SettingsManager::get<float>(SettingID::IDLE_TICK_TIME)->value();
 			lock_guard guard(controller_lock);
+			applyReportInterval();
 			SDL_UpdateGamepads();
+			checkHotplugEvents();
+			now = chrono::steady_clock::now();
+			// SDL has no way to wait for input: devices at rest are still checked every tick time, which is cheap
+			wakeUp = now + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<float, milli>(tick_time));
 			for (auto iter = _controllerMap.begin(); iter != _controllerMap.end(); ++iter)
 			{
+				ControllerDevice &device = *iter->second;
+				if (device._nextTick > now)
+				{
+					if (!device._idle || !leftRest(iter->first, device))
+					{
+						wakeUp = min(wakeUp, device._nextTick);
+						continue;
+					}
+					device._nextTick = now; // The input of a device at rest changed: tick it right away
+				}
+				float deviceTime = getTickTime(device, tick_time, deviceTickTime);
+				float elapsed = device._lastTick == chrono::steady_clock::time_point() ? deviceTime : chrono::duration<float, milli>(now - device._lastTick).count();
+				device._lastTick = now;
+
 				if (g_callback)
 				{
 					JOY_SHOCK_STATE dummy1;
 					IMU_STATE dummy2;
 					memset(&dummy1, 0, sizeof(dummy1));
 					memset(&dummy2, 0, sizeof(dummy2));
-					g_callback(iter->first, dummy1, dummy1, dummy2, dummy2, tick_time);
+					g_callback(iter->first, dummy1, dummy1, dummy2, dummy2, elapsed);
 				}
-				if (g_touch_callback)
+				device._gyroSum[0] = device._gyroSum[1] = device._gyroSum[2] = 0.f;
+				device._gyroSamples = 0;
+
+				// Scheduled after the callback, which tells if the device is at rest. Rumble needs refreshing at full rate.
+				if (device._idle && idleTickTime > 0.f && device._small_rumble == 0 && device._big_rumble == 0)
+				{
+					deviceTime = max(deviceTime, idleTickTime);
+				}
+				auto period = chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<float, milli>(deviceTime));
+				// Keep a steady cadence, unless the device fell a whole period behind
+				device._nextTick += period;
+				if (device._nextTick <= now)
 				{
-					TOUCH_STATE touch = GetTouchState(iter->first, false);
-					g_touch_callback(iter->first, touch, iter->second->_prevTouchState, tick_time);
-					iter->second->_prevTouchState = touch;
+					device._nextTick = now + period;
 				}
+				wakeUp = min(wakeUp, device._nextTick);
+
 				// Perform rumble
-				SDL_RumbleGamepad(iter->second->_sdlController, iter->second->_big_rumble, iter->second->_small_rumble, Uint32(tick_time + 5));
+				SDL_RumbleGamepad(device._sdlController, device._big_rumble, device._small_rumble, Uint32(deviceTime + 5));
 			}
 		}
 
 		return 1;
 	}
 
+	// True if the input moved away from the snapshot taken when the device came to rest
+	bool leftRest(int handle, ControllerDevice &device)
+	{
+		static constexpr int AXIS_TOLERANCE = SDL_JOYSTICK_AXIS_MAX / 20;
+		static constexpr float GYRO_TOLERANCE = float(5. * M_PI / 180.); // Above the noise of a still controller
+		if (GetButtons(handle) != device._idleButtons)
+			return true;
+		bool down = false;
+		if (SDL_GetNumGamepadTouchpads(device._sdlController) > 0 && SDL_GetGamepadTouchpadFinger(device._sdlController, 0, 0, &down, nullptr, nullptr, nullptr) && down)
+			return true;
+		for (int axis = 0; axis < SDL_GAMEPAD_AXIS_COUNT; ++axis)
+		{
+			if (abs(SDL_GetGamepadAxis(device._sdlController, SDL_GamepadAxis(axis)) - device._idleAxes[axis]) > AXIS_TOLERANCE)
+				return true;
+		}
+		array<float, 3> gyro = { 0.f, 0.f, 0.f };
+		if (device._has_gyro)
+		{
+			SDL_GetGamepadSensorData(device._sdlController, SDL_SENSOR_GYRO, &gyro[0], 3);
+		}
+		if (abs(gyro[0] - device._idleGyro[0]) > GYRO_TOLERANCE || abs(gyro[1] - device._idleGyro[1]) > GYRO_TOLERANCE ||
+		  abs(gyro[2] - device._idleGyro[2]) > GYRO_TOLERANCE)
+			return true;
+		auto pair = _controllerMap.find(device._idlePair);
+		return pair != _controllerMap.end() && leftRest(pair->first, *pair->second);
+	}
+
+	// Called with controller_lock held, right after SDL has detected added and removed devices
+	void checkHotplugEvents()
+	{
+		SDL_Event events[32];
+		for (int count = SDL_PeepEvents(events, 32, SDL_GETEVENT, SDL_EVENT_GAMEPAD_SENSOR_UPDATE, SDL_EVENT_GAMEPAD_SENSOR_UPDATE); count > 0;
+		     count = SDL_PeepEvents(events, 32, SDL_GETEVENT, SDL_EVENT_GAMEPAD_SENSOR_UPDATE, SDL_EVENT_GAMEPAD_SENSOR_UPDATE))
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				if (events[i].gsensor.sensor != SDL_SENSOR_GYRO)
+					continue;
+				for (auto &[handle, device] : _controllerMap)
+				{
+					if (device->_instanceId == events[i].gsensor.which)
+					{
+						device->onSensorUpdate(events[i].gsensor.sensor_timestamp, events[i].gsensor.data);
+						break;
+					}
+				}
+			}
+		}
+		bool changed = false;
+		for (int count = SDL_PeepEvents(events, 8, SDL_GETEVENT, SDL_EVENT_JOYSTICK_ADDED, SDL_EVENT_JOYSTICK_REMOVED); count > 0;
+		     count = SDL_PeepEvents(events, 8, SDL_GETEVENT, SDL_EVENT_JOYSTICK_ADDED, SDL_EVENT_JOYSTICK_REMOVED))
+		{
+			changed = true;
+		}
+		// Nothing else consumes SDL events: don't let them pile up in the queue
+		SDL_FlushEvents(SDL_EVENT_FIRST, SDL_EVENT_LAST);
+		if (changed)
+		{
+			int count = 0;
+			SDL_free(SDL_GetJoysticks(&count));
+			_deviceCount = count;
+			lock_guard hotplugGuard(_hotplugMutex);
+			++_hotplugSerial;
+			_hotplugCV.notify_all();
+		}
+	}
+
 	SDL_JoystickID * _joysticksArray = nullptr;
+	atomic_int _deviceCount = 0;
+	mutex _hotplugMutex;
+	condition_variable _hotplugCV;
+	uint64_t _hotplugSerial = 0;
+	uint64_t _lastSeenHotplugSerial = 0;
 	map<int, ControllerDevice *> _controllerMap;
 	void (*g_callback)(int, JOY_SHOCK_STATE, JOY_SHOCK_STATE, IMU_STATE, IMU_STATE, float) = nullptr;
-	void (*g_touch_callback)(int, TOUCH_STATE, TOUCH_STATE, float) = nullptr;
 	atomic_bool keep_polling = false;
 	mutex controller_lock;
+	float _ds4ReportInterval = 0.f; // Last value given to SDL
 
 	int ConnectDevices() override
 	{
@@ -311,22 +450,42 @@ public:
 			  "Poll Devices", this);
 			SDL_DetachThread(controller_polling_thread);
 		}
+		{
+			// Before the controllers get opened
+			lock_guard guard(controller_lock);
+			applyReportInterval();
+		}
 		SDL_UpdateGamepads(); // Refresh driver listing
 		SDL_free(_joysticksArray);
 		int count = 0;
 		_joysticksArray = SDL_GetJoysticks(&count);
+		_deviceCount = count;
 		return count;
 	}
 
 	int GetDeviceCount() override
 	{
+		if (keep_polling)
+		{
+			// Kept up to date by the polling thread from SDL's hotplug events
+			return _deviceCount;
+		}
 		std::lock_guard guard(controller_lock);
-		SDL_free(_joysticksArray);
 		int count = 0;
-		_joysticksArray = SDL_GetJoysticks(&count);
+		SDL_free(SDL_GetJoysticks(&count));
+		_deviceCount = count;
 		return count;
 	}
 
+	bool WaitForDeviceChange(unsigned int timeoutMs) override
+	{
+		unique_lock lock(_hotplugMutex);
+		bool changed = _hotplugCV.wait_for(lock, chrono::milliseconds(timeoutMs), [this]
+		  { return _hotplugSerial != _lastSeenHotplugSerial; });
+		_lastSeenHotplugSerial = _hotplugSerial;
+		return changed || !keep_polling;
+	}
+
 	int GetConnectedDeviceHandles(int *deviceHandleArray, int size) override
 	{
 		lock_guard guard(controller_lock);
@@ -358,7 +517,6 @@ public:
 		lock_guard guard(controller_lock);
 		keep_polling = false;
 		g_callback = nullptr;
-		g_touch_callback = nullptr;
 		auto iter = _controllerMap.begin();
 		while (iter != _controllerMap.end())
 		{
@@ -379,10 +537,19 @@ public:
 	{
 		IMU_STATE imuState;
 		memset(&imuState, 0, sizeof(imuState));
-		if (_controllerMap[deviceId]->_has_gyro)
+		ControllerDevice *device = _controllerMap[deviceId];
+		if (device->_has_gyro)
 		{
 			array<float, 3> gyro;
-			SDL_GetGamepadSensorData(_controllerMap[deviceId]->_sdlController, SDL_SENSOR_GYRO, &gyro[0], 3);
+			SDL_GetGamepadSensorData(device->_sdlController, SDL_SENSOR_GYRO, &gyro[0], 3);
+			if (device->_idle && device->_gyroSamples > 1)
+			{
+				// The long tick of a device at rest: the average of its reports keeps the samples the calibration needs
+				for (int i = 0; i < 3; ++i)
+				{
+					gyro[i] = device->_gyroSum[i] / device->_gyroSamples;
+				}
+			}
 			static constexpr float toDegPerSec = float(180. / M_PI);
 			imuState.gyroX = gyro[0] * toDegPerSec;
 			imuState.gyroY = gyro[1] * toDegPerSec;
@@ -405,7 +572,7 @@ public:
 		return MOTION_STATE();
 	}
 
-	TOUCH_STATE GetTouchState(int deviceId, bool previous) override
+	TOUCH_STATE GetTouchState(int deviceId) override
 	{
 		TOUCH_STATE state;
 		memset(&state, 0, sizeof(TOUCH_STATE));
@@ -509,32 +676,32 @@ public:
 
 	float GetLeftX(int deviceId) override
 	{
-		return SDL_GetGamepadAxis(_controllerMap[deviceId]->_sdlController, SDL_GAMEPAD_AXIS_LEFTX) / (float)SDL_JOYSTICK_AXIS_MAX;
+		return _controllerMap[deviceId]->readAxis(SDL_GAMEPAD_AXIS_LEFTX);
 	}
 
 	float GetLeftY(int deviceId) override
 	{
-		return -SDL_GetGamepadAxis(_controllerMap[deviceId]->_sdlController, SDL_GAMEPAD_AXIS_LEFTY) / (float)SDL_JOYSTICK_AXIS_MAX;
+		return -_controllerMap[deviceId]->readAxis(SDL_GAMEPAD_AXIS_LEFTY);
 	}
 
 	float GetRightX(int deviceId) override
 	{
-		return SDL_GetGamepadAxis(_controllerMap[deviceId]->_sdlController, SDL_GAMEPAD_AXIS_RIGHTX) / (float)SDL_JOYSTICK_AXIS_MAX;
+		return _controllerMap[deviceId]->readAxis(SDL_GAMEPAD_AXIS_RIGHTX);
 	}
 
 	float GetRightY(int deviceId) override
 	{
-		return -SDL_GetGamepadAxis(_controllerMap[deviceId]->_sdlController, SDL_GAMEPAD_AXIS_RIGHTY) / (float)SDL_JOYSTICK_AXIS_MAX;
+		return -_controllerMap[deviceId]->readAxis(SDL_GAMEPAD_AXIS_RIGHTY);
 	}
 
 	float GetLeftTrigger(int deviceId) override
 	{
-		return (SDL_GetGamepadAxis(_controllerMap[deviceId]->_sdlController, SDL_GAMEPAD_AXIS_LEFT_TRIGGER)) / (float)(SDL_JOYSTICK_AXIS_MAX);
+		return _controllerMap[deviceId]->readAxis(SDL_GAMEPAD_AXIS_LEFT_TRIGGER);
 	}
 
 	float GetRightTrigger(int deviceId) override
 	{
-		return (SDL_GetGamepadAxis(_controllerMap[deviceId]->_sdlController, SDL_GAMEPAD_AXIS_RIGHT_TRIGGER)) / (float)(SDL_JOYSTICK_AXIS_MAX);
+		return _controllerMap[deviceId]->readAxis(SDL_GAMEPAD_AXIS_RIGHT_TRIGGER);
 	}
 
 	float GetGyroX(int deviceId) override
@@ -615,17 +782,18 @@ public:
 
 	float GetStickStep(int deviceId) override
 	{
-		return float();
+		return _controllerMap[deviceId]->_stickStep / (float)SDL_JOYSTICK_AXIS_MAX;
 	}
 
 	float GetTriggerStep(int deviceId) override
 	{
-		return float();
+		return _controllerMap[deviceId]->_triggerStep / (float)SDL_JOYSTICK_AXIS_MAX;
 	}
 
 	float GetPollRate(int deviceId) override
 	{
-		return float();
+		float interval = _controllerMap[deviceId]->reportInterval();
+		return interval > 0.f ? 1000.f / interval : float();
 	}
 
 	void ResetContinuousCalibration(int deviceId) override
@@ -654,12 +822,6 @@ public:
 		g_callback = callback;
 	}
 
-	void SetTouchCallback(void (*callback)(int, TOUCH_STATE, TOUCH_STATE, float)) override
-	{
-		lock_guard guard(controller_lock);
-		g_touch_callback = callback;
-	}
-
 	int GetControllerType(int deviceId) override
 	{
 		return _controllerMap[deviceId]->_ctrlr_type;
@@ -670,6 +832,11 @@ public:
 		return _controllerMap[deviceId]->_split_type;
 	}
 
+	string GetControllerIdentity(int deviceId) override
+	{
+		return _controllerMap[deviceId]->_identity;
+	}
+
 	int GetControllerColour(int deviceId) override
 	{
 		return int();
@@ -715,6 +882,31 @@ public:
 		_controllerMap[deviceId]->SendEffect();
 	}
 
+	void SetIdle(int deviceId, bool idle, int pairedDeviceId) override
+	{
+		ControllerDevice *device = _controllerMap[deviceId];
+		device->_idle = idle;
+		device->_idlePair = pairedDeviceId;
+		if (idle)
+		{
+			// Snapshot the input at rest, to notice when it changes
+			device->_idleButtons = GetButtons(deviceId);
+			for (int axis = 0; axis < SDL_GAMEPAD_AXIS_COUNT; ++axis)
+			{
+				device->_idleAxes[axis] = SDL_GetGamepadAxis(device->_sdlController, SDL_GamepadAxis(axis));
+			}
+			array<float, 3> gyro = { 0.f, 0.f, 0.f };
+			if (device->_has_gyro)
+			{
+				SDL_GetGamepadSensorData(device->_sdlController, SDL_SENSOR_GYRO, &gyro[0], 3);
+			}
+			for (int i = 0; i < 3; ++i)
+			{
+				device->_idleGyro[i] = device->_gyroSamples > 0 ? device->_gyroSum[i] / device->_gyroSamples : gyro[i];
+			}
+		}
+	}
+
 	virtual void SetMicLight(int deviceId, uint8_t mode) override
 	{
 		if (mode != _controllerMap[deviceId]->_micLight)
@@ -4,12 +4,20 @@
 #include <set>
 
 SettingsManager::SettingsMap SettingsManager::_settings;
+vector<const vector<JSMButton> *> SettingsManager::_buttons;
+atomic<shared_ptr<const SettingsSnapshot>> SettingsManager::_snapshot{ make_shared<SettingsSnapshot>() };
+int SettingsManager::_transactionDepth = 0;
 
 bool SettingsManager::add(SettingID id, JSMVariableBase *setting)
 {
 	return _settings.emplace(id, setting).second;
 }
 
+void SettingsManager::addButtons(const vector<JSMButton> *buttons)
+{
+	_buttons.push_back(buttons);
+}
+
 
 void SettingsManager::resetAllSettings()
 {
@@ -19,15 +27,87 @@ void SettingsManager::resetAllSettings()
 	};
 	static constexpr auto exceptions = [](SettingsMap::value_type &kvPair)
 	{
-		static set<SettingID> exceptions = {
-			SettingID::AUTOLOAD,
-			SettingID::JSM_DIRECTORY,
-			SettingID::HIDE_MINIMIZED,
-			SettingID::VIRTUAL_CONTROLLER,
-			SettingID::ADAPTIVE_TRIGGER,
-			SettingID::RUMBLE,
-		};
-		return exceptions.find(kvPair.first) == exceptions.end();
+		return !isKeptOnReset(kvPair.first);
 	};
 	ranges::for_each(_settings | views::filter(exceptions), callReset);
 }
+
+bool SettingsManager::isKeptOnReset(SettingID id)
+{
+	static const set<SettingID> exceptions = {
+		SettingID::AUTOLOAD,
+		SettingID::AUTORELOAD,
+		SettingID::JSM_DIRECTORY,
+		SettingID::HIDE_MINIMIZED,
+		SettingID::VIRTUAL_CONTROLLER,
+		SettingID::ADAPTIVE_TRIGGER,
+		SettingID::RUMBLE,
+	};
+	return exceptions.contains(id);
+}
+
+bool SettingsManager::isKeptOnReset(const JSMVariableBase *setting)
+{
+	return setting && ranges::any_of(_settings, [setting](auto &kvPair)
+	  { return kvPair.second.get() == setting && isKeptOnReset(kvPair.first); });
+}
+
+vector<pair<SettingID, shared_ptr<const FrozenVariable>>> SettingsManager::freezeKeptSettings()
+{
+	vector<pair<SettingID, shared_ptr<const FrozenVariable>>> values;
+	for (auto &[id, setting] : _settings)
+	{
+		if (isKeptOnReset(id))
+			values.emplace_back(id, setting->freeze());
+	}
+	return values;
+}
+
+bool SettingsManager::keptSettingsMatch(const vector<pair<SettingID, shared_ptr<const FrozenVariable>>> &values)
+{
+	return ranges::all_of(values, [](auto &value)
+	  {
+		auto setting = _settings.find(value.first);
+		return setting != _settings.end() && setting->second->matches(*value.second); });
+}
+
+shared_ptr<SettingsSnapshot> SettingsManager::freeze()
+{
+	auto values = make_shared<SettingsSnapshot>();
+	for (auto &[id, setting] : _settings)
+	{
+		if (id <= SettingID::INVALID)
+			continue;
+		// Indexed by value, which can be past what magic_enum counts
+		if (size_t(id) >= values->_values.size())
+			values->_values.resize(size_t(id) + 1);
+		values->_values[size_t(id)] = setting->freeze();
+	}
+	for (auto buttons : _buttons)
+	{
+		for (auto &button : *buttons)
+		{
+			if (size_t(button._id) >= values->_buttons.size())
+				values->_buttons.resize(size_t(button._id) + 1);
+			values->_buttons[size_t(button._id)] = button.freezeButton();
+		}
+	}
+	return values;
+}
+
+void SettingsManager::thaw(const SettingsSnapshot &values)
+{
+	for (auto &[id, setting] : _settings)
+	{
+		if (!isKeptOnReset(id) && id > SettingID::INVALID && size_t(id) < values._values.size() && values._values[size_t(id)])
+			setting->thaw(*values._values[size_t(id)]);
+	}
+}
+
+void SettingsManager::publish()
+{
+	auto current = _snapshot.load(memory_order_relaxed);
+	auto next = freeze();
+	next->_version = current->_version + 1;
+	_snapshot.store(move(next), memory_order_release);
+}
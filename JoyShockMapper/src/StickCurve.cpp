@@ -0,0 +1,55 @@
+#include "StickCurve.h"
+
+#include <cmath>
+
+void PowerCurve::setExponent(float exponent)
+{
+	if (exponent == _exponent)
+		return;
+
+	_exponent = exponent;
+	_useTable = false;
+	if (exponent == 1.f)
+		return; // operator() returns x as is
+
+	_fourthRoot = exponent < 0.5f;
+	float rootDegree = _fourthRoot ? 4.f : 2.f;
+	for (int i = 0; i <= SEGMENTS; ++i)
+	{
+		_table[i] = pow(float(i) / SEGMENTS, rootDegree * exponent);
+	}
+
+	// Compare the interpolation with pow() between the entries
+	constexpr int CHECKS_PER_SEGMENT = 4;
+	_useTable = true;
+	for (int i = 0; i < SEGMENTS * CHECKS_PER_SEGMENT && _useTable; ++i)
+	{
+		float root = (i + 0.5f) / (SEGMENTS * CHECKS_PER_SEGMENT);
+		float x = _fourthRoot ? root * root * root * root : root * root;
+		_useTable = abs((*this)(x) - pow(x, exponent)) <= MAX_ERROR;
+	}
+}
+
+float PowerCurve::operator()(float x) const
+{
+	if (!_useTable || !(x >= 0.f && x <= 1.f))
+	{
+		return _exponent == 1.f ? x : pow(x, _exponent);
+	}
+	float root = _fourthRoot ? sqrtf(sqrtf(x)) : sqrtf(x);
+	float position = root * SEGMENTS;
+	int index = min(int(position), SEGMENTS - 1);
+	float fraction = position - index;
+	return _table[index] + (_table[index + 1] - _table[index]) * fraction;
+}
+
+void VirtualStickCurve::update(float inner, float outer, float unpowerExponent)
+{
+	undeadzoneInner = inner;
+	livezoneSize = 1.f - outer - inner;
+	// An UNPOWER of 0 means no curve, same as 1
+	if (unpowerExponent == 0.f)
+		unpowerExponent = 1.f;
+	unpower.setExponent(unpowerExponent);
+	inverse.setExponent(1.f / unpowerExponent);
+}
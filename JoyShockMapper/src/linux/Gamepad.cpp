@@ -1,4 +1,22 @@
 #include "Gamepad.h"
+#include "PlatformDefinitions.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <libevdev/libevdev-uinput.h>
+#include <linux/uinput.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
 
 size_t Gamepad::_count = 0;
 
@@ -12,60 +30,592 @@ Gamepad::~Gamepad()
 	--_count;
 }
 
+// One virtual evdev node created through /dev/uinput. Unlike the mouse and keyboard devices,
+// events are not written one at a time: they are queued into a frame which publish() writes
+// with a single write() call terminated by one SYN_REPORT. Consumers thus see all the changes
+// of a tick at once.
+class UinputNode
+{
+public:
+	UinputNode(string_view name, uint16_t vendor, uint16_t product, uint16_t version = 0x0111)
+	  : _dev(libevdev_new())
+	{
+		libevdev_set_name(_dev, string(name).c_str());
+		libevdev_set_id_bustype(_dev, BUS_USB);
+		libevdev_set_id_vendor(_dev, vendor);
+		libevdev_set_id_product(_dev, product);
+		libevdev_set_id_version(_dev, version);
+	}
+
+	~UinputNode()
+	{
+		if (_uinput)
+			libevdev_uinput_destroy(_uinput);
+		libevdev_free(_dev);
+	}
+
+	UinputNode(const UinputNode &) = delete;
+	UinputNode &operator=(const UinputNode &) = delete;
+
+	void enableKey(uint16_t code)
+	{
+		libevdev_enable_event_type(_dev, EV_KEY);
+		libevdev_enable_event_code(_dev, EV_KEY, code, nullptr);
+	}
+
+	void enableAbs(uint16_t code, int min, int max, int fuzz = 0, int flat = 0, int resolution = 0)
+	{
+		input_absinfo info{};
+		info.minimum = min;
+		info.maximum = max;
+		info.fuzz = fuzz;
+		info.flat = flat;
+		info.resolution = resolution;
+		libevdev_enable_event_type(_dev, EV_ABS);
+		libevdev_enable_event_code(_dev, EV_ABS, code, &info);
+	}
+
+	void enable(uint16_t type, uint16_t code)
+	{
+		libevdev_enable_event_type(_dev, type);
+		libevdev_enable_event_code(_dev, type, code, nullptr);
+	}
+
+	void enableProperty(uint16_t prop)
+	{
+		libevdev_enable_property(_dev, prop);
+	}
+
+	// Returns an empty string on success, or the reason why the node could not be created.
+	string create()
+	{
+		// libevdev reserves force feedback slots on the device when EV_FF is enabled
+		int error = libevdev_uinput_create_from_device(_dev, LIBEVDEV_UINPUT_OPEN_MANAGED, &_uinput);
+		if (error != 0)
+		{
+			_uinput = nullptr;
+			stringstream ss;
+			ss << "Failed to create virtual device " << libevdev_get_name(_dev) << ": " << strerror(-error) << '\n'
+			   << "JoyShockMapper needs write access to /dev/uinput, see dist/linux/50-joyshockmapper.rules";
+			return ss.str();
+		}
+		return string();
+	}
+
+	inline bool isCreated() const
+	{
+		return _uinput != nullptr;
+	}
+
+	inline int fd() const
+	{
+		return _uinput ? libevdev_uinput_get_fd(_uinput) : -1;
+	}
+
+	// Add an event to the current frame. Values that didn't change since they were last published
+	// are skipped, unless the code is stateless (EV_MSC) or the node is a multitouch surface where
+	// the same code is repeated once per slot.
+	void queue(uint16_t type, uint16_t code, int value, bool force = false)
+	{
+		if (!force && type != EV_MSC)
+		{
+			auto &last = _published[(uint32_t(type) << 16) | code];
+			if (last && *last == value)
+				return;
+			last = value;
+		}
+		input_event evt{};
+		evt.type = type;
+		evt.code = code;
+		evt.value = value;
+		_frame.push_back(evt);
+	}
+
+	// Write the whole frame in one system call
+	void publish()
+	{
+		if (_frame.empty() || !_uinput)
+		{
+			_frame.clear();
+			return;
+		}
+		input_event syn{};
+		syn.type = EV_SYN;
+		syn.code = SYN_REPORT;
+		_frame.push_back(syn);
+
+		const size_t size = _frame.size() * sizeof(input_event);
+		if (write(fd(), _frame.data(), size) != ssize_t(size))
+		{
+			CERR << "Failed to publish the report of " << libevdev_get_name(_dev) << ": " << strerror(errno) << '\n';
+		}
+		_frame.clear();
+	}
 
-class GamepadImpl : public Gamepad
+private:
+	libevdev *_dev = nullptr;
+	libevdev_uinput *_uinput = nullptr;
+	vector<input_event> _frame;
+	map<uint32_t, optional<int>> _published;
+};
+
+class UinputGamepad : public Gamepad
 {
 public:
-	// TODO: Implement this class by interacting with some external virtual controller software
+	UinputGamepad(Callback notification, string_view name, uint16_t vendor, uint16_t product)
+	  : _notification(notification)
+	  , _pad(name, vendor, product)
+	{
+		// There is no player number to read back from uinput: use the order of creation
+		_indicator.led = uint8_t(getCount());
+	}
 
-	GamepadImpl()
+	virtual ~UinputGamepad()
 	{
+		_running = false;
+		if (_rumbleThread.joinable())
+			_rumbleThread.join();
+	}
 
+	bool isInitialized(string *errorMsg = nullptr) const override
+	{
+		if (!_errorMsg.empty() && errorMsg != nullptr)
+		{
+			*errorMsg = _errorMsg;
+		}
+		return _errorMsg.empty() && _pad.isCreated();
 	}
 
-	virtual ~GamepadImpl()
+	void setButton(KeyCode btn, bool pressed) override
 	{
+		if (btn.code >= X_UP && btn.code <= X_RIGHT)
+		{
+			_dpad[btn.code - X_UP] = pressed;
+		}
+		else if (btn.code == X_LT)
+		{
+			isLeftTriggerPressedDigitally = pressed;
+			setLeftTrigger(1.0f);
+		}
+		else if (btn.code == X_RT)
+		{
+			isRightTriggerPressedDigitally = pressed;
+			setRightTrigger(1.0f);
+		}
+		else if (auto found = buttonMap().find(btn.code); found != buttonMap().end())
+		{
+			_buttons[found->second] = pressed;
+		}
+	}
 
+	void setLeftStick(float x, float y) override
+	{
+		_leftStick += FloatXY{ x, y };
 	}
 
-    // is not overriding anything? removed override from function
-	virtual bool isInitialized(std::string* errorMsg = nullptr) {
+	void setRightStick(float x, float y) override
+	{
+		_rightStick += FloatXY{ x, y };
+	}
 
+	void setStick(float x, float y, bool isLeft) override
+	{
+		isLeft ? setLeftStick(x, y) : setRightStick(x, y);
 	}
 
-	virtual void setButton(KeyCode btn, bool pressed) override
+	void setLeftTrigger(float val) override
 	{
+		_leftTrigger += clamp(val, 0.f, 1.f);
+	}
 
+	void setRightTrigger(float val) override
+	{
+		_rightTrigger += clamp(val, 0.f, 1.f);
 	}
 
-	virtual void setLeftStick(float x, float y) override
+	void setGyro(TimePoint now, float accelX, float accelY, float accelZ, float gyroX, float gyroY, float gyroZ) override
 	{
+	}
 
+	void setTouchState(optional<FloatXY> press1, optional<FloatXY> press2) override
+	{
 	}
 
-	virtual void setRightStick(float x, float y) override
+	void update() override
 	{
+		if (isInitialized())
+		{
+			if (isLeftTriggerPressedDigitally)
+				setLeftTrigger(1.0f);
+			if (isRightTriggerPressedDigitally)
+				setRightTrigger(1.0f);
 
+			for (auto [code, pressed] : _buttons)
+			{
+				_pad.queue(EV_KEY, code, pressed ? 1 : 0);
+			}
+			_pad.queue(EV_ABS, ABS_HAT0X, int(_dpad[X_RIGHT - X_UP]) - int(_dpad[X_LEFT - X_UP]));
+			_pad.queue(EV_ABS, ABS_HAT0Y, int(_dpad[X_DOWN - X_UP]) - int(_dpad[0]));
+			_pad.queue(EV_ABS, ABS_X, stickToRaw(_leftStick.x()));
+			_pad.queue(EV_ABS, ABS_Y, stickToRaw(-_leftStick.y()));
+			_pad.queue(EV_ABS, ABS_RX, stickToRaw(_rightStick.x()));
+			_pad.queue(EV_ABS, ABS_RY, stickToRaw(-_rightStick.y()));
+			_pad.queue(EV_ABS, ABS_Z, triggerToRaw(_leftTrigger));
+			_pad.queue(EV_ABS, ABS_RZ, triggerToRaw(_rightTrigger));
+			onUpdate();
+			_pad.publish();
+
+			// Analog values are accumulated during a tick: start the next one from neutral, but preserve buttons
+			_leftStick = { 0.f, 0.f };
+			_rightStick = { 0.f, 0.f };
+			_leftTrigger = 0.f;
+			_rightTrigger = 0.f;
+		}
 	}
 
-	virtual void setLeftTrigger(float) override
+protected:
+	// To be called by the subclass constructors, once they have added their specific events to the node.
+	void createPad(int stickMin, int stickMax, int stickFuzz, int stickFlat)
 	{
+		_stickMin = stickMin;
+		_stickMax = stickMax;
+		for (auto [key, code] : buttonMap())
+		{
+			_pad.enableKey(code);
+			_buttons[code] = false;
+		}
+		_pad.enableAbs(ABS_X, stickMin, stickMax, stickFuzz, stickFlat);
+		_pad.enableAbs(ABS_Y, stickMin, stickMax, stickFuzz, stickFlat);
+		_pad.enableAbs(ABS_RX, stickMin, stickMax, stickFuzz, stickFlat);
+		_pad.enableAbs(ABS_RY, stickMin, stickMax, stickFuzz, stickFlat);
+		_pad.enableAbs(ABS_Z, 0, UCHAR_MAX);
+		_pad.enableAbs(ABS_RZ, 0, UCHAR_MAX);
+		_pad.enableAbs(ABS_HAT0X, -1, 1);
+		_pad.enableAbs(ABS_HAT0Y, -1, 1);
+		_pad.enable(EV_FF, FF_RUMBLE);
 
+		_errorMsg = _pad.create();
+		if (_errorMsg.empty())
+		{
+			_running = true;
+			_rumbleThread = thread(&UinputGamepad::pollRumble, this);
+		}
 	}
 
-	virtual void setRightTrigger(float) override
+	void notify(uint8_t largeMotor, uint8_t smallMotor, Indicator indicator)
 	{
-	
+		if (_notification && _running)
+			_notification(largeMotor, smallMotor, indicator);
 	}
 
-	virtual void update() override
+	// Map of JSM key codes to evdev button codes
+	virtual const map<uint16_t, uint16_t> &buttonMap() const = 0;
+
+	// Hook for subclasses to add their own events to the frame, or publish other nodes
+	virtual void onUpdate()
 	{
+	}
 
+	UinputNode _pad;
+	Indicator _indicator{};
+	float _leftTrigger = 0.f;
+	float _rightTrigger = 0.f;
+	bool isLeftTriggerPressedDigitally = false;
+	bool isRightTriggerPressedDigitally = false;
+
+private:
+	int stickToRaw(float value) const
+	{
+		float normalized = (clamp(value, -1.f, 1.f) + 1.f) / 2.f;
+		return _stickMin + int(roundf(normalized * (_stickMax - _stickMin)));
+	}
+
+	static int triggerToRaw(float value)
+	{
+		return int(roundf(clamp(value, 0.f, 1.f) * UCHAR_MAX));
+	}
+
+	// The kernel forwards force feedback requests made by games to the uinput file descriptor
+	void pollRumble()
+	{
+		struct Rumble
+		{
+			uint16_t strong = 0;
+			uint16_t weak = 0;
+		};
+		map<int16_t, Rumble> effects;
+		pollfd pfd{ _pad.fd(), POLLIN, 0 };
+		while (_running)
+		{
+			if (poll(&pfd, 1, 100) <= 0 || (pfd.revents & POLLIN) == 0)
+				continue;
+
+			input_event evt;
+			if (read(pfd.fd, &evt, sizeof(evt)) != sizeof(evt))
+				continue;
+
+			if (evt.type == EV_UINPUT && evt.code == UI_FF_UPLOAD)
+			{
+				uinput_ff_upload upload{};
+				upload.request_id = evt.value;
+				if (ioctl(pfd.fd, UI_BEGIN_FF_UPLOAD, &upload) == 0)
+				{
+					if (upload.effect.type == FF_RUMBLE)
+					{
+						effects[upload.effect.id] = { upload.effect.u.rumble.strong_magnitude, upload.effect.u.rumble.weak_magnitude };
+						upload.retval = 0;
+					}
+					else
+					{
+						upload.retval = -EINVAL;
+					}
+					ioctl(pfd.fd, UI_END_FF_UPLOAD, &upload);
+				}
+			}
+			else if (evt.type == EV_UINPUT && evt.code == UI_FF_ERASE)
+			{
+				uinput_ff_erase erase{};
+				erase.request_id = evt.value;
+				if (ioctl(pfd.fd, UI_BEGIN_FF_ERASE, &erase) == 0)
+				{
+					effects.erase(erase.effect_id);
+					erase.retval = 0;
+					ioctl(pfd.fd, UI_END_FF_ERASE, &erase);
+				}
+			}
+			else if (evt.type == EV_FF && evt.code != FF_GAIN)
+			{
+				auto effect = effects.find(evt.code);
+				if (evt.value > 0 && effect != effects.end())
+				{
+					notify(effect->second.strong >> 8, effect->second.weak >> 8, _indicator);
+				}
+				else
+				{
+					notify(0, 0, _indicator);
+				}
+			}
+		}
+	}
+
+	Callback _notification = nullptr;
+	map<uint16_t, bool> _buttons;
+	array<bool, 4> _dpad{}; // X_UP, X_DOWN, X_LEFT, X_RIGHT
+	FloatXY _leftStick;
+	FloatXY _rightStick;
+	int _stickMin = 0;
+	int _stickMax = 0;
+	atomic_bool _running = false;
+	thread _rumbleThread;
+};
+
+// Looks like a wired Xbox 360 controller to the xpad based mappings of games and SDL
+class XboxGamepad : public UinputGamepad
+{
+public:
+	XboxGamepad(Callback notification)
+	  : UinputGamepad(notification, "Microsoft X-Box 360 pad", 0x045E, 0x028E)
+	{
+		createPad(SHRT_MIN, SHRT_MAX, 16, 128);
+	}
+
+	ControllerScheme getType() const override
+	{
+		return ControllerScheme::XBOX;
+	}
+
+protected:
+	const map<uint16_t, uint16_t> &buttonMap() const override
+	{
+		static const map<uint16_t, uint16_t> buttonMap{
+			{ X_A, BTN_SOUTH },
+			{ X_B, BTN_EAST },
+			{ X_X, BTN_WEST },
+			{ X_Y, BTN_NORTH },
+			{ X_LB, BTN_TL },
+			{ X_RB, BTN_TR },
+			{ X_BACK, BTN_SELECT },
+			{ X_START, BTN_START },
+			{ X_GUIDE, BTN_MODE },
+			{ X_LS, BTN_THUMBL },
+			{ X_RS, BTN_THUMBR },
+		};
+		return buttonMap;
 	}
 };
 
+// Mirrors the nodes the hid-playstation driver creates for a DualShock 4:
+// the gamepad itself, a motion sensors node and a touchpad node.
+class Ds4Gamepad : public UinputGamepad
+{
+public:
+	Ds4Gamepad(Callback notification)
+	  : UinputGamepad(notification, "Sony Interactive Entertainment Wireless Controller", 0x054C, 0x09CC)
+	  , _motion("Sony Interactive Entertainment Wireless Controller Motion Sensors", 0x054C, 0x09CC)
+	  , _touchpad("Sony Interactive Entertainment Wireless Controller Touchpad", 0x054C, 0x09CC)
+	{
+		_pad.enableKey(BTN_TL2);
+		_pad.enableKey(BTN_TR2);
+		createPad(0, UCHAR_MAX, 0, 0);
+		if (!_errorMsg.empty())
+			return;
+
+		_motion.enableProperty(INPUT_PROP_ACCELEROMETER);
+		_motion.enableAbs(ABS_X, -ACCEL_RANGE, ACCEL_RANGE, 16, 0, ACCEL_RES_PER_G);
+		_motion.enableAbs(ABS_Y, -ACCEL_RANGE, ACCEL_RANGE, 16, 0, ACCEL_RES_PER_G);
+		_motion.enableAbs(ABS_Z, -ACCEL_RANGE, ACCEL_RANGE, 16, 0, ACCEL_RES_PER_G);
+		_motion.enableAbs(ABS_RX, -GYRO_RANGE, GYRO_RANGE, 16, 0, GYRO_RES_PER_DEG_S);
+		_motion.enableAbs(ABS_RY, -GYRO_RANGE, GYRO_RANGE, 16, 0, GYRO_RES_PER_DEG_S);
+		_motion.enableAbs(ABS_RZ, -GYRO_RANGE, GYRO_RANGE, 16, 0, GYRO_RES_PER_DEG_S);
+		_motion.enable(EV_MSC, MSC_TIMESTAMP);
+		_errorMsg = _motion.create();
+		if (!_errorMsg.empty())
+			return;
+
+		_touchpad.enableProperty(INPUT_PROP_POINTER);
+		_touchpad.enableProperty(INPUT_PROP_BUTTONPAD);
+		_touchpad.enableKey(BTN_LEFT);
+		_touchpad.enableKey(BTN_TOUCH);
+		_touchpad.enableKey(BTN_TOOL_FINGER);
+		_touchpad.enableKey(BTN_TOOL_DOUBLETAP);
+		_touchpad.enableAbs(ABS_X, 0, TOUCH_WIDTH - 1);
+		_touchpad.enableAbs(ABS_Y, 0, TOUCH_HEIGHT - 1);
+		_touchpad.enableAbs(ABS_MT_SLOT, 0, 1);
+		_touchpad.enableAbs(ABS_MT_TRACKING_ID, 0, USHRT_MAX);
+		_touchpad.enableAbs(ABS_MT_POSITION_X, 0, TOUCH_WIDTH - 1);
+		_touchpad.enableAbs(ABS_MT_POSITION_Y, 0, TOUCH_HEIGHT - 1);
+		_errorMsg = _touchpad.create();
+	}
+
+	void setButton(KeyCode btn, bool pressed) override
+	{
+		if (btn.code == PS_PAD_CLICK)
+		{
+			_padClick = pressed;
+		}
+		else
+		{
+			UinputGamepad::setButton(btn, pressed);
+		}
+	}
+
+	void setGyro(TimePoint now, float accelX, float accelY, float accelZ, float gyroX, float gyroY, float gyroZ) override
+	{
+		if (!_firstTimeStamp)
+			_firstTimeStamp = now;
+		// MSC_TIMESTAMP is in microseconds and is expected to wrap around
+		auto diff_us = chrono::duration_cast<chrono::microseconds>(now - *_firstTimeStamp).count();
+		_motion.queue(EV_MSC, MSC_TIMESTAMP, int(uint32_t(diff_us)));
+
+		_motion.queue(EV_ABS, ABS_X, clamp(int(roundf(accelX * ACCEL_RES_PER_G)), -ACCEL_RANGE, ACCEL_RANGE));
+		_motion.queue(EV_ABS, ABS_Y, clamp(int(roundf(accelY * ACCEL_RES_PER_G)), -ACCEL_RANGE, ACCEL_RANGE));
+		_motion.queue(EV_ABS, ABS_Z, clamp(int(roundf(accelZ * ACCEL_RES_PER_G)), -ACCEL_RANGE, ACCEL_RANGE));
+		_motion.queue(EV_ABS, ABS_RX, clamp(int(roundf(gyroX * GYRO_RES_PER_DEG_S)), -GYRO_RANGE, GYRO_RANGE));
+		_motion.queue(EV_ABS, ABS_RY, clamp(int(roundf(gyroY * GYRO_RES_PER_DEG_S)), -GYRO_RANGE, GYRO_RANGE));
+		_motion.queue(EV_ABS, ABS_RZ, clamp(int(roundf(gyroZ * GYRO_RES_PER_DEG_S)), -GYRO_RANGE, GYRO_RANGE));
+	}
+
+	void setTouchState(optional<FloatXY> press1, optional<FloatXY> press2) override
+	{
+		_touches[0] = press1;
+		_touches[1] = press2;
+	}
+
+	ControllerScheme getType() const override
+	{
+		return ControllerScheme::DS4;
+	}
+
+protected:
+	const map<uint16_t, uint16_t> &buttonMap() const override
+	{
+		static const map<uint16_t, uint16_t> buttonMap{
+			{ PS_CROSS, BTN_SOUTH },
+			{ PS_CIRCLE, BTN_EAST },
+			{ PS_SQUARE, BTN_WEST },
+			{ PS_TRIANGLE, BTN_NORTH },
+			{ PS_L1, BTN_TL },
+			{ PS_R1, BTN_TR },
+			{ PS_SHARE, BTN_SELECT },
+			{ PS_OPTIONS, BTN_START },
+			{ PS_HOME, BTN_MODE },
+			{ PS_L3, BTN_THUMBL },
+			{ PS_R3, BTN_THUMBR },
+		};
+		return buttonMap;
+	}
+
+	void onUpdate() override
+	{
+		_pad.queue(EV_KEY, BTN_TL2, _leftTrigger > 0 ? 1 : 0);
+		_pad.queue(EV_KEY, BTN_TR2, _rightTrigger > 0 ? 1 : 0);
+		_motion.publish();
+
+		// The touchpad is a multitouch surface: every slot is rewritten, so the frame is only sent when touches change
+		if (_touches != _publishedTouches || _padClick != _publishedPadClick)
+		{
+			int fingers = 0;
+			for (int slot = 0; slot < 2; ++slot)
+			{
+				_touchpad.queue(EV_ABS, ABS_MT_SLOT, slot, true);
+				if (_touches[slot])
+				{
+					if (!_publishedTouches[slot])
+						_trackingIds[slot] = _nextTrackingId++ % (USHRT_MAX + 1);
+					int x = clamp(int(_touches[slot]->x() * TOUCH_WIDTH), 0, TOUCH_WIDTH - 1);
+					int y = clamp(int(_touches[slot]->y() * TOUCH_HEIGHT), 0, TOUCH_HEIGHT - 1);
+					_touchpad.queue(EV_ABS, ABS_MT_TRACKING_ID, _trackingIds[slot], true);
+					_touchpad.queue(EV_ABS, ABS_MT_POSITION_X, x, true);
+					_touchpad.queue(EV_ABS, ABS_MT_POSITION_Y, y, true);
+					if (fingers++ == 0)
+					{
+						_touchpad.queue(EV_ABS, ABS_X, x);
+						_touchpad.queue(EV_ABS, ABS_Y, y);
+					}
+				}
+				else
+				{
+					_touchpad.queue(EV_ABS, ABS_MT_TRACKING_ID, -1, true);
+				}
+			}
+			_touchpad.queue(EV_KEY, BTN_TOUCH, fingers > 0 ? 1 : 0);
+			_touchpad.queue(EV_KEY, BTN_TOOL_FINGER, fingers == 1 ? 1 : 0);
+			_touchpad.queue(EV_KEY, BTN_TOOL_DOUBLETAP, fingers == 2 ? 1 : 0);
+			_touchpad.queue(EV_KEY, BTN_LEFT, _padClick ? 1 : 0);
+			_touchpad.publish();
+			_publishedTouches = _touches;
+			_publishedPadClick = _padClick;
+		}
+	}
+
+private:
+	// Same scales as the hid-playstation kernel driver
+	static constexpr int ACCEL_RES_PER_G = 8192;
+	static constexpr int ACCEL_RANGE = 4 * ACCEL_RES_PER_G;
+	static constexpr int GYRO_RES_PER_DEG_S = 1024;
+	static constexpr int GYRO_RANGE = 2048 * GYRO_RES_PER_DEG_S;
+	static constexpr int TOUCH_WIDTH = 1920;
+	static constexpr int TOUCH_HEIGHT = 942;
+
+	UinputNode _motion;
+	UinputNode _touchpad;
+	optional<TimePoint> _firstTimeStamp;
+	array<optional<FloatXY>, 2> _touches;
+	array<optional<FloatXY>, 2> _publishedTouches;
+	array<int, 2> _trackingIds{};
+	int _nextTrackingId = 0;
+	bool _padClick = false;
+	bool _publishedPadClick = false;
+};
+
 Gamepad *Gamepad::getNew(ControllerScheme scheme, Callback notification)
 {
-	// return new GamepadImpl();
+	switch (scheme)
+	{
+	case ControllerScheme::XBOX:
+		return new XboxGamepad(notification);
+	case ControllerScheme::DS4:
+		return new Ds4Gamepad(notification);
+	}
 	return nullptr;
 }
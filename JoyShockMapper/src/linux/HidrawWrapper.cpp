@@ -0,0 +1,1413 @@
+#include "JslWrapper.h"
+#include "JSMVariable.hpp"
+#include "DualSenseEffects.h"
+#include "SettingsManager.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/hidraw.h>
+#include <linux/input.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+
+// Reads DualSense, DualShock 4 and Switch Pro controllers straight from /dev/hidraw*, without SDL.
+// One thread waits on all the devices with epoll, parses each input report as it arrives into the
+// state of its device and runs the mapping callbacks right away. Output reports are written with a
+// single write() each.
+//
+// For testing, JSM_HIDRAW_DEVICES="type:path;..." replaces the scan of /dev with stand-in files, where
+// type is ds4, ds or pro. A FIFO is only read, a pty is read and written. Since these are streams, each
+// report is preceded by its length as a 16 bit little endian number, in both directions.
+
+namespace
+{
+
+constexpr uint16_t VENDOR_SONY = 0x054C;
+constexpr uint16_t VENDOR_NINTENDO = 0x057E;
+
+constexpr size_t MAX_REPORT_SIZE = 128;
+
+// Touchpad resolutions reported by the controllers
+constexpr int DS4_TOUCHPAD_WIDTH = 1920;
+constexpr int DS4_TOUCHPAD_HEIGHT = 943;
+constexpr int DS_TOUCHPAD_WIDTH = 1920;
+constexpr int DS_TOUCHPAD_HEIGHT = 1080;
+
+// Nominal resolution of the sensors. The factory calibration of each controller is not read.
+constexpr float PS_GYRO_DPS_PER_UNIT = 1.f / 16.f;
+constexpr float PS_ACCEL_G_PER_UNIT = 1.f / 8192.f;
+constexpr float SWITCH_GYRO_DPS_PER_UNIT = 0.07f;
+constexpr float SWITCH_ACCEL_G_PER_UNIT = 1.f / 4096.f;
+
+// Switch controllers forget about rumble if it isn't sent again
+constexpr auto SWITCH_RUMBLE_REFRESH = chrono::milliseconds(50);
+
+int16_t readInt16(const uint8_t *data)
+{
+	return int16_t(data[0] | (data[1] << 8));
+}
+
+float psAxis(uint8_t value)
+{
+	return clamp((int(value) - 128) / 127.f, -1.f, 1.f);
+}
+
+// CRC32 that Sony controllers expect at the end of bluetooth reports
+uint32_t crc32(uint32_t crc, const uint8_t *data, size_t size)
+{
+	for (size_t i = 0; i < size; ++i)
+	{
+		crc ^= data[i];
+		for (int bit = 0; bit < 8; ++bit)
+		{
+			crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+		}
+	}
+	return crc;
+}
+
+void writeBluetoothCrc(uint8_t *report, size_t size)
+{
+	static constexpr uint8_t OUTPUT_SEED = 0xA2;
+	uint32_t crc = ~crc32(crc32(0xFFFFFFFFu, &OUTPUT_SEED, 1), report, size - 4);
+	report[size - 4] = uint8_t(crc);
+	report[size - 3] = uint8_t(crc >> 8);
+	report[size - 2] = uint8_t(crc >> 16);
+	report[size - 1] = uint8_t(crc >> 24);
+}
+
+// Amplitude of one band of the HD rumble, following the encoding documented by dekuNukem's Switch reverse engineering notes
+uint8_t encodeSwitchAmplitude(float amplitude)
+{
+	if (amplitude <= 0.f)
+		return 0;
+	float encoded;
+	if (amplitude > 0.23f)
+		encoded = log2f(amplitude * 8.7f) * 32.f;
+	else if (amplitude > 0.12f)
+		encoded = log2f(amplitude * 17.f) * 16.f;
+	else
+		encoded = (log2f(amplitude) * 32.f - 96.f) / (4.f - 2.f * amplitude);
+	return uint8_t(clamp(lroundf(encoded), 0l, 100l));
+}
+
+// Both bands of a motor: the high band at 320Hz plays the small rumble, the low band at 160Hz the big one
+void encodeSwitchRumble(uint8_t *out, uint16_t smallRumble, uint16_t bigRumble)
+{
+	static constexpr uint16_t HIGH_FREQUENCY = 0x0100; // 320Hz
+	static constexpr uint8_t LOW_FREQUENCY = 0x40;     // 160Hz
+	uint8_t highAmplitude = encodeSwitchAmplitude(smallRumble / 65535.f);
+	uint8_t lowAmplitude = encodeSwitchAmplitude(bigRumble / 65535.f);
+	uint16_t lowAmplitudeBits = (lowAmplitude >> 1) + 0x40 + ((lowAmplitude & 1) << 15);
+	out[0] = uint8_t(HIGH_FREQUENCY);
+	out[1] = uint8_t(highAmplitude * 2 + (HIGH_FREQUENCY >> 8));
+	out[2] = uint8_t(LOW_FREQUENCY + (lowAmplitudeBits >> 8));
+	out[3] = uint8_t(lowAmplitudeBits);
+}
+
+} // namespace
+
+struct HidrawDevice
+{
+	enum class Kind
+	{
+		DS4,
+		DS,
+		PRO,
+	};
+
+	// Describes a device found by the scan, before it is opened
+	struct Candidate
+	{
+		string path;
+		Kind kind;
+		bool standIn;
+	};
+
+	struct StickCalibration
+	{
+		int center[2];
+		float above[2];
+		float below[2];
+	};
+
+	HidrawDevice(const Candidate &candidate)
+	  : _path(candidate.path)
+	  , _kind(candidate.kind)
+	  , _standIn(candidate.standIn)
+	{
+		memset(&_imu, 0, sizeof(_imu));
+		memset(&_touch, 0, sizeof(_touch));
+		switch (_kind)
+		{
+		case Kind::DS4:
+			_ctrlr_type = JS_TYPE_DS4;
+			break;
+		case Kind::DS:
+			_ctrlr_type = JS_TYPE_DS;
+			break;
+		case Kind::PRO:
+			_ctrlr_type = JS_TYPE_PRO_CONTROLLER;
+			break;
+		}
+
+		if (_standIn)
+		{
+			openStandIn();
+		}
+		else
+		{
+			openHidraw();
+		}
+		if (_fd < 0)
+		{
+			CERR << "Cannot open " << _path << ": " << strerror(errno) << '\n';
+			return;
+		}
+
+		switch (_kind)
+		{
+		case Kind::DS4:
+		case Kind::DS:
+			if (_bluetooth && !_standIn)
+			{
+				// Reading the calibration switches the controller to the full reports, with motion and touch
+				uint8_t feature[64] = { uint8_t(_kind == Kind::DS4 ? 0x02 : 0x05) };
+				ioctl(_fd, HIDIOCGFEATURE(sizeof(feature)), feature);
+			}
+			break;
+		case Kind::PRO:
+			initSwitch();
+			break;
+		}
+	}
+
+	~HidrawDevice()
+	{
+		if (_fd >= 0)
+		{
+			_micLight = 0;
+			_leftTriggerEffect = AdaptiveTriggerSetting();
+			_rightTriggerEffect = AdaptiveTriggerSetting();
+			_small_rumble = 0;
+			_big_rumble = 0;
+			sendEffect();
+			close(_fd);
+		}
+	}
+
+	inline bool isValid()
+	{
+		return _fd >= 0;
+	}
+
+	void openHidraw()
+	{
+		_fd = open(_path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+		if (_fd < 0)
+			return;
+		_writable = true;
+
+		hidraw_devinfo info;
+		memset(&info, 0, sizeof(info));
+		if (ioctl(_fd, HIDIOCGRAWINFO, &info) == 0)
+		{
+			_bluetooth = info.bustype == BUS_BLUETOOTH;
+		}
+
+		// Same format as the SDL backend, so saved gyro calibrations work with both
+		char uniq[64] = {};
+#ifdef HIDIOCGRAWUNIQ
+		ioctl(_fd, HIDIOCGRAWUNIQ(sizeof(uniq)), uniq);
+#endif
+		char identity[128];
+		snprintf(identity, sizeof(identity), "%04x:%04x:%s", uint16_t(info.vendor), uint16_t(info.product), uniq);
+		_identity = identity;
+	}
+
+	void openStandIn()
+	{
+		struct stat status;
+		if (stat(_path.c_str(), &status) != 0)
+			return;
+		_framed = true;
+		if (S_ISFIFO(status.st_mode))
+		{
+			_fd = open(_path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+			return;
+		}
+		_fd = open(_path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC | O_NOCTTY);
+		if (_fd < 0)
+			return;
+		_writable = true;
+		termios mode;
+		if (tcgetattr(_fd, &mode) == 0)
+		{
+			// Don't let the line discipline touch the bytes
+			cfmakeraw(&mode);
+			tcsetattr(_fd, TCSANOW, &mode);
+		}
+	}
+
+	// Send one output report, in a single write
+	void writeReport(const uint8_t *report, size_t size)
+	{
+		if (_fd < 0 || !_writable)
+			return;
+		ssize_t written;
+		if (_framed)
+		{
+			uint8_t frame[MAX_REPORT_SIZE + 2] = { uint8_t(size), uint8_t(size >> 8) };
+			memcpy(frame + 2, report, size);
+			written = write(_fd, frame, size + 2);
+		}
+		else
+		{
+			written = write(_fd, report, size);
+		}
+		if (written < 0 && errno != EAGAIN)
+		{
+			DEBUG_LOG << "Cannot write to " << _path << ": " << strerror(errno) << '\n';
+		}
+	}
+
+	// Parse an input report into the state of the device. Returns false if the report has no input data.
+	bool parseReport(const uint8_t *report, size_t size)
+	{
+		switch (_kind)
+		{
+		case Kind::DS4:
+			if (report[0] == 0x01 && size >= 64)
+			{
+				_bluetooth = false;
+				parseDs4(report + 1);
+				return true;
+			}
+			if (report[0] == 0x11 && size >= 78)
+			{
+				_bluetooth = true;
+				parseDs4(report + 3);
+				return true;
+			}
+			return false;
+		case Kind::DS:
+			if (report[0] == 0x01 && size >= 64)
+			{
+				_bluetooth = false;
+				parseDs(report + 1);
+				return true;
+			}
+			if (report[0] == 0x31 && size >= 78)
+			{
+				_bluetooth = true;
+				parseDs(report + 2);
+				return true;
+			}
+			return false;
+		case Kind::PRO:
+			if (report[0] == 0x30 && size >= 49)
+			{
+				parseSwitch(report);
+				return true;
+			}
+			return false;
+		}
+		return false;
+	}
+
+	static int psDpad(uint8_t hat)
+	{
+		static constexpr int HAT_TO_DPAD[9] = {
+			JSMASK_UP,
+			JSMASK_UP | JSMASK_RIGHT,
+			JSMASK_RIGHT,
+			JSMASK_DOWN | JSMASK_RIGHT,
+			JSMASK_DOWN,
+			JSMASK_DOWN | JSMASK_LEFT,
+			JSMASK_LEFT,
+			JSMASK_UP | JSMASK_LEFT,
+			0,
+		};
+		return HAT_TO_DPAD[min(hat & 0x0F, 8)];
+	}
+
+	static int psFaceAndShoulders(uint8_t face, uint8_t shoulders)
+	{
+		int buttons = psDpad(face);
+		buttons |= face & 0x10 ? JSMASK_W : 0;
+		buttons |= face & 0x20 ? JSMASK_S : 0;
+		buttons |= face & 0x40 ? JSMASK_E : 0;
+		buttons |= face & 0x80 ? JSMASK_N : 0;
+		buttons |= shoulders & 0x01 ? JSMASK_L : 0;
+		buttons |= shoulders & 0x02 ? JSMASK_R : 0;
+		buttons |= shoulders & 0x10 ? JSMASK_SHARE : 0;
+		buttons |= shoulders & 0x20 ? JSMASK_OPTIONS : 0;
+		buttons |= shoulders & 0x40 ? JSMASK_LCLICK : 0;
+		buttons |= shoulders & 0x80 ? JSMASK_RCLICK : 0;
+		return buttons;
+	}
+
+	void parsePsTouch(const uint8_t *finger0, const uint8_t *finger1, float width, float height)
+	{
+		_touch.t0Id = finger0[0] & 0x7F;
+		_touch.t0Down = (finger0[0] & 0x80) == 0;
+		_touch.t0X = (finger0[1] | ((finger0[2] & 0x0F) << 8)) / width;
+		_touch.t0Y = ((finger0[2] >> 4) | (finger0[3] << 4)) / height;
+		_touch.t1Id = finger1[0] & 0x7F;
+		_touch.t1Down = (finger1[0] & 0x80) == 0;
+		_touch.t1X = (finger1[1] | ((finger1[2] & 0x0F) << 8)) / width;
+		_touch.t1Y = ((finger1[2] >> 4) | (finger1[3] << 4)) / height;
+	}
+
+	void addMotion(float gyroX, float gyroY, float gyroZ, float accelX, float accelY, float accelZ)
+	{
+		_gyroSum[0] += gyroX;
+		_gyroSum[1] += gyroY;
+		_gyroSum[2] += gyroZ;
+		++_gyroSamples;
+		_imu.gyroX = gyroX;
+		_imu.gyroY = gyroY;
+		_imu.gyroZ = gyroZ;
+		_imu.accelX = accelX;
+		_imu.accelY = accelY;
+		_imu.accelZ = accelZ;
+	}
+
+	void parseDs4(const uint8_t *data)
+	{
+		_stick[0] = psAxis(data[0]);
+		_stick[1] = -psAxis(data[1]);
+		_stick[2] = psAxis(data[2]);
+		_stick[3] = -psAxis(data[3]);
+		_buttons = psFaceAndShoulders(data[4], data[5]);
+		_buttons |= data[6] & 0x01 ? JSMASK_PS : 0;
+		_buttons |= data[6] & 0x02 ? JSMASK_TOUCHPAD_CLICK : 0;
+		_trigger[0] = data[7] / 255.f;
+		_trigger[1] = data[8] / 255.f;
+		addMotion(readInt16(data + 12) * PS_GYRO_DPS_PER_UNIT, readInt16(data + 14) * PS_GYRO_DPS_PER_UNIT, readInt16(data + 16) * PS_GYRO_DPS_PER_UNIT,
+		  readInt16(data + 18) * PS_ACCEL_G_PER_UNIT, readInt16(data + 20) * PS_ACCEL_G_PER_UNIT, readInt16(data + 22) * PS_ACCEL_G_PER_UNIT);
+		parsePsTouch(data + 34, data + 38, DS4_TOUCHPAD_WIDTH, DS4_TOUCHPAD_HEIGHT);
+	}
+
+	void parseDs(const uint8_t *data)
+	{
+		_stick[0] = psAxis(data[0]);
+		_stick[1] = -psAxis(data[1]);
+		_stick[2] = psAxis(data[2]);
+		_stick[3] = -psAxis(data[3]);
+		_trigger[0] = data[4] / 255.f;
+		_trigger[1] = data[5] / 255.f;
+		_buttons = psFaceAndShoulders(data[7], data[8]);
+		_buttons |= data[9] & 0x01 ? JSMASK_PS : 0;
+		_buttons |= data[9] & 0x02 ? JSMASK_TOUCHPAD_CLICK : 0;
+		_buttons |= data[9] & 0x04 ? JSMASK_MIC : 0;
+		// DualSense Edge
+		_buttons |= data[9] & 0x10 ? 1 << JSOFFSET_FNL : 0;
+		_buttons |= data[9] & 0x20 ? JSMASK_FNR : 0;
+		_buttons |= data[9] & 0x40 ? JSMASK_SL : 0;
+		_buttons |= data[9] & 0x80 ? JSMASK_SR : 0;
+		addMotion(readInt16(data + 15) * PS_GYRO_DPS_PER_UNIT, readInt16(data + 17) * PS_GYRO_DPS_PER_UNIT, readInt16(data + 19) * PS_GYRO_DPS_PER_UNIT,
+		  readInt16(data + 21) * PS_ACCEL_G_PER_UNIT, readInt16(data + 23) * PS_ACCEL_G_PER_UNIT, readInt16(data + 25) * PS_ACCEL_G_PER_UNIT);
+		parsePsTouch(data + 32, data + 36, DS_TOUCHPAD_WIDTH, DS_TOUCHPAD_HEIGHT);
+	}
+
+	float switchAxis(const StickCalibration &calibration, int axis, int value)
+	{
+		int offset = value - calibration.center[axis];
+		float range = offset > 0 ? calibration.above[axis] : calibration.below[axis];
+		return range > 0 ? clamp(offset / range, -1.f, 1.f) : 0.f;
+	}
+
+	void parseSwitch(const uint8_t *report)
+	{
+		uint8_t right = report[3], shared = report[4], left = report[5];
+		int buttons = 0;
+		buttons |= right & 0x01 ? JSMASK_W : 0;
+		buttons |= right & 0x02 ? JSMASK_N : 0;
+		buttons |= right & 0x04 ? JSMASK_S : 0;
+		buttons |= right & 0x08 ? JSMASK_E : 0;
+		buttons |= right & 0x40 ? JSMASK_R : 0;
+		buttons |= shared & 0x01 ? JSMASK_MINUS : 0;
+		buttons |= shared & 0x02 ? JSMASK_PLUS : 0;
+		buttons |= shared & 0x04 ? JSMASK_RCLICK : 0;
+		buttons |= shared & 0x08 ? JSMASK_LCLICK : 0;
+		buttons |= shared & 0x10 ? JSMASK_HOME : 0;
+		buttons |= shared & 0x20 ? JSMASK_CAPTURE : 0;
+		buttons |= left & 0x01 ? JSMASK_DOWN : 0;
+		buttons |= left & 0x02 ? JSMASK_UP : 0;
+		buttons |= left & 0x04 ? JSMASK_RIGHT : 0;
+		buttons |= left & 0x08 ? JSMASK_LEFT : 0;
+		buttons |= left & 0x40 ? JSMASK_L : 0;
+		_buttons = buttons;
+		_trigger[0] = left & 0x80 ? 1.f : 0.f;
+		_trigger[1] = right & 0x80 ? 1.f : 0.f;
+
+		const uint8_t *sticks = report + 6;
+		_stick[0] = switchAxis(_leftCalibration, 0, sticks[0] | ((sticks[1] & 0x0F) << 8));
+		_stick[1] = switchAxis(_leftCalibration, 1, (sticks[1] >> 4) | (sticks[2] << 4));
+		_stick[2] = switchAxis(_rightCalibration, 0, sticks[3] | ((sticks[4] & 0x0F) << 8));
+		_stick[3] = switchAxis(_rightCalibration, 1, (sticks[4] >> 4) | (sticks[5] << 4));
+
+		// The report holds 3 motion samples 5ms apart, the latest first. They are added from the oldest so that all of
+		// them count in the gyro average and the latest ends up as the current motion.
+		// The axes are turned into the ones SDL uses.
+		for (const uint8_t *imu = report + 13 + 2 * 12; imu >= report + 13; imu -= 12)
+		{
+			addMotion(-readInt16(imu + 8) * SWITCH_GYRO_DPS_PER_UNIT, readInt16(imu + 10) * SWITCH_GYRO_DPS_PER_UNIT, -readInt16(imu + 6) * SWITCH_GYRO_DPS_PER_UNIT,
+			  -readInt16(imu + 2) * SWITCH_ACCEL_G_PER_UNIT, readInt16(imu + 4) * SWITCH_ACCEL_G_PER_UNIT, -readInt16(imu + 0) * SWITCH_ACCEL_G_PER_UNIT);
+		}
+	}
+
+	// Wait for a report that matches, up to the timeout. Only used while opening the device, before it is watched by epoll.
+	template<typename Predicate>
+	bool waitForReport(Predicate matches, int timeoutMs = 100)
+	{
+		auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+		uint8_t report[MAX_REPORT_SIZE];
+		for (auto now = chrono::steady_clock::now(); now < deadline; now = chrono::steady_clock::now())
+		{
+			pollfd wait = { _fd, POLLIN, 0 };
+			if (poll(&wait, 1, int(chrono::duration_cast<chrono::milliseconds>(deadline - now).count()) + 1) <= 0)
+				return false;
+			ssize_t size = read(_fd, report, sizeof(report));
+			if (size > 0 && matches(report, size_t(size)))
+				return true;
+		}
+		return false;
+	}
+
+	size_t switchReportSize() const
+	{
+		return _bluetooth ? 49 : 64;
+	}
+
+	void sendSwitchSubcommand(uint8_t subcommand, const uint8_t *args, size_t argCount, uint8_t *reply = nullptr, size_t replySize = 0)
+	{
+		uint8_t report[64] = { 0x01, uint8_t(_packetCounter++ & 0x0F) };
+		encodeSwitchRumble(report + 2, _small_rumble, _big_rumble);
+		encodeSwitchRumble(report + 6, _small_rumble, _big_rumble);
+		report[10] = subcommand;
+		memcpy(report + 11, args, min(argCount, sizeof(report) - 11));
+		writeReport(report, switchReportSize());
+		if (!_standIn)
+		{
+			waitForReport([&](const uint8_t *data, size_t size)
+			  {
+				  if (size < 15 || data[0] != 0x21 || data[14] != subcommand)
+					  return false;
+				  if (reply)
+					  memcpy(reply, data, min(size, replySize));
+				  return true;
+			  });
+		}
+	}
+
+	void initSwitch()
+	{
+		if (!_bluetooth && !_standIn)
+		{
+			// Handshake, faster baud rate, handshake again, then keep talking over USB instead of bluetooth
+			for (uint8_t command : { 0x02, 0x03, 0x02, 0x04 })
+			{
+				uint8_t report[64] = { 0x80, command };
+				writeReport(report, sizeof(report));
+				if (command != 0x04)
+				{
+					waitForReport([command](const uint8_t *data, size_t size)
+					  { return size >= 2 && data[0] == 0x81 && data[1] == command; });
+				}
+			}
+		}
+
+		uint8_t fullReports = 0x30, enable = 0x01;
+		sendSwitchSubcommand(0x03, &fullReports, 1);
+		sendSwitchSubcommand(0x40, &enable, 1);
+		sendSwitchSubcommand(0x48, &enable, 1);
+
+		// Factory stick calibration: 9 bytes for each stick at 0x603D in the SPI flash
+		uint8_t readCalibration[5] = { 0x3D, 0x60, 0x00, 0x00, 18 };
+		uint8_t reply[MAX_REPORT_SIZE] = {};
+		sendSwitchSubcommand(0x10, readCalibration, sizeof(readCalibration), reply, sizeof(reply));
+		if (reply[0] == 0x21 && reply[14] == 0x10 && reply[15] == 0x3D && reply[16] == 0x60)
+		{
+			auto decode = [](const uint8_t *data, int values[6])
+			{
+				for (int i = 0; i < 3; ++i)
+				{
+					values[2 * i] = data[3 * i] | ((data[3 * i + 1] & 0x0F) << 8);
+					values[2 * i + 1] = (data[3 * i + 1] >> 4) | (data[3 * i + 2] << 4);
+				}
+			};
+			int left[6], right[6];
+			decode(reply + 20, left);
+			decode(reply + 29, right);
+			// The left stick stores above, center, below. The right stick stores center, below, above.
+			_leftCalibration = { { left[2], left[3] }, { float(left[0]), float(left[1]) }, { float(left[4]), float(left[5]) } };
+			_rightCalibration = { { right[0], right[1] }, { float(right[4]), float(right[5]) }, { float(right[2]), float(right[3]) } };
+		}
+		setPlayerLights(1);
+	}
+
+	void setPlayerLights(int number)
+	{
+		static constexpr uint8_t SWITCH_PLAYER_LIGHTS[] = { 0x00, 0x01, 0x03, 0x07, 0x0F };
+		static constexpr uint8_t DS_PLAYER_LIGHTS[] = { 0x00, 0x04, 0x0A, 0x15, 0x1B, 0x1F };
+		if (_kind == Kind::PRO)
+		{
+			uint8_t lights = number >= 0 && size_t(number) < size(SWITCH_PLAYER_LIGHTS) ? SWITCH_PLAYER_LIGHTS[number] : 0;
+			sendSwitchSubcommand(0x30, &lights, 1);
+		}
+		else if (_kind == Kind::DS)
+		{
+			_padLights = number >= 0 && size_t(number) < size(DS_PLAYER_LIGHTS) ? DS_PLAYER_LIGHTS[number] : 0;
+			sendEffect();
+		}
+	}
+
+	// Write rumble, lights and trigger effects in one output report
+	void sendEffect()
+	{
+		switch (_kind)
+		{
+		case Kind::DS4:
+		{
+			uint8_t report[78] = {};
+			uint8_t *effects;
+			size_t size;
+			if (_bluetooth)
+			{
+				report[0] = 0x11;
+				report[1] = 0xC0 | _ds4ReportInterval; // The low bits set the milliseconds between input reports
+				report[3] = 0x03;
+				effects = report + 6;
+				size = 78;
+			}
+			else
+			{
+				report[0] = 0x05;
+				report[1] = 0x07;
+				effects = report + 4;
+				size = 32;
+			}
+			effects[0] = _small_rumble >> 8;
+			effects[1] = _big_rumble >> 8;
+			effects[2] = _lightRed;
+			effects[3] = _lightGreen;
+			effects[4] = _lightBlue;
+			if (_bluetooth)
+				writeBluetoothCrc(report, size);
+			writeReport(report, size);
+		}
+		break;
+		case Kind::DS:
+		{
+			uint8_t report[78] = {};
+			DS5EffectsState_t effectPacket;
+			memset(&effectPacket, 0, sizeof(effectPacket));
+
+			effectPacket.ucEnableBits1 |= 0x08 | 0x04; // Enable left and right trigger effect respectively
+			LoadTriggerEffect(effectPacket.rgucLeftTriggerEffect, &_leftTriggerEffect);
+			LoadTriggerEffect(effectPacket.rgucRightTriggerEffect, &_rightTriggerEffect);
+
+			effectPacket.ucEnableBits1 |= 0x01 | 0x02;
+			effectPacket.ucRumbleLeft = _big_rumble >> 8;
+			effectPacket.ucRumbleRight = _small_rumble >> 8;
+
+			effectPacket.ucEnableBits2 |= 0x01;      /* Enable microphone light */
+			effectPacket.ucMicLightMode = _micLight; /* Bitmask, 0x00 = off, 0x01 = solid, 0x02 = pulse */
+
+			effectPacket.ucEnableBits2 |= 0x04 | 0x10; /* Enable lightbar and player lights */
+			effectPacket.ucLedRed = _lightRed;
+			effectPacket.ucLedGreen = _lightGreen;
+			effectPacket.ucLedBlue = _lightBlue;
+			effectPacket.ucPadLights = _padLights;
+
+			if (_bluetooth)
+			{
+				report[0] = 0x31;
+				report[1] = 0x02;
+				memcpy(report + 2, &effectPacket, sizeof(effectPacket));
+				writeBluetoothCrc(report, 78);
+				writeReport(report, 78);
+			}
+			else
+			{
+				report[0] = 0x02;
+				memcpy(report + 1, &effectPacket, sizeof(effectPacket));
+				writeReport(report, 1 + sizeof(effectPacket));
+			}
+		}
+		break;
+		case Kind::PRO:
+		{
+			uint8_t report[64] = { 0x10, uint8_t(_packetCounter++ & 0x0F) };
+			encodeSwitchRumble(report + 2, _small_rumble, _big_rumble);
+			encodeSwitchRumble(report + 6, _small_rumble, _big_rumble);
+			writeReport(report, switchReportSize());
+			_lastRumble = chrono::steady_clock::now();
+		}
+		break;
+		}
+	}
+
+	// Called after each input report
+	void refreshRumble(chrono::steady_clock::time_point now)
+	{
+		if (_kind == Kind::PRO && (_small_rumble != 0 || _big_rumble != 0) && now - _lastRumble >= SWITCH_RUMBLE_REFRESH)
+		{
+			sendEffect();
+		}
+	}
+
+	// Snapshot the input when the mapping comes to rest, to notice when it changes
+	void setIdle(bool idle)
+	{
+		_idle = idle;
+		if (!idle)
+			return;
+		_idleButtons = _buttons;
+		copy(begin(_stick), end(_stick), _idleStick);
+		copy(begin(_trigger), end(_trigger), _idleTrigger);
+		float gyro[3] = { _imu.gyroX, _imu.gyroY, _imu.gyroZ };
+		for (int i = 0; i < 3; ++i)
+		{
+			_idleGyro[i] = _gyroSamples > 0 ? _gyroSum[i] / _gyroSamples : gyro[i];
+		}
+	}
+
+	// True if the input moved away from the snapshot taken when the device came to rest
+	bool leftRest() const
+	{
+		static constexpr float AXIS_TOLERANCE = 0.05f;
+		static constexpr float GYRO_TOLERANCE = 5.f; // Degrees per second, above the noise of a still controller
+		if (_buttons != _idleButtons || _touch.t0Down || _touch.t1Down)
+			return true;
+		for (int i = 0; i < 4; ++i)
+		{
+			if (abs(_stick[i] - _idleStick[i]) > AXIS_TOLERANCE)
+				return true;
+		}
+		for (int i = 0; i < 2; ++i)
+		{
+			if (abs(_trigger[i] - _idleTrigger[i]) > AXIS_TOLERANCE)
+				return true;
+		}
+		return abs(_imu.gyroX - _idleGyro[0]) > GYRO_TOLERANCE || abs(_imu.gyroY - _idleGyro[1]) > GYRO_TOLERANCE ||
+		  abs(_imu.gyroZ - _idleGyro[2]) > GYRO_TOLERANCE;
+	}
+
+	string _path;
+	Kind _kind;
+	bool _standIn;
+	int _fd = -1;
+	bool _writable = false;
+	bool _framed = false;
+	bool _bluetooth = false;
+	int _split_type = JS_SPLIT_TYPE_FULL;
+	int _ctrlr_type = 0;
+	string _identity;
+
+	// Input state, written by the reader thread as reports arrive
+	int _buttons = 0;
+	float _stick[4] = { 0.f, 0.f, 0.f, 0.f };
+	float _trigger[2] = { 0.f, 0.f };
+	IMU_STATE _imu;
+	float _gyroSum[3] = { 0.f, 0.f, 0.f }; // Gyro of the reports since the last callback
+	int _gyroSamples = 0;
+	TOUCH_STATE _touch;
+	// Input when the mapping last said the device was at rest. See JslWrapper::SetIdle().
+	bool _idle = false;
+	int _idleButtons = 0;
+	float _idleStick[4] = { 0.f, 0.f, 0.f, 0.f };
+	float _idleTrigger[2] = { 0.f, 0.f };
+	float _idleGyro[3] = { 0.f, 0.f, 0.f };
+	StickCalibration _leftCalibration = { { 2048, 2048 }, { 1500.f, 1500.f }, { 1500.f, 1500.f } };
+	StickCalibration _rightCalibration = { { 2048, 2048 }, { 1500.f, 1500.f }, { 1500.f, 1500.f } };
+
+	// Stand-ins deliver reports as a stream
+	uint8_t _stream[MAX_REPORT_SIZE * 8];
+	size_t _streamSize = 0;
+
+	// Output state
+	uint16_t _small_rumble = 0;
+	uint16_t _big_rumble = 0;
+	AdaptiveTriggerSetting _leftTriggerEffect;
+	AdaptiveTriggerSetting _rightTriggerEffect;
+	uint8_t _micLight = 0;
+	uint8_t _lightRed = 0;
+	uint8_t _lightGreen = 0;
+	uint8_t _lightBlue = 0;
+	uint8_t _padLights = 0;
+	uint8_t _packetCounter = 0;
+	uint8_t _ds4ReportInterval = 4;
+	chrono::steady_clock::time_point _lastRumble;
+
+	float _reportInterval = 0.f; // Milliseconds between reports from the device, measured
+	chrono::steady_clock::time_point _lastReport;
+	chrono::steady_clock::time_point _lastTick;
+};
+
+struct HidrawInstance : public JslWrapper
+{
+public:
+	HidrawInstance()
+	{
+		_epoll = epoll_create1(EPOLL_CLOEXEC);
+		// New hidraw nodes appear in /dev, and get their permissions from udev a bit later
+		_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (_inotify >= 0 && inotify_add_watch(_inotify, "/dev", IN_CREATE | IN_DELETE | IN_ATTRIB) >= 0)
+		{
+			epoll_event event;
+			event.events = EPOLLIN;
+			event.data.u32 = INOTIFY_TAG;
+			epoll_ctl(_epoll, EPOLL_CTL_ADD, _inotify, &event);
+		}
+	}
+
+	virtual ~HidrawInstance()
+	{
+		DisconnectAndDisposeAll();
+		if (_inotify >= 0)
+			close(_inotify);
+		if (_epoll >= 0)
+			close(_epoll);
+	}
+
+	static bool identify(uint16_t vendor, uint16_t product, HidrawDevice::Kind &kind)
+	{
+		if (vendor == VENDOR_SONY)
+		{
+			switch (product)
+			{
+			case 0x05C4: // DualShock 4
+			case 0x09CC: // DualShock 4 v2
+			case 0x0BA0: // DualShock 4 wireless adapter
+				kind = HidrawDevice::Kind::DS4;
+				return true;
+			case 0x0CE6: // DualSense
+			case 0x0DF2: // DualSense Edge
+				kind = HidrawDevice::Kind::DS;
+				return true;
+			}
+		}
+		else if (vendor == VENDOR_NINTENDO && product == 0x2009)
+		{
+			kind = HidrawDevice::Kind::PRO;
+			return true;
+		}
+		return false;
+	}
+
+	// Find the supported controllers, sorted by path so handles stay in the same order
+	vector<HidrawDevice::Candidate> scan()
+	{
+		vector<HidrawDevice::Candidate> found;
+		if (const char *standIns = getenv("JSM_HIDRAW_DEVICES"))
+		{
+			static const map<string, HidrawDevice::Kind> KINDS = {
+				{ "ds4", HidrawDevice::Kind::DS4 },
+				{ "ds", HidrawDevice::Kind::DS },
+				{ "pro", HidrawDevice::Kind::PRO },
+			};
+			string_view list = standIns;
+			while (!list.empty())
+			{
+				auto end = list.find(';');
+				string_view entry = list.substr(0, end);
+				list = end == string_view::npos ? string_view() : list.substr(end + 1);
+				auto colon = entry.find(':');
+				auto kind = colon == string_view::npos ? KINDS.end() : KINDS.find(string(entry.substr(0, colon)));
+				if (kind == KINDS.end())
+				{
+					if (!entry.empty())
+						CERR << "JSM_HIDRAW_DEVICES: expected type:path, with type ds4, ds or pro, but got " << entry << '\n';
+					continue;
+				}
+				found.push_back({ string(entry.substr(colon + 1)), kind->second, true });
+			}
+			return found;
+		}
+
+		DIR *dev = opendir("/dev");
+		if (!dev)
+			return found;
+		while (dirent *entry = readdir(dev))
+		{
+			if (strncmp(entry->d_name, "hidraw", 6) != 0)
+				continue;
+			string path = string("/dev/") + entry->d_name;
+			int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+			if (fd < 0)
+			{
+				if (errno == EACCES && _warnedPaths.insert(path).second)
+				{
+					CERR << "No permission to read " << path << ". See the README for the udev rule that gives access to the controllers.\n";
+				}
+				continue;
+			}
+			hidraw_devinfo info;
+			HidrawDevice::Kind kind;
+			if (ioctl(fd, HIDIOCGRAWINFO, &info) == 0 && identify(uint16_t(info.vendor), uint16_t(info.product), kind))
+			{
+				found.push_back({ path, kind, false });
+			}
+			close(fd);
+		}
+		closedir(dev);
+		sort(found.begin(), found.end(), [](auto &lhs, auto &rhs)
+		  { return lhs.path.size() != rhs.path.size() ? lhs.path.size() < rhs.path.size() : lhs.path < rhs.path; });
+		return found;
+	}
+
+	// Update the state of the device from one input report and run the callbacks if it is time for a tick
+	void onReport(int handle, HidrawDevice &device, const uint8_t *report, size_t size, float tickTime, bool deviceTickTime, float idleTickTime)
+	{
+		if (!device.parseReport(report, size))
+			return;
+
+		auto now = chrono::steady_clock::now();
+		if (device._lastReport != chrono::steady_clock::time_point())
+		{
+			float interval = min(chrono::duration<float, milli>(now - device._lastReport).count(), 100.f);
+			device._reportInterval = device._reportInterval == 0.f ? interval : device._reportInterval + (interval - device._reportInterval) * 0.05f;
+		}
+		device._lastReport = now;
+		device.refreshRumble(now);
+
+		float elapsed = device._lastTick == chrono::steady_clock::time_point() ? max(device._reportInterval, 1.f) : chrono::duration<float, milli>(now - device._lastTick).count();
+		// Unless each report is a tick, reports closer than the tick time are merged into the next tick
+		if (!deviceTickTime && elapsed + device._reportInterval * 0.5f < tickTime)
+			return;
+		// A device at rest waits for the idle tick time, unless its input changed. Its gyro is averaged meanwhile.
+		if (device._idle && idleTickTime > 0.f && elapsed < idleTickTime && !device.leftRest())
+			return;
+		device._lastTick = now;
+
+		if (g_callback)
+		{
+			JOY_SHOCK_STATE dummy1;
+			IMU_STATE dummy2;
+			memset(&dummy1, 0, sizeof(dummy1));
+			memset(&dummy2, 0, sizeof(dummy2));
+			g_callback(handle, dummy1, dummy1, dummy2, dummy2, elapsed);
+		}
+		device._gyroSum[0] = device._gyroSum[1] = device._gyroSum[2] = 0.f;
+		device._gyroSamples = 0;
+	}
+
+	// Read everything the device has to say. Returns false if the device is gone.
+	bool readDevice(int handle, HidrawDevice &device, float tickTime, bool deviceTickTime, float idleTickTime)
+	{
+		while (true)
+		{
+			ssize_t size;
+			if (device._framed)
+			{
+				size = read(device._fd, device._stream + device._streamSize, sizeof(device._stream) - device._streamSize);
+				if (size > 0)
+				{
+					device._streamSize += size;
+					size_t start = 0;
+					while (device._streamSize - start >= 2)
+					{
+						size_t length = device._stream[start] | (device._stream[start + 1] << 8);
+						if (length == 0 || length > MAX_REPORT_SIZE)
+						{
+							CERR << "Dropping the unframed data of " << device._path << '\n';
+							start = device._streamSize;
+							break;
+						}
+						if (device._streamSize - start < 2 + length)
+							break;
+						onReport(handle, device, device._stream + start + 2, length, tickTime, deviceTickTime, idleTickTime);
+						start += 2 + length;
+					}
+					device._streamSize -= start;
+					memmove(device._stream, device._stream + start, device._streamSize);
+					continue;
+				}
+			}
+			else
+			{
+				uint8_t report[MAX_REPORT_SIZE];
+				size = read(device._fd, report, sizeof(report));
+				if (size > 0)
+				{
+					onReport(handle, device, report, size_t(size), tickTime, deviceTickTime, idleTickTime);
+					continue;
+				}
+			}
+			// Reading nothing means the device is unplugged, or that the stand-in was closed by its writer
+			return size < 0 && (errno == EAGAIN || errno == EINTR);
+		}
+	}
+
+	int pollDevices()
+	{
+		epoll_event events[16];
+		while (keep_polling)
+		{
+			int count = epoll_wait(_epoll, events, 16, 100);
+			if (count <= 0)
+				continue;
+
+			auto tick_time = SettingsManager::get<float>(SettingID::TICK_TIME)->value();
+			bool deviceTickTime = SettingsManager::get<Switch>(SettingID::DEVICE_TICK_TIME)->value() == Switch::ON;
+			auto idleTickTime = SettingsManager::get<float>(SettingID::IDLE_TICK_TIME)->value();
+			lock_guard guard(controller_lock);
+			applyReportInterval();
+			bool changed = false;
+			for (int i = 0; i < count; ++i)
+			{
+				if (events[i].data.u32 == INOTIFY_TAG)
+				{
+					changed |= checkHotplugEvents();
+					continue;
+				}
+				int handle = int(events[i].data.u32);
+				auto found = _controllerMap.find(handle);
+				if (found == _controllerMap.end() || found->second->_fd < 0)
+					continue;
+				HidrawDevice &device = *found->second;
+				if (!readDevice(handle, device, tick_time, deviceTickTime, idleTickTime) || (events[i].events & EPOLLERR) != 0)
+				{
+					// Unplugged. The device object stays around until the next connection, so getters still work.
+					epoll_ctl(_epoll, EPOLL_CTL_DEL, device._fd, nullptr);
+					close(device._fd);
+					device._fd = -1;
+					changed = true;
+				}
+			}
+			if (changed)
+			{
+				_deviceCount = int(scan().size());
+				lock_guard hotplugGuard(_hotplugMutex);
+				++_hotplugSerial;
+				_hotplugCV.notify_all();
+			}
+		}
+		return 1;
+	}
+
+	// Called with controller_lock held. DualShock 4 controllers take the report interval from each output report over bluetooth.
+	void applyReportInterval()
+	{
+		auto interval = uint8_t(SettingsManager::get<float>(SettingID::DS4_REPORT_INTERVAL)->value());
+		if (interval == _ds4ReportInterval)
+			return;
+		_ds4ReportInterval = interval;
+		for (auto &[handle, device] : _controllerMap)
+		{
+			device->_ds4ReportInterval = interval;
+			if (device->_kind == HidrawDevice::Kind::DS4 && device->_bluetooth)
+			{
+				device->sendEffect();
+			}
+		}
+	}
+
+	// Called with controller_lock held. Returns true if a hidraw node was added, removed or changed permissions.
+	bool checkHotplugEvents()
+	{
+		alignas(inotify_event) char buffer[4096];
+		bool changed = false;
+		for (ssize_t size = read(_inotify, buffer, sizeof(buffer)); size > 0; size = read(_inotify, buffer, sizeof(buffer)))
+		{
+			for (char *next = buffer; next < buffer + size;)
+			{
+				auto *event = reinterpret_cast<inotify_event *>(next);
+				changed |= event->len > 0 && strncmp(event->name, "hidraw", 6) == 0;
+				next += sizeof(inotify_event) + event->len;
+			}
+		}
+		return changed;
+	}
+
+	static constexpr uint32_t INOTIFY_TAG = 0;
+
+	int _epoll = -1;
+	int _inotify = -1;
+	uint8_t _ds4ReportInterval = 4;
+	thread _pollingThread;
+	vector<HidrawDevice::Candidate> _candidates;
+	set<string> _warnedPaths;
+	atomic_int _deviceCount = 0;
+	mutex _hotplugMutex;
+	condition_variable _hotplugCV;
+	uint64_t _hotplugSerial = 0;
+	uint64_t _lastSeenHotplugSerial = 0;
+	map<int, HidrawDevice *> _controllerMap;
+	void (*g_callback)(int, JOY_SHOCK_STATE, JOY_SHOCK_STATE, IMU_STATE, IMU_STATE, float) = nullptr;
+	atomic_bool keep_polling = false;
+	mutex controller_lock;
+
+	int ConnectDevices() override
+	{
+		bool isFalse = false;
+		if (keep_polling.compare_exchange_strong(isFalse, true))
+		{
+			_pollingThread = thread(&HidrawInstance::pollDevices, this);
+		}
+		lock_guard guard(controller_lock);
+		applyReportInterval();
+		_candidates = scan();
+		_deviceCount = int(_candidates.size());
+		return _deviceCount;
+	}
+
+	int GetDeviceCount() override
+	{
+		if (keep_polling)
+		{
+			// Kept up to date by the polling thread from the changes in /dev
+			return _deviceCount;
+		}
+		lock_guard guard(controller_lock);
+		_deviceCount = int(scan().size());
+		return _deviceCount;
+	}
+
+	bool WaitForDeviceChange(unsigned int timeoutMs) override
+	{
+		unique_lock lock(_hotplugMutex);
+		bool changed = _hotplugCV.wait_for(lock, chrono::milliseconds(timeoutMs), [this]
+		  { return _hotplugSerial != _lastSeenHotplugSerial; });
+		_lastSeenHotplugSerial = _hotplugSerial;
+		return changed || !keep_polling;
+	}
+
+	void disposeDevices()
+	{
+		auto iter = _controllerMap.begin();
+		while (iter != _controllerMap.end())
+		{
+			if (iter->second->_fd >= 0)
+				epoll_ctl(_epoll, EPOLL_CTL_DEL, iter->second->_fd, nullptr);
+			delete iter->second;
+			iter = _controllerMap.erase(iter);
+		}
+	}
+
+	int GetConnectedDeviceHandles(int *deviceHandleArray, int size) override
+	{
+		lock_guard guard(controller_lock);
+		disposeDevices();
+		for (int i = 0; i < size; i++)
+		{
+			HidrawDevice *device = i < int(_candidates.size()) ? new HidrawDevice(_candidates[i]) : nullptr;
+			if (device && device->isValid())
+			{
+				device->_ds4ReportInterval = _ds4ReportInterval;
+				deviceHandleArray[i] = i + 1;
+				_controllerMap[deviceHandleArray[i]] = device;
+				epoll_event event;
+				event.events = EPOLLIN;
+				event.data.u32 = uint32_t(deviceHandleArray[i]);
+				epoll_ctl(_epoll, EPOLL_CTL_ADD, device->_fd, &event);
+			}
+			else
+			{
+				deviceHandleArray[i] = -1;
+				delete device;
+			}
+		}
+		return int(_controllerMap.size());
+	}
+
+	void DisconnectAndDisposeAll() override
+	{
+		keep_polling = false;
+		if (_pollingThread.joinable())
+		{
+			_pollingThread.join();
+		}
+		lock_guard guard(controller_lock);
+		g_callback = nullptr;
+		disposeDevices();
+		_candidates.clear();
+	}
+
+	JOY_SHOCK_STATE GetSimpleState(int deviceId) override
+	{
+		return JOY_SHOCK_STATE();
+	}
+
+	IMU_STATE GetIMUState(int deviceId) override
+	{
+		HidrawDevice *device = _controllerMap[deviceId];
+		IMU_STATE imuState = device->_imu;
+		if (device->_gyroSamples > 1)
+		{
+			// Reports merged into one tick: their average keeps the whole rotation
+			imuState.gyroX = device->_gyroSum[0] / device->_gyroSamples;
+			imuState.gyroY = device->_gyroSum[1] / device->_gyroSamples;
+			imuState.gyroZ = device->_gyroSum[2] / device->_gyroSamples;
+		}
+		return imuState;
+	}
+
+	MOTION_STATE GetMotionState(int deviceId) override
+	{
+		return MOTION_STATE();
+	}
+
+	TOUCH_STATE GetTouchState(int deviceId) override
+	{
+		return _controllerMap[deviceId]->_touch;
+	}
+
+	bool GetTouchpadDimension(int deviceId, int &sizeX, int &sizeY) override
+	{
+		auto *jc = _controllerMap[deviceId];
+		if (jc != nullptr)
+		{
+			switch (jc->_kind)
+			{
+			case HidrawDevice::Kind::DS4:
+				sizeX = DS4_TOUCHPAD_WIDTH;
+				sizeY = DS4_TOUCHPAD_HEIGHT;
+				break;
+			case HidrawDevice::Kind::DS:
+				sizeX = DS_TOUCHPAD_WIDTH;
+				sizeY = DS_TOUCHPAD_HEIGHT;
+				break;
+			default:
+				sizeX = 0;
+				sizeY = 0;
+				break;
+			}
+			return true;
+		}
+		return false;
+	}
+
+	int GetButtons(int deviceId) override
+	{
+		return _controllerMap[deviceId]->_buttons;
+	}
+
+	float GetLeftX(int deviceId) override
+	{
+		return _controllerMap[deviceId]->_stick[0];
+	}
+
+	float GetLeftY(int deviceId) override
+	{
+		return _controllerMap[deviceId]->_stick[1];
+	}
+
+	float GetRightX(int deviceId) override
+	{
+		return _controllerMap[deviceId]->_stick[2];
+	}
+
+	float GetRightY(int deviceId) override
+	{
+		return _controllerMap[deviceId]->_stick[3];
+	}
+
+	float GetLeftTrigger(int deviceId) override
+	{
+		return _controllerMap[deviceId]->_trigger[0];
+	}
+
+	float GetRightTrigger(int deviceId) override
+	{
+		return _controllerMap[deviceId]->_trigger[1];
+	}
+
+	float GetGyroX(int deviceId) override
+	{
+		return _controllerMap[deviceId]->_imu.gyroX;
+	}
+
+	float GetGyroY(int deviceId) override
+	{
+		return _controllerMap[deviceId]->_imu.gyroY;
+	}
+
+	float GetGyroZ(int deviceId) override
+	{
+		return _controllerMap[deviceId]->_imu.gyroZ;
+	}
+
+	float GetAccelX(int deviceId) override
+	{
+		return _controllerMap[deviceId]->_imu.accelX;
+	}
+
+	float GetAccelY(int deviceId) override
+	{
+		return _controllerMap[deviceId]->_imu.accelY;
+	}
+
+	float GetAccelZ(int deviceId) override
+	{
+		return _controllerMap[deviceId]->_imu.accelZ;
+	}
+
+	int GetTouchId(int deviceId, bool secondTouch = false) override
+	{
+		return secondTouch ? _controllerMap[deviceId]->_touch.t1Id : _controllerMap[deviceId]->_touch.t0Id;
+	}
+
+	bool GetTouchDown(int deviceId, bool secondTouch = false) override
+	{
+		return secondTouch ? _controllerMap[deviceId]->_touch.t1Down : _controllerMap[deviceId]->_touch.t0Down;
+	}
+
+	float GetTouchX(int deviceId, bool secondTouch = false) override
+	{
+		return secondTouch ? _controllerMap[deviceId]->_touch.t1X : _controllerMap[deviceId]->_touch.t0X;
+	}
+
+	float GetTouchY(int deviceId, bool secondTouch = false) override
+	{
+		return secondTouch ? _controllerMap[deviceId]->_touch.t1Y : _controllerMap[deviceId]->_touch.t0Y;
+	}
+
+	float GetStickStep(int deviceId) override
+	{
+		return _controllerMap[deviceId]->_kind == HidrawDevice::Kind::PRO ? 1.f / 2048.f : 1.f / 128.f;
+	}
+
+	float GetTriggerStep(int deviceId) override
+	{
+		return _controllerMap[deviceId]->_kind == HidrawDevice::Kind::PRO ? 1.f : 1.f / 255.f;
+	}
+
+	float GetPollRate(int deviceId) override
+	{
+		float interval = _controllerMap[deviceId]->_reportInterval;
+		return interval > 0.f ? 1000.f / interval : float();
+	}
+
+	void ResetContinuousCalibration(int deviceId) override
+	{
+	}
+
+	void StartContinuousCalibration(int deviceId) override
+	{
+	}
+
+	void PauseContinuousCalibration(int deviceId) override
+	{
+	}
+
+	void GetCalibrationOffset(int deviceId, float &xOffset, float &yOffset, float &zOffset) override
+	{
+	}
+
+	void SetCalibrationOffset(int deviceId, float xOffset, float yOffset, float zOffset) override
+	{
+	}
+
+	void SetCallback(void (*callback)(int, JOY_SHOCK_STATE, JOY_SHOCK_STATE, IMU_STATE, IMU_STATE, float)) override
+	{
+		lock_guard guard(controller_lock);
+		g_callback = callback;
+	}
+
+	int GetControllerType(int deviceId) override
+	{
+		return _controllerMap[deviceId]->_ctrlr_type;
+	}
+
+	int GetControllerSplitType(int deviceId) override
+	{
+		return _controllerMap[deviceId]->_split_type;
+	}
+
+	string GetControllerIdentity(int deviceId) override
+	{
+		return _controllerMap[deviceId]->_identity;
+	}
+
+	int GetControllerColour(int deviceId) override
+	{
+		return int();
+	}
+
+	void SetLightColour(int deviceId, int colour) override
+	{
+		HidrawDevice *device = _controllerMap[deviceId];
+		uint8_t red = uint8_t(colour >> 16), green = uint8_t(colour >> 8), blue = uint8_t(colour);
+		if (device->_kind != HidrawDevice::Kind::PRO && (red != device->_lightRed || green != device->_lightGreen || blue != device->_lightBlue))
+		{
+			device->_lightRed = red;
+			device->_lightGreen = green;
+			device->_lightBlue = blue;
+			device->sendEffect();
+		}
+	}
+
+	void SetRumble(int deviceId, int smallRumble, int bigRumble) override
+	{
+		HidrawDevice *device = _controllerMap[deviceId];
+		uint16_t small = clamp(smallRumble, 0, int(UINT16_MAX));
+		uint16_t big = clamp(bigRumble, 0, int(UINT16_MAX));
+		if (small != device->_small_rumble || big != device->_big_rumble)
+		{
+			device->_small_rumble = small;
+			device->_big_rumble = big;
+			device->sendEffect();
+		}
+	}
+
+	void SetPlayerNumber(int deviceId, int number) override
+	{
+		_controllerMap[deviceId]->setPlayerLights(number);
+	}
+
+	void SetTriggerEffect(int deviceId, const AdaptiveTriggerSetting &_leftTriggerEffect, const AdaptiveTriggerSetting &_rightTriggerEffect) override
+	{
+		HidrawDevice *device = _controllerMap[deviceId];
+		// Called every tick: only write when the effect changes
+		if (device->_kind == HidrawDevice::Kind::DS && (_leftTriggerEffect != device->_leftTriggerEffect || _rightTriggerEffect != device->_rightTriggerEffect))
+		{
+			device->_leftTriggerEffect = _leftTriggerEffect;
+			device->_rightTriggerEffect = _rightTriggerEffect;
+			device->sendEffect();
+		}
+	}
+
+	void SetIdle(int deviceId, bool idle, int pairedDeviceId) override
+	{
+		// Joy-Cons aren't supported, so there is no pair
+		_controllerMap[deviceId]->setIdle(idle);
+	}
+
+	virtual void SetMicLight(int deviceId, uint8_t mode) override
+	{
+		HidrawDevice *device = _controllerMap[deviceId];
+		if (device->_kind == HidrawDevice::Kind::DS && mode != device->_micLight)
+		{
+			device->_micLight = mode;
+			device->sendEffect();
+		}
+	}
+};
+
+JslWrapper *JslWrapper::getNew()
+{
+	return new HidrawInstance();
+}
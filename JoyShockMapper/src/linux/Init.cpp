@@ -12,17 +12,6 @@
 
 #include "InputHelpers.h"
 
-static void terminateHandler(int signo)
-{
-	if (signo != SIGTERM && signo != SIGINT)
-	{
-		std::fprintf(stderr, "Caught unexpected signal %d\n", signo);
-		return;
-	}
-
-	WriteToConsole("QUIT");
-}
-
 static const int initialize = [] {
 	std::string appRootDir{};
 
@@ -85,8 +74,13 @@ static const int initialize = [] {
 		}
 	}
 
-	signal(SIGTERM, &terminateHandler);
-	signal(SIGINT, &terminateHandler);
+	// Termination signals are turned into a QUIT command by the command ingress through a signalfd.
+	// Block them now, before any thread gets created, so every thread inherits the mask.
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGTERM);
+	sigaddset(&signals, SIGINT);
+	pthread_sigmask(SIG_BLOCK, &signals, nullptr);
 
 	return 0;
 }();
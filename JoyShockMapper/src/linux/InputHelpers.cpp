@@ -1,9 +1,14 @@
 #include "InputHelpers.h"
+#include "OutputCapture.h"
 
+#include <algorithm>
 #include <array>
 #include <atomic>
+#include <cerrno>
 #include <cmath>
+#include <cstdio>
 #include <cstring>
+#include <ctime>
 #include <functional>
 #include <string>
 #include <thread>
@@ -21,14 +26,21 @@
 #include <sys/stat.h>
 
 #include <queue>
+#include <map>
 #include <mutex>
-#include <condition_variable>
-
-std::queue<Command> commandQueue;
-std::mutex commandQueueMutex;
-std::condition_variable commandQueueCV;
+#include <set>
+#include <unordered_map>
+
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <termios.h>
 #include <dlfcn.h>
+#include <poll.h>
+#include <sys/inotify.h>
 
 using WORD = unsigned short;
 using DWORD = unsigned long;
@@ -40,6 +52,7 @@ using X11Atom = unsigned long;
 
 static void *X11Display{ nullptr };
 static X11Atom _NET_WM_PID{ 0 };
+static X11Atom _NET_ACTIVE_WINDOW{ 0 };
 
 static void *(*XOpenDisplay)(const char *);
 static int (*XGetInputFocus)(void *, X11Window *, int *);
@@ -47,6 +60,25 @@ static int (*XFetchName)(void *, X11Window, char **);
 static X11Atom (*XInternAtom)(void *, const char *, int);
 static int (*XGetWindowProperty)(void *, X11Window, X11Atom, long, long, int, X11Atom, X11Atom *, int *, unsigned long *, unsigned long *, unsigned char **);
 static int (*XFree)(void *);
+static X11Window (*XDefaultRootWindow)(void *);
+static int (*XSelectInput)(void *, X11Window, long);
+static int (*XConnectionNumber)(void *);
+static int (*XPending)(void *);
+static int (*XNextEvent)(void *, void *);
+static int (*XFlush)(void *);
+
+// Only the members of XPropertyEvent we need, see X11/Xlib.h
+struct X11PropertyEvent
+{
+	int type;
+	unsigned long serial;
+	int send_event;
+	void *display;
+	X11Window window;
+	X11Atom atom;
+};
+constexpr int X11PropertyNotify = 28;
+constexpr long X11PropertyChangeMask = 1L << 22;
 
 // Windows' mouse speed settings translate non-linearly to speed.
 // Thankfully, the mappings are available here:
@@ -374,6 +406,7 @@ public:
 public:
 	void press_key(WORD key) noexcept
 	{
+		std::lock_guard guard(mutex_);
 		auto error =
 		  libevdev_uinput_write_event(uinput_device_, EV_KEY, windows_key_to_evdev_key(key), 1);
 		if (error != 0)
@@ -392,6 +425,7 @@ public:
 
 	void release_key(WORD key) noexcept
 	{
+		std::lock_guard guard(mutex_);
 		auto error =
 		  libevdev_uinput_write_event(uinput_device_, EV_KEY, windows_key_to_evdev_key(key), 0);
 		if (error != 0)
@@ -416,6 +450,7 @@ public:
 
 	void mouse_move_relative(std::int32_t x, std::int32_t y) noexcept
 	{
+		std::lock_guard guard(mutex_);
 		auto error = libevdev_uinput_write_event(uinput_device_, EV_REL, REL_X, x);
 		if (error != 0)
 		{
@@ -440,6 +475,7 @@ public:
 
 	void mouse_move_absolute(std::int32_t x, std::int32_t y) noexcept
 	{
+		std::lock_guard guard(mutex_);
 		auto error = libevdev_uinput_write_event(uinput_device_, EV_ABS, ABS_X, x);
 		if (error != 0)
 		{
@@ -464,6 +500,7 @@ public:
 
 	void mouse_scroll(std::int32_t amount) noexcept
 	{
+		std::lock_guard guard(mutex_);
 		auto error = libevdev_uinput_write_event(uinput_device_, EV_REL, REL_WHEEL, amount);
 		if (error != 0)
 		{
@@ -482,6 +519,9 @@ public:
 private:
 	libevdev *device_;
 	libevdev_uinput *uinput_device_{ nullptr };
+	// The input thread and the mouse pacer both write to the mouse: each frame of events up to its SYN_REPORT
+	// goes out whole
+	std::mutex mutex_;
 };
 
 // get the user's mouse sensitivity multiplier from the user. In Windows it's an int, but who cares?
@@ -494,18 +534,29 @@ float getMouseSpeed()
 
 namespace
 {
-VirtualInputDevice mouse{ VirtualInputDevice::Device::MOUSE };
-VirtualInputDevice keyboard{ VirtualInputDevice::Device::KEYBOARD };
+// Created on first use: a replay captures its output and never needs /dev/uinput
+VirtualInputDevice &mouse()
+{
+	static VirtualInputDevice device{ VirtualInputDevice::Device::MOUSE };
+	return device;
+}
+
+VirtualInputDevice &keyboard()
+{
+	static VirtualInputDevice device{ VirtualInputDevice::Device::KEYBOARD };
+	return device;
+}
 } // namespace
 
 // send mouse button
 int pressMouse(WORD vkKey, bool isPressed)
 {
+	flushMouseMove(); // A click lands where the motion before it leads
 	if (vkKey == V_WHEEL_UP)
 	{
 		if (isPressed)
 		{
-			mouse.mouse_scroll(1);
+			mouse().mouse_scroll(1);
 		}
 
 		return 0;
@@ -515,7 +566,7 @@ int pressMouse(WORD vkKey, bool isPressed)
 	{
 		if (isPressed)
 		{
-			mouse.mouse_scroll(-1);
+			mouse().mouse_scroll(-1);
 		}
 
 		return 0;
@@ -523,11 +574,11 @@ int pressMouse(WORD vkKey, bool isPressed)
 
 	if (isPressed)
 	{
-		mouse.press_key(vkKey);
+		mouse().press_key(vkKey);
 	}
 	else
 	{
-		mouse.release_key(vkKey);
+		mouse().release_key(vkKey);
 	}
 
 	return 0;
@@ -536,7 +587,7 @@ int pressMouse(WORD vkKey, bool isPressed)
 // send key press
 int pressKey(KeyCode vkKey, bool pressed)
 {
-	if (vkKey.code == 0)
+	if (vkKey.code == 0 || OutputCapture::captureKey(vkKey, pressed))
 		return 0;
 	if (vkKey.code <= V_WHEEL_DOWN)
 	{
@@ -544,13 +595,14 @@ int pressKey(KeyCode vkKey, bool pressed)
 		return pressMouse(vkKey.code, pressed);
 	}
 
+	flushMouseMove();
 	if (pressed)
 	{
-		keyboard.press_key(vkKey.code);
+		keyboard().press_key(vkKey.code);
 	}
 	else
 	{
-		keyboard.release_key(vkKey.code);
+		keyboard().release_key(vkKey.code);
 	}
 
 	return 0;
@@ -559,7 +611,7 @@ int pressKey(KeyCode vkKey, bool pressed)
 float accumulatedX = 0;
 float accumulatedY = 0;
 
-void moveMouse(float x, float y)
+void sendMouseMove(float x, float y)
 {
 	accumulatedX += x;
 	accumulatedY += y;
@@ -569,57 +621,291 @@ void moveMouse(float x, float y)
 
 	accumulatedX -= applicableX;
 	accumulatedY -= applicableY;
+	if (applicableX == 0 && applicableY == 0)
+		return;
 
-	mouse.mouse_move_relative(applicableX, applicableY);
+	mouse().mouse_move_relative(applicableX, applicableY);
 	// printf("%0.4f %0.4f\n", accumulatedX, accumulatedY);
 }
 
 void setMouseNorm(float x, float y)
 {
-	mouse.mouse_move_absolute(std::roundf(65535.0f * x), std::roundf(65535.0f * y));
+	if (OutputCapture::captureMouseAbsolute(x, y))
+		return;
+	flushMouseMove();
+	mouse().mouse_move_absolute(std::roundf(65535.0f * x), std::roundf(65535.0f * y));
 }
 
-bool WriteToConsole(string_view command)
+namespace
 {
-	std::lock_guard<std::mutex> lock(commandQueueMutex);
-	commandQueue.push(Command{std::string(command), CommandSource::INTERNAL});
-	commandQueueCV.notify_one();
-	return true;
-}
-
-BOOL ConsoleCtrlHandler(DWORD)
+// All the commands on Linux come through here: the console, the FIFO, the control socket, termination
+// signals and WriteToConsole() from other threads. The main thread waits for all of them with a single epoll.
+class CommandIngress
 {
-	return false;
-};
+public:
+	CommandIngress()
+	  : _epoll(epoll_create1(EPOLL_CLOEXEC))
+	  , _wakeup(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+	{
+		addFd(_wakeup, CommandSource::INTERNAL);
+
+		// SIGINT and SIGTERM are blocked on startup, before any thread is created
+		sigset_t signals;
+		sigemptyset(&signals);
+		sigaddset(&signals, SIGINT);
+		sigaddset(&signals, SIGTERM);
+		_signals = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+		addFd(_signals, CommandSource::INTERNAL);
+	}
 
-// just setting up the console with standard stuff
-void initConsole(std::function<void()>)
-{
-	static std::thread consoleForwardThread([](){
-		std::cout << "[DEBUG] consoleForwardThread started" << std::endl;
-		std::string line;
+	void addFd(int fd, CommandSource source, int client = 0)
+	{
+		if (fd < 0)
+			return;
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		_sources[fd] = { source, client };
+		epoll_event evt{};
+		evt.events = EPOLLIN;
+		evt.data.fd = fd;
+		if (epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &evt) != 0)
+		{
+			std::fprintf(stderr, "Failed to listen for commands on fd %d: %s\n", fd, std::strerror(errno));
+		}
+	}
+
+	// Clients connecting to this listening socket become SOCKET command sources
+	void addListener(int fd)
+	{
+		_listener = fd;
+		addFd(fd, CommandSource::SOCKET);
+	}
+
+	// Thread safe
+	void push(Command command)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_queueMutex);
+			_queue.push(std::move(command));
+		}
+		uint64_t one = 1;
+		static_cast<void>(::write(_wakeup, &one, sizeof(one)));
+	}
+
+	// Only called from the main thread
+	Command next()
+	{
 		while (true)
 		{
-			if (!std::getline(std::cin, line))
 			{
-				std::cout << "[DEBUG] consoleForwardThread: EOF or error on cin" << std::endl;
-				break;
+				std::lock_guard<std::mutex> lock(_queueMutex);
+				if (!_queue.empty())
+				{
+					Command command = std::move(_queue.front());
+					_queue.pop();
+					return command;
+				}
 			}
 
-			std::cout << "[DEBUG] consoleForwardThread: read line from cin: " << line << std::endl;
+			epoll_event events[8];
+			int count = epoll_wait(_epoll, events, 8, -1);
+			for (int i = 0; i < count; ++i)
+			{
+				int fd = events[i].data.fd;
+				if (fd == _wakeup)
+				{
+					uint64_t counter;
+					static_cast<void>(::read(_wakeup, &counter, sizeof(counter)));
+				}
+				else if (fd == _signals)
+				{
+					signalfd_siginfo info;
+					while (::read(_signals, &info, sizeof(info)) == sizeof(info))
+					{
+						std::lock_guard<std::mutex> lock(_queueMutex);
+						_queue.push(Command{ "QUIT", CommandSource::INTERNAL });
+					}
+				}
+				else if (fd == _listener)
+				{
+					int clientFd;
+					while ((clientFd = accept4(_listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+					{
+						int client = ++_lastClient;
+						_clients[client] = { clientFd };
+						addFd(clientFd, CommandSource::SOCKET, client);
+					}
+				}
+				else
+				{
+					readLines(fd);
+				}
+			}
+		}
+	}
 
-			// Forward input to input_pipe_fd[1], mimicking WriteToConsole
+	// Only called from the main thread, once for every batch received from a socket client
+	void reply(int clientId, string_view response)
+	{
+		auto found = _clients.find(clientId);
+		if (found == _clients.end())
+			return; // The client is gone already
+		Client &client = found->second;
+		--client.batchesInFlight;
+
+		// Responses are small: wait a bit if the client doesn't read fast enough, but never hang the main thread
+		while (!response.empty() && client.fd >= 0)
+		{
+			ssize_t sent = ::send(client.fd, response.data(), response.size(), MSG_NOSIGNAL);
+			if (sent > 0)
 			{
-				std::lock_guard<std::mutex> lock(commandQueueMutex);
-				commandQueue.push(Command{line, CommandSource::CONSOLE});
-				commandQueueCV.notify_one();
+				response.remove_prefix(sent);
+				continue;
 			}
+			pollfd pfd{ client.fd, POLLOUT, 0 };
+			if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && ::poll(&pfd, 1, 1000) > 0)
+				continue;
+			dropClient(clientId, true);
+			return;
+		}
+		if (client.hungUp && client.batchesInFlight == 0)
+		{
+			dropClient(clientId, false);
 		}
-		std::cout << "[DEBUG] consoleForwardThread exiting" << std::endl;
-	});
+	}
+
+private:
+	void readLines(int fd)
+	{
+		auto &[source, client, pending, batch] = _sources[fd];
+		char buffer[4096];
+		ssize_t length;
+		while ((length = ::read(fd, buffer, sizeof(buffer))) > 0)
+		{
+			pending.append(buffer, length);
+		}
+		bool hungUp = length == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+		if (hungUp)
+		{
+			// EOF or error: nothing more will come from there
+			epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, nullptr);
+			if (!pending.empty())
+				pending.push_back('\n');
+		}
+
+		std::unique_lock<std::mutex> lock(_queueMutex);
+		for (auto eol = pending.find('\n'); eol != std::string::npos; eol = pending.find('\n'))
+		{
+			std::string line = pending.substr(0, eol);
+			pending.erase(0, eol + 1);
+			if (source == CommandSource::SOCKET)
+			{
+				// Socket clients send batches of lines terminated by an empty line
+				if (!line.empty() && line.back() == '\r')
+					line.pop_back();
+				if (!line.empty())
+				{
+					batch.append(line).push_back('\n');
+					continue;
+				}
+				if (batch.empty())
+					continue;
+				_clients[client].batchesInFlight++;
+				_queue.push(Command{ std::exchange(batch, {}), source, client });
+				continue;
+			}
+			if (source == CommandSource::FIFO)
+			{
+				std::printf("%s\n", line.c_str());
+			}
+			_queue.push(Command{ std::move(line), source });
+		}
+
+		if (hungUp && source == CommandSource::SOCKET)
+		{
+			// A client may half close the connection after its last batch and still wait for the response
+			if (!batch.empty())
+			{
+				_clients[client].batchesInFlight++;
+				_queue.push(Command{ std::exchange(batch, {}), source, client });
+			}
+			lock.unlock();
+			_clients[client].hungUp = true;
+			if (_clients[client].batchesInFlight == 0)
+				dropClient(client, false);
+		}
+	}
+
+	void dropClient(int clientId, bool unregister)
+	{
+		auto found = _clients.find(clientId);
+		if (found == _clients.end())
+			return;
+		int fd = found->second.fd;
+		if (unregister)
+			epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, nullptr);
+		_sources.erase(fd);
+		::close(fd);
+		_clients.erase(found);
+	}
+
+	struct Source
+	{
+		CommandSource source;
+		int client = 0;      // Control socket connection id, if any
+		std::string pending; // Incomplete line
+		std::string batch;   // Complete lines of an unterminated socket batch
+	};
+
+	struct Client
+	{
+		int fd = -1;
+		int batchesInFlight = 0; // Batches queued but not replied to yet
+		bool hungUp = false;
+	};
+
+	int _epoll;
+	int _wakeup;
+	int _signals = -1;
+	int _listener = -1;
+	int _lastClient = 0;
+	std::unordered_map<int, Source> _sources;
+	std::unordered_map<int, Client> _clients; // Only touched by the main thread
+	std::queue<Command> _queue;
+	std::mutex _queueMutex;
+};
+
+CommandIngress &ingress()
+{
+	static CommandIngress instance;
+	return instance;
 }
+} // namespace
 
-std::tuple<std::string, std::string> GetActiveWindowName()
+bool WriteToConsole(string_view command)
+{
+	ingress().push(Command{ std::string(command), CommandSource::INTERNAL });
+	return true;
+}
+
+Command WaitForCommand()
+{
+	return ingress().next();
+}
+
+void ReplyToCommand(const Command &command, string_view response)
+{
+	if (command.source == CommandSource::SOCKET)
+	{
+		ingress().reply(command.client, response);
+	}
+}
+
+BOOL ConsoleCtrlHandler(DWORD)
+{
+	return false;
+};
+
+static void *openX11Display()
 {
 	if (X11Display == nullptr)
 	{
@@ -633,11 +919,63 @@ std::tuple<std::string, std::string> GetActiveWindowName()
 			XInternAtom = reinterpret_cast<decltype(XInternAtom)>(::dlsym(libX11, "XInternAtom"));
 			XGetWindowProperty = reinterpret_cast<decltype(XGetWindowProperty)>(::dlsym(libX11, "XGetWindowProperty"));
 			XFree = reinterpret_cast<decltype(XFree)>(::dlsym(libX11, "XFree"));
+			XDefaultRootWindow = reinterpret_cast<decltype(XDefaultRootWindow)>(::dlsym(libX11, "XDefaultRootWindow"));
+			XSelectInput = reinterpret_cast<decltype(XSelectInput)>(::dlsym(libX11, "XSelectInput"));
+			XConnectionNumber = reinterpret_cast<decltype(XConnectionNumber)>(::dlsym(libX11, "XConnectionNumber"));
+			XPending = reinterpret_cast<decltype(XPending)>(::dlsym(libX11, "XPending"));
+			XNextEvent = reinterpret_cast<decltype(XNextEvent)>(::dlsym(libX11, "XNextEvent"));
+			XFlush = reinterpret_cast<decltype(XFlush)>(::dlsym(libX11, "XFlush"));
 
 			X11Display = XOpenDisplay(nullptr);
-			_NET_WM_PID = XInternAtom(X11Display, "_NET_WM_PID", true);
+			if (X11Display != nullptr)
+			{
+				_NET_WM_PID = XInternAtom(X11Display, "_NET_WM_PID", true);
+				_NET_ACTIVE_WINDOW = XInternAtom(X11Display, "_NET_ACTIVE_WINDOW", false);
+				// The window manager updates this property of the root window whenever the focus changes
+				XSelectInput(X11Display, XDefaultRootWindow(X11Display), X11PropertyChangeMask);
+				XFlush(X11Display);
+			}
 		}
 	}
+	return X11Display;
+}
+
+bool WaitForActiveWindowChange(unsigned int timeoutMs)
+{
+	if (openX11Display() == nullptr)
+	{
+		// There is no standard way to be notified of focus changes on Wayland: fall back to polling
+		std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+		return true;
+	}
+
+	bool changed = false;
+	auto drainEvents = [&changed]()
+	{
+		long event[24]; // sizeof(XEvent)
+		while (XPending(X11Display) > 0)
+		{
+			XNextEvent(X11Display, event);
+			auto property = reinterpret_cast<X11PropertyEvent *>(event);
+			changed |= property->type == X11PropertyNotify && property->atom == _NET_ACTIVE_WINDOW;
+		}
+	};
+
+	drainEvents();
+	if (!changed)
+	{
+		pollfd pfd{ XConnectionNumber(X11Display), POLLIN, 0 };
+		if (::poll(&pfd, 1, int(timeoutMs)) > 0)
+		{
+			drainEvents();
+		}
+	}
+	return changed;
+}
+
+std::tuple<std::string, std::string> GetActiveWindowName()
+{
+	openX11Display();
 
 	std::tuple<std::string, std::string> result;
 
@@ -722,6 +1060,130 @@ std::vector<std::string> ListDirectory(std::string directory)
 	return fileListing;
 }
 
+struct DirectoryWatcher::Impl
+{
+	int fd = -1;
+};
+
+DirectoryWatcher::DirectoryWatcher(string_view directory)
+  : _impl(std::make_unique<Impl>())
+{
+	_impl->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (_impl->fd >= 0 && inotify_add_watch(_impl->fd, std::string(directory).c_str(), IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF) < 0)
+	{
+		::close(_impl->fd);
+		_impl->fd = -1;
+	}
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+	if (_impl->fd >= 0)
+	{
+		::close(_impl->fd);
+	}
+}
+
+bool DirectoryWatcher::hasChanged()
+{
+	if (_impl->fd < 0)
+	{
+		// Not watching anything, so we can't tell
+		return true;
+	}
+	bool changed = false;
+	bool watchRemoved = false;
+	alignas(inotify_event) char buffer[4096];
+	for (auto length = ::read(_impl->fd, buffer, sizeof(buffer)); length > 0; length = ::read(_impl->fd, buffer, sizeof(buffer)))
+	{
+		for (char *ptr = buffer; ptr < buffer + length; ptr += sizeof(inotify_event) + reinterpret_cast<inotify_event *>(ptr)->len)
+		{
+			watchRemoved |= (reinterpret_cast<inotify_event *>(ptr)->mask & IN_IGNORED) != 0;
+		}
+		changed = true;
+	}
+	if (watchRemoved)
+	{
+		// The directory itself is gone
+		::close(_impl->fd);
+		_impl->fd = -1;
+	}
+	return changed;
+}
+
+struct FileWatcher::Impl
+{
+	int fd = -1;
+	std::set<std::string> watched;
+	// Watch descriptor of a directory -> name of a file in it -> path given to watch()
+	std::unordered_map<int, std::multimap<std::string, std::string>> files;
+};
+
+FileWatcher::FileWatcher()
+  : _impl(std::make_unique<Impl>())
+{
+	_impl->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+}
+
+FileWatcher::~FileWatcher()
+{
+	if (_impl->fd >= 0)
+	{
+		::close(_impl->fd);
+	}
+}
+
+void FileWatcher::watch(string_view path)
+{
+	std::string file(path);
+	if (_impl->fd < 0 || !_impl->watched.insert(file).second)
+		return;
+	// Watch the directory rather than the file, which an editor may replace
+	auto slash = file.find_last_of('/');
+	std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : file.substr(0, slash);
+	int wd = inotify_add_watch(_impl->fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (wd >= 0)
+	{
+		_impl->files[wd].emplace(file.substr(slash + 1), file);
+	}
+}
+
+std::vector<std::string> FileWatcher::changedFiles()
+{
+	std::vector<std::string> changed;
+	if (_impl->fd < 0)
+		return changed;
+	alignas(inotify_event) char buffer[4096];
+	for (auto length = ::read(_impl->fd, buffer, sizeof(buffer)); length > 0; length = ::read(_impl->fd, buffer, sizeof(buffer)))
+	{
+		for (char *ptr = buffer; ptr < buffer + length; ptr += sizeof(inotify_event) + reinterpret_cast<inotify_event *>(ptr)->len)
+		{
+			auto *event = reinterpret_cast<inotify_event *>(ptr);
+			auto directory = _impl->files.find(event->wd);
+			if (event->len == 0 || directory == _impl->files.end())
+				continue;
+			auto [first, last] = directory->second.equal_range(event->name);
+			for (auto file = first; file != last; ++file)
+			{
+				if (std::find(changed.begin(), changed.end(), file->second) == changed.end())
+					changed.push_back(file->second);
+			}
+		}
+	}
+	return changed;
+}
+
+bool FileWatcher::wait(unsigned int timeoutMs)
+{
+	if (_impl->fd < 0)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+		return false;
+	}
+	pollfd events = { _impl->fd, POLLIN, 0 };
+	return ::poll(&events, 1, int(timeoutMs)) > 0;
+}
+
 std::string GetCWD()
 {
 	std::unique_ptr<char, decltype(&std::free)> pathBuffer{ getcwd(nullptr, 0), &std::free };
@@ -745,30 +1207,15 @@ void HideConsole()
 void ShowConsole()
 {
 }
-void initConsole() {
-	static std::thread ttyForwardThread([](){
-		FILE* tty = fopen("/dev/tty", "r");
-		if (!tty) {
-			perror("fopen /dev/tty");
-			return;
-		}
-		char* lineptr = nullptr;
-		size_t n = 0;
-		while (true) {
-			ssize_t read = getline(&lineptr, &n, tty);
-			if (read == -1) {
-				break;
-			}
-
-			{
-				std::lock_guard<std::mutex> lock(commandQueueMutex);
-				commandQueue.push(Command{std::string(lineptr, read), CommandSource::CONSOLE});
-				commandQueueCV.notify_one();
-			}
-		}
-		free(lineptr);
-		fclose(tty);
-	});
+void initConsole()
+{
+	int tty = open("/dev/tty", O_RDONLY | O_CLOEXEC);
+	if (tty < 0)
+	{
+		perror("open /dev/tty");
+		return;
+	}
+	ingress().addFd(tty, CommandSource::CONSOLE);
 }
 
 bool ClearConsole() {
@@ -785,74 +1232,101 @@ void UnhideConsole() {
 
 void initFifoCommandListener()
 {
-    // Check if FIFO exists, create if missing
-    const char* fifo_path = "/tmp/jsm_command_fifo";
-    if (access(fifo_path, F_OK) == -1) {
-        if (mkfifo(fifo_path, 0666) != 0) {
-            perror("mkfifo");
-            return;
-        }
-    }
-
-    std::thread([](){
-        const char* fifo_path = "/tmp/jsm_command_fifo";
-
-        int fifo_read_fd = open(fifo_path, O_RDONLY | O_NONBLOCK);
-        printf("[FIFO] Opened FIFO for reading (fd=%d)\n", fifo_read_fd);
-        if (fifo_read_fd < 0) {
-            perror("open fifo for reading");
-            return;
-        }
-
-        // Open dummy write FD to keep FIFO open and avoid EOF
-        int fifo_write_fd = open(fifo_path, O_WRONLY);
-        if (fifo_write_fd < 0) {
-            perror("open fifo for writing");
-            // Still proceed, but echo may block if no other writers
-        } else {
-            printf("[FIFO] Dummy writer opened (fd=%d)\n", fifo_write_fd);
-        }
-
-        FILE* fifo_file = fdopen(fifo_read_fd, "r");
-        if (!fifo_file) {
-            perror("fdopen fifo");
-            close(fifo_read_fd);
-            if (fifo_write_fd >= 0) close(fifo_write_fd);
-            return;
-        }
-
-        while (true) {
-            char* lineptr = nullptr;
-            size_t n = 0;
-            ssize_t read_len = getline(&lineptr, &n, fifo_file);
-            if (read_len == -1) {
-                free(lineptr);
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                clearerr(fifo_file);
-                continue;
-            }
-
-            std::string line(lineptr, read_len);
-            free(lineptr);
-
-            // Remove trailing newline
-            if (!line.empty() && line.back() == '\n') {
-                line.pop_back();
-            }
-
-            printf("%s\n", line.c_str());
-
-            {
-                std::lock_guard<std::mutex> lock(commandQueueMutex);
-                commandQueue.push(Command{line, CommandSource::FIFO});
-                commandQueueCV.notify_one();
-            }
-        }
-
-        fclose(fifo_file);
-        if (fifo_write_fd >= 0) close(fifo_write_fd);
-    }).detach();
+	// Check if FIFO exists, create if missing
+	const char *fifo_path = "/tmp/jsm_command_fifo";
+	if (access(fifo_path, F_OK) == -1)
+	{
+		if (mkfifo(fifo_path, 0666) != 0)
+		{
+			perror("mkfifo");
+			return;
+		}
+	}
+
+	int fifo_read_fd = open(fifo_path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+	if (fifo_read_fd < 0)
+	{
+		perror("open fifo for reading");
+		return;
+	}
+
+	// Keep a writer open for the lifetime of the program, so the FIFO never reports EOF when clients disconnect
+	if (open(fifo_path, O_WRONLY | O_CLOEXEC) < 0)
+	{
+		perror("open fifo for writing");
+	}
+	ingress().addFd(fifo_read_fd, CommandSource::FIFO);
+}
+
+void initControlSocket()
+{
+	const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+	string socket_path = runtime_dir && *runtime_dir ? string(runtime_dir) + "/jsm_control.sock" : "/tmp/jsm_control.sock";
+
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if (socket_path.size() >= sizeof(address.sun_path))
+	{
+		std::fprintf(stderr, "Control socket path is too long: %s\n", socket_path.c_str());
+		return;
+	}
+	std::strcpy(address.sun_path, socket_path.c_str());
+
+	int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (listener < 0)
+	{
+		perror("control socket");
+		return;
+	}
+	// A previous instance may have left its socket file behind
+	unlink(socket_path.c_str());
+	// Only the user running JSM gets to send it commands
+	mode_t previous_mask = umask(0077);
+	int bound = bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+	umask(previous_mask);
+	if (bound != 0 || listen(listener, 4) != 0)
+	{
+		perror("bind control socket");
+		close(listener);
+		return;
+	}
+	ingress().addListener(listener);
+}
+
+long GetResidentMemoryKb()
+{
+	// The second field of statm is the number of resident pages
+	FILE *statm = std::fopen("/proc/self/statm", "r");
+	if (!statm)
+		return 0;
+	long size = 0, resident = 0;
+	int read = std::fscanf(statm, "%ld %ld", &size, &resident);
+	std::fclose(statm);
+	return read == 2 ? resident * (sysconf(_SC_PAGESIZE) / 1024) : 0;
 }
+
+float GetProcessAgeMs()
+{
+	FILE *stat = std::fopen("/proc/self/stat", "r");
+	if (!stat)
+		return 0.f;
+	char buffer[1024];
+	size_t length = std::fread(buffer, 1, sizeof(buffer) - 1, stat);
+	std::fclose(stat);
+	buffer[length] = '\0';
+	// The start time is field 22, in clock ticks since boot. The process name in field 2 may hold spaces and
+	// parentheses, so count the fields from the last closing parenthesis.
+	const char *fields = std::strrchr(buffer, ')');
+	unsigned long long startTicks = 0;
+	if (!fields || std::sscanf(fields + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d %*d %*d %*d %llu", &startTicks) != 1)
+		return 0.f;
+	timespec now;
+	if (clock_gettime(CLOCK_BOOTTIME, &now) != 0)
+		return 0.f;
+	double sinceBoot = double(now.tv_sec) + double(now.tv_nsec) / 1e9;
+	return float((sinceBoot - double(startTicks) / double(sysconf(_SC_CLK_TCK))) * 1000.);
+}
+
 bool IsVisible()
 {
 	return true;
@@ -8,8 +8,12 @@
 #include "Gamepad.h"
 #include "AutoLoad.h"
 #include "AutoConnect.h"
+#include "AutoReload.h"
 #include "SettingsManager.h"
 #include "JoyShock.h"
+#include "GyroCalibrationCache.h"
+#include "InputTrace.h"
+#include "OutputCapture.h"
 #include <filesystem>
 #define _USE_MATH_DEFINES
 #include <math.h> // M_PI
@@ -36,11 +40,14 @@ float os_mouse_speed = 1.0;
 float last_flick_and_rotation = 0.0;
 unique_ptr<PollingThread> autoLoadThread;
 unique_ptr<JSM::AutoConnect> autoConnectThread;
+unique_ptr<JSM::AutoReload> autoReloadThread;
 unique_ptr<PollingThread> minimizeThread;
 bool devicesCalibrating = false;
 unordered_map<int, shared_ptr<JoyShock>> handle_to_joyshock;
+GyroCalibrationCache gyroCalibrations;
+shared_ptr<ClockIf> mapperClock = make_shared<SteadyClock>(); // Time source of all the controllers
+unique_ptr<InputTraceRecorder> traceRecorder;                   // Records the controller input when set
 
-int input_pipe_fd[2];
 int triggerCalibrationStep = 0;
 
 struct TOUCH_POINT
@@ -87,7 +94,8 @@ struct TOUCH_POINT
 //	}
 // }
 
-void touchCallback(int jcHandle, TOUCH_STATE newState, TOUCH_STATE prevState, float delta_time)
+// Map the touchpad of a device, as part of its tick
+static void processTouch(JoyShock *js, const TOUCH_STATE &newState, const TOUCH_STATE &prevState, float delta_time)
 {
 
 	// if (current.t0Down || previous.t0Down)
@@ -104,13 +112,7 @@ void touchCallback(int jcHandle, TOUCH_STATE newState, TOUCH_STATE prevState, fl
 	//	  prevState.t1Down ? optional<FloatXY>({ prevState.t1X, prevState.t1Y }) : nullopt);
 	//}
 
-	shared_ptr<JoyShock> js = handle_to_joyshock[jcHandle];
-	int tpSizeX, tpSizeY;
-	if (!js || jsl->GetTouchpadDimension(jcHandle, tpSizeX, tpSizeY) == false)
-		return;
-	FloatXY tpSize{ float(tpSizeX), float(tpSizeY) };
-
-	lock_guard guard(js->_context->callback_lock);
+	FloatXY tpSize = *js->_touchpadSize;
 
 	TOUCH_POINT point0(newState.t0Down ? make_optional<FloatXY>(newState.t0X, newState.t0Y) : nullopt,
 	  prevState.t0Down ? make_optional<FloatXY>(prevState.t0X, prevState.t0Y) : nullopt, tpSize);
@@ -233,9 +235,14 @@ void calibrateTriggers(shared_ptr<JoyShock> jc)
 		return;
 	}
 
+	// The calibration steps at its own pace rather than on every tick, so it doesn't depend on the polling rate
+	static chrono::steady_clock::time_point nextStep;
+	static float stepTime = 100.f; // in milliseconds
+	if (jc->_timeNow < nextStep)
+		return;
+
 	auto rpos = jsl->GetRightTrigger(jc->_handle);
 	auto lpos = jsl->GetLeftTrigger(jc->_handle);
-	auto tick_time = *SettingsManager::get<float>(SettingID::TICK_TIME);
 	static auto &right_trigger_offset = *SettingsManager::getV<int>(SettingID::RIGHT_TRIGGER_OFFSET);
 	static auto &right_trigger_range = *SettingsManager::getV<int>(SettingID::RIGHT_TRIGGER_RANGE);
 	static auto &left_trigger_offset = *SettingsManager::getV<int>(SettingID::LEFT_TRIGGER_OFFSET);
@@ -245,7 +252,7 @@ void calibrateTriggers(shared_ptr<JoyShock> jc)
 	case 1:
 		COUT << "Softly press on the right trigger until you just feel the resistance.\n";
 		COUT << "Then press the dpad down button to proceed, or press HOME to abandon.\n";
-		tick_time.set(100.f);
+		stepTime = 100.f;
 		jc->_rightEffect.mode = AdaptiveTriggerMode::SEGMENT;
 		jc->_rightEffect.start = 0;
 		jc->_rightEffect.end = 255;
@@ -263,7 +270,7 @@ void calibrateTriggers(shared_ptr<JoyShock> jc)
 		if (int(rpos * 255.f) > 0)
 		{
 			right_trigger_offset.set(jc->_rightEffect.start);
-			tick_time.set(40);
+			stepTime = 40.f;
 			triggerCalibrationStep++;
 		}
 		++jc->_rightEffect.start;
@@ -272,7 +279,7 @@ void calibrateTriggers(shared_ptr<JoyShock> jc)
 		DEBUG_LOG << "trigger pos is at " << int(rpos * 255.f) << " (" << int(rpos * 100.f) << "%) and effect pos is at " << int(jc->_rightEffect.start) << '\n';
 		if (int(rpos * 255.f) > 240)
 		{
-			tick_time.set(100);
+			stepTime = 100.f;
 			triggerCalibrationStep++;
 		}
 		++jc->_rightEffect.start;
@@ -289,7 +296,7 @@ void calibrateTriggers(shared_ptr<JoyShock> jc)
 	case 6:
 		COUT << "Softly press on the left trigger until you just feel the resistance.\n";
 		COUT << "Then press the cross button to proceed, or press HOME to abandon.\n";
-		tick_time.set(100);
+		stepTime = 100.f;
 		jc->_leftEffect.mode = AdaptiveTriggerMode::SEGMENT;
 		jc->_leftEffect.start = 0;
 		jc->_leftEffect.end = 255;
@@ -307,7 +314,7 @@ void calibrateTriggers(shared_ptr<JoyShock> jc)
 		if (int(lpos * 255.f) > 0)
 		{
 			left_trigger_offset.set(jc->_leftEffect.start);
-			tick_time.set(40);
+			stepTime = 40.f;
 			triggerCalibrationStep++;
 		}
 		++jc->_leftEffect.start;
@@ -316,7 +323,7 @@ void calibrateTriggers(shared_ptr<JoyShock> jc)
 		DEBUG_LOG << "trigger pos is at " << int(lpos * 255.f) << " (" << int(lpos * 100.f) << "%) and effect pos is at " << int(jc->_leftEffect.start) << '\n';
 		if (int(lpos * 255.f) > 240)
 		{
-			tick_time.set(100);
+			stepTime = 100.f;
 			triggerCalibrationStep++;
 		}
 		++jc->_leftEffect.start;
@@ -337,57 +344,30 @@ void calibrateTriggers(shared_ptr<JoyShock> jc)
 		COUT_INFO << SettingID::LEFT_TRIGGER_OFFSET << " = " << left_trigger_offset << '\n';
 		COUT_INFO << SettingID::LEFT_TRIGGER_RANGE << " = " << left_trigger_range << '\n';
 		triggerCalibrationStep = 0;
-		tick_time.reset();
+		stepTime = 100.f;
 		break;
 	}
+	nextStep = jc->_timeNow + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<float, milli>(stepTime));
 	jsl->SetTriggerEffect(jc->_handle, jc->_leftEffect, jc->_rightEffect);
 }
 
-void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE lastState, IMU_STATE imuState, IMU_STATE lastImuState, float deltaTime)
+// Run the sensor fusion of a controller on its input of this tick
+static MotionResult processMotion(JoyShock &js, const IMU_STATE &imu, Switch autoCalibrate, float deltaTime)
 {
-
-	shared_ptr<JoyShock> jc = handle_to_joyshock[jcHandle];
-	if (jc == nullptr)
-		return;
-	jc->_context->callback_lock.lock();
-
-	auto timeNow = chrono::steady_clock::now();
-	deltaTime = ((float)chrono::duration_cast<chrono::microseconds>(timeNow - jc->_timeNow).count()) / 1000000.0f;
-	jc->_timeNow = timeNow;
-
-	if (triggerCalibrationStep)
-	{
-		calibrateTriggers(jc);
-		jc->_context->callback_lock.unlock();
-		return;
-	}
-
-	MotionIf &motion = *jc->_motion;
-
-	IMU_STATE imu = jsl->GetIMUState(jc->_handle);
-
-	if (SettingsManager::getV<Switch>(SettingID::AUTO_CALIBRATE_GYRO)->value() == Switch::ON)
-	{
-		motion.SetAutoCalibration(true, 1.2f, 0.015f);
-	}
-	else
+	if (autoCalibrate != js._autoCalibrateGyro)
 	{
-		motion.SetAutoCalibration(false, 0.f, 0.f);
+		// Changing the calibration mode restarts it: only do it when the setting changes
+		js._motion->SetAutoCalibration(autoCalibrate == Switch::ON, 1.2f, 0.015f);
+		js._autoCalibrateGyro = autoCalibrate;
 	}
-	motion.ProcessMotion(imu.gyroX, imu.gyroY, imu.gyroZ, imu.accelX, imu.accelY, imu.accelZ, deltaTime);
+	MotionSample sample{ imu.gyroX, imu.gyroY, imu.gyroZ, imu.accelX, imu.accelY, imu.accelZ, deltaTime };
+	MotionResult motionResult = js._motion->ProcessMotion(span(&sample, 1));
 
-	float inGyroX, inGyroY, inGyroZ;
-	motion.GetCalibratedGyro(inGyroX, inGyroY, inGyroZ);
-
-	float inGravX, inGravY, inGravZ;
-	motion.GetGravity(inGravX, inGravY, inGravZ);
-
-	float inQuatW, inQuatX, inQuatY, inQuatZ;
-	motion.GetOrientation(inQuatW, inQuatX, inQuatY, inQuatZ);
+	float inGravX = motionResult.gravX, inGravY = motionResult.gravY, inGravZ = motionResult.gravZ;
 
 	//// These are for sanity checking sensor fusion against a simple complementary filter:
 	// float angle = sqrtf(inGyroX * inGyroX + inGyroY * inGyroY + inGyroZ * inGyroZ) * PI / 180.f * deltaTime;
-	Vec normAxis = Vec(-inGyroX, -inGyroY, -inGyroZ).Normalized();
+	// Vec normAxis = Vec(-inGyroX, -inGyroY, -inGyroZ).Normalized();
 	// Quat reverseRotation = Quat(cosf(angle * 0.5f), normAxis.x, normAxis.y, normAxis.z);
 	// reverseRotation.Normalize();
 	// jc->_lastGrav *= reverseRotation;
@@ -413,13 +393,7 @@ void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE l
 	//	_motion.accelX, _motion.accelY, _motion.accelZ,
 	//	inGravvX, inGravY, inGravZ);
 
-	bool blockGyro = false;
-	bool lockMouse = false;
-	bool leftAny = false;
-	bool rightAny = false;
-	bool motionAny = false;
-
-	if (jc->set_neutral_quat)
+	if (js.set_neutral_quat)
 	{
 		// _motion stick neutral should be calculated from the gravity vector
 		Vec gravDirection = Vec(inGravX, inGravY, inGravZ);
@@ -429,177 +403,157 @@ void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE l
 		Quat neutralQuat = Quat(cosf(diffAngle * 0.5f), neutralGravAxis.x, neutralGravAxis.y, neutralGravAxis.z);
 		neutralQuat.Normalize();
 
-		jc->neutralQuatW = neutralQuat.w;
-		jc->neutralQuatX = neutralQuat.x;
-		jc->neutralQuatY = neutralQuat.y;
-		jc->neutralQuatZ = neutralQuat.z;
-		jc->set_neutral_quat = false;
-		COUT << "Neutral orientation for device " << jc->_handle << " set...\n";
+		js.neutralQuatW = neutralQuat.w;
+		js.neutralQuatX = neutralQuat.x;
+		js.neutralQuatY = neutralQuat.y;
+		js.neutralQuatZ = neutralQuat.z;
+		js.set_neutral_quat = false;
+		COUT << "Neutral orientation for device " << js._handle << " set...\n";
 	}
+	return motionResult;
+}
 
-	float gyroX = 0.0;
-	float gyroY = 0.0;
-	GyroSpace gyroSpace = jc->getSetting<GyroSpace>(SettingID::GYRO_SPACE);
-	if (gyroSpace == GyroSpace::LOCAL)
+// Tell the backend whether the mapping of the controller is at rest. The input of both halves of a merged pair
+// is mapped on the ticks of the driving half, so both are at rest and either one wakes the driving half.
+void setIdle(const JoyShock &jc, bool atRest)
+{
+	if (jc._pairedHalf)
 	{
-		int mouse_x_flag = (int)jc->getSetting<GyroAxisMask>(SettingID::MOUSE_X_FROM_GYRO_AXIS);
-		if ((mouse_x_flag & (int)GyroAxisMask::X) > 0)
-		{
-			gyroX += inGyroX;
-		}
-		if ((mouse_x_flag & (int)GyroAxisMask::Y) > 0)
-		{
-			gyroX -= inGyroY;
-		}
-		if ((mouse_x_flag & (int)GyroAxisMask::Z) > 0)
+		jsl->SetIdle(jc._pairedHalf->_handle, atRest);
+	}
+	jsl->SetIdle(jc._handle, atRest, jc._pairedHalf ? jc._pairedHalf->_handle : -1);
+}
+
+void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE lastState, IMU_STATE imuState, IMU_STATE lastImuState, float deltaTime)
+{
+
+	shared_ptr<JoyShock> jc = handle_to_joyshock[jcHandle];
+	if (jc == nullptr || jc->_passive) // The other half of a pair maps the input of this one
+		return;
+	jc->_context->callback_lock.lock();
+	// Pick up the latest published settings. They won't change until the next tick.
+	jc->_settings = SettingsManager::snapshot();
+	// Input of each side of the controller. Only one of them is there for a single Joy-Con.
+	JoyShock *leftHalf = jc->_splitType == JS_SPLIT_TYPE_RIGHT ? jc->_pairedHalf.get() : jc.get();
+	JoyShock *rightHalf = jc->_splitType == JS_SPLIT_TYPE_LEFT ? jc->_pairedHalf.get() : jc.get();
+	int leftHandle = leftHalf ? leftHalf->_handle : jc->_handle;
+	int rightHandle = rightHalf ? rightHalf->_handle : jc->_handle;
+	jc->_context->settings = jc->_settings;
+	if (jc->_pairedHalf)
+	{
+		jc->_pairedHalf->_settings = jc->_settings;
+	}
+
+	auto processingStart = chrono::steady_clock::now();
+	auto timeNow = jc->_context->clock->now();
+	deltaTime = ((float)chrono::duration_cast<chrono::microseconds>(timeNow - jc->_timeNow).count()) / 1000000.0f;
+	// The first tick has no previous one. A tick at rest stretches the interval to the next one on purpose: it would
+	// throw off the rate of the device, which the smoothing windows and flick stick rely on.
+	if (jc->_timeNow != chrono::steady_clock::time_point{} && !jc->_atRest)
+	{
+		jc->_tickStats.ticks++;
+		jc->_tickStats.totalInterval += deltaTime;
+		jc->_tickStats.maxInterval = max(jc->_tickStats.maxInterval, deltaTime);
+		// Follow the actual rate of this device. Long gaps, like a stall, shouldn't throw it off.
+		jc->_tickTime += (min(deltaTime * 1000.f, 100.f) - jc->_tickTime) * 0.05f;
+	}
+	if (float stickStep = jsl->GetStickStep(jc->_handle); stickStep > 0.f)
+	{
+		jc->_stickStep = stickStep;
+	}
+	jc->_timeNow = timeNow;
+	if (traceRecorder)
+	{
+		// The driving half last, so a replay has the input of both when it maps them
+		for (JoyShock *half : { jc->_pairedHalf.get(), jc.get() })
 		{
-			gyroX -= inGyroZ;
+			if (!half)
+				continue;
+			int handle = half->_handle;
+			JOY_SHOCK_STATE input{ jsl->GetButtons(handle), jsl->GetLeftTrigger(handle), jsl->GetRightTrigger(handle),
+				jsl->GetLeftX(handle), jsl->GetLeftY(handle), jsl->GetRightX(handle), jsl->GetRightY(handle) };
+			traceRecorder->record(handle, half->_controllerType, half->_splitType, timeNow, input, jsl->GetIMUState(handle));
 		}
-		int mouse_y_flag = (int)jc->getSetting<GyroAxisMask>(SettingID::MOUSE_Y_FROM_GYRO_AXIS);
-		if ((mouse_y_flag & (int)GyroAxisMask::X) > 0)
+	}
+
+	if (triggerCalibrationStep)
+	{
+		calibrateTriggers(jc);
+		setIdle(*jc, false); // Calibration steps are timed
+		jc->_atRest = false;
+		jc->_context->callback_lock.unlock();
+		return;
+	}
+
+	auto autoCalibrate = jc->_settings->value<Switch>(SettingID::AUTO_CALIBRATE_GYRO).value_or(Switch::OFF);
+	GyroSpace gyroSpace = jc->getSetting<GyroSpace>(SettingID::GYRO_SPACE);
+	GyroAxisMask mouseXAxes = GyroAxisMask::NONE;
+	GyroAxisMask mouseYAxes = GyroAxisMask::NONE;
+	if (gyroSpace == GyroSpace::LOCAL)
+	{
+		mouseXAxes = jc->getSetting<GyroAxisMask>(SettingID::MOUSE_X_FROM_GYRO_AXIS);
+		mouseYAxes = jc->getSetting<GyroAxisMask>(SettingID::MOUSE_Y_FROM_GYRO_AXIS);
+	}
+	int gyroMask = (int)jc->getSetting<JoyconMask>(SettingID::JOYCON_GYRO_MASK);
+	int motionMask = (int)jc->getSetting<JoyconMask>(SettingID::JOYCON_MOTION_MASK);
+
+	// The gyro of the halves that aren't ignored adds up. Gravity comes from the first half not ignored for motion.
+	// A single Joy-Con whose gyro is ignored still has its gyro for the outputs other than the mouse.
+	IMU_STATE imu{}; // Raw input of the half giving the gyro
+	bool useGyro = false;
+	FloatXY ownGyro;
+	float gyroX = 0.f;
+	float gyroY = 0.f;
+	JoyShock *motionHalf = nullptr;
+	float inGravX = 0.f, inGravY = 0.f, inGravZ = 0.f;
+	float calibratedGyroSpeed = 0.f; // Fastest rotation of the halves, in degrees per second
+	for (JoyShock *half : { jc.get(), jc->_pairedHalf.get() })
+	{
+		if (!half)
+			continue;
+		IMU_STATE halfImu = jsl->GetIMUState(half->_handle);
+		MotionResult motionResult = processMotion(*half, halfImu, autoCalibrate, deltaTime);
+		calibratedGyroSpeed = max(calibratedGyroSpeed, sqrtf(motionResult.gyroX * motionResult.gyroX + motionResult.gyroY * motionResult.gyroY + motionResult.gyroZ * motionResult.gyroZ));
+		half->_gyroSpaceTransform.update(gyroSpace, mouseXAxes, mouseYAxes, motionResult.gravX, motionResult.gravY, motionResult.gravZ);
+		FloatXY spaceGyro = half->_gyroSpaceTransform.apply(motionResult.gyroX, motionResult.gyroY, motionResult.gyroZ);
+		bool halfGyro = half->_splitType == JS_SPLIT_TYPE_FULL || (half->_splitType & gyroMask) == 0;
+		if (half == jc.get())
 		{
-			gyroY -= inGyroX;
+			ownGyro = spaceGyro;
+			imu = halfImu;
 		}
-		if ((mouse_y_flag & (int)GyroAxisMask::Y) > 0)
+		if (halfGyro)
 		{
-			gyroY += inGyroY;
+			if (!useGyro)
+				imu = halfImu;
+			gyroX += spaceGyro.x();
+			gyroY += spaceGyro.y();
+			useGyro = true;
 		}
-		if ((mouse_y_flag & (int)GyroAxisMask::Z) > 0)
+		if (!motionHalf && (half->_splitType == JS_SPLIT_TYPE_FULL || (half->_splitType & motionMask) == 0))
 		{
-			gyroY += inGyroZ;
+			motionHalf = half;
+			inGravX = motionResult.gravX;
+			inGravY = motionResult.gravY;
+			inGravZ = motionResult.gravZ;
 		}
 	}
-	else
+	if (!useGyro)
 	{
-		float gravLength = sqrtf(inGravX * inGravX + inGravY * inGravY + inGravZ * inGravZ);
-		float normGravX = 0.f;
-		float normGravY = 0.f;
-		float normGravZ = 0.f;
-		if (gravLength > 0.f)
-		{
-			float gravNormalizer = 1.f / gravLength;
-			normGravX = inGravX * gravNormalizer;
-			normGravY = inGravY * gravNormalizer;
-			normGravZ = inGravZ * gravNormalizer;
-		}
-
-		float flatness = abs(normGravY);
-		float upness = abs(normGravZ);
-		float sideReduction = clamp((max(flatness, upness) - 0.125f) / 0.125f, 0.f, 1.f);
-
-		if (gyroSpace == GyroSpace::PLAYER_TURN || gyroSpace == GyroSpace::PLAYER_LEAN)
-		{
-			if (gyroSpace == GyroSpace::PLAYER_TURN)
-			{
-				// grav dot gyro axis (but only Y (yaw) and Z (roll))
-				float worldYaw = normGravY * inGyroY + normGravZ * inGyroZ;
-				float worldYawSign = worldYaw < 0.f ? -1.f : 1.f;
-				const float yawRelaxFactor = 2.f; // 60 degree buffer
-				// const float yawRelaxFactor = 1.41f; // 45 degree buffer
-				// const float yawRelaxFactor = 1.15f; // 30 degree buffer
-				gyroX += worldYawSign * min(abs(worldYaw) * yawRelaxFactor, sqrtf(inGyroY * inGyroY + inGyroZ * inGyroZ));
-			}
-			else // PLAYER_LEAN
-			{
-				// project local pitch axis (X) onto gravity plane
-				// super simple since our point is only non-zero in one axis
-				float gravDotPitchAxis = normGravX;
-				float pitchAxisX = 1.f - normGravX * gravDotPitchAxis;
-				float pitchAxisY = -normGravY * gravDotPitchAxis;
-				float pitchAxisZ = -normGravZ * gravDotPitchAxis;
-				// normalize
-				float pitchAxisLengthSquared = pitchAxisX * pitchAxisX + pitchAxisY * pitchAxisY + pitchAxisZ * pitchAxisZ;
-				if (pitchAxisLengthSquared > 0.f)
-				{
-					// world roll axis is cross (yaw, pitch)
-					float rollAxisX = pitchAxisY * normGravZ - pitchAxisZ * normGravY;
-					float rollAxisY = pitchAxisZ * normGravX - pitchAxisX * normGravZ;
-					float rollAxisZ = pitchAxisX * normGravY - pitchAxisY * normGravX;
-
-					// normalize
-					float rollAxisLengthSquared = rollAxisX * rollAxisX + rollAxisY * rollAxisY + rollAxisZ * rollAxisZ;
-					if (rollAxisLengthSquared > 0.f)
-					{
-						float rollAxisLength = sqrtf(rollAxisLengthSquared);
-						float lengthReciprocal = 1.f / rollAxisLength;
-						rollAxisX *= lengthReciprocal;
-						rollAxisY *= lengthReciprocal;
-						rollAxisZ *= lengthReciprocal;
-
-						float worldRoll = rollAxisY * inGyroY + rollAxisZ * inGyroZ;
-						float worldRollSign = worldRoll < 0.f ? -1.f : 1.f;
-						// const float rollRelaxFactor = 2.f; // 60 degree buffer
-						const float rollRelaxFactor = 1.41f; // 45 degree buffer
-						// const float rollRelaxFactor = 1.15f; // 30 degree buffer
-						gyroX += worldRollSign * min(abs(worldRoll) * rollRelaxFactor, sqrtf(inGyroY * inGyroY + inGyroZ * inGyroZ));
-						gyroX *= sideReduction;
-					}
-				}
-			}
+		gyroX = ownGyro.x();
+		gyroY = ownGyro.y();
+	}
 
-			gyroY -= inGyroX;
-		}
-		else // WORLD_TURN or WORLD_LEAN
-		{
-			// grav dot gyro axis
-			float worldYaw = normGravX * inGyroX + normGravY * inGyroY + normGravZ * inGyroZ;
-			// project local pitch axis (X) onto gravity plane
-			// super simple since our point is only non-zero in one axis
-			float gravDotPitchAxis = normGravX;
-			float pitchAxisX = 1.f - normGravX * gravDotPitchAxis;
-			float pitchAxisY = -normGravY * gravDotPitchAxis;
-			float pitchAxisZ = -normGravZ * gravDotPitchAxis;
-			// normalize
-			float pitchAxisLengthSquared = pitchAxisX * pitchAxisX + pitchAxisY * pitchAxisY + pitchAxisZ * pitchAxisZ;
-			if (pitchAxisLengthSquared > 0.f)
-			{
-				float pitchAxisLength = sqrtf(pitchAxisLengthSquared);
-				float lengthReciprocal = 1.f / pitchAxisLength;
-				pitchAxisX *= lengthReciprocal;
-				pitchAxisY *= lengthReciprocal;
-				pitchAxisZ *= lengthReciprocal;
-
-				// get global pitch factor (dot)
-				gyroY = -(pitchAxisX * inGyroX + pitchAxisY * inGyroY + pitchAxisZ * inGyroZ);
-				// by the way, pinch it towards the nonsense limit
-				gyroY *= sideReduction;
-
-				if (gyroSpace == GyroSpace::WORLD_LEAN)
-				{
-					// world roll axis is cross (yaw, pitch)
-					float rollAxisX = pitchAxisY * normGravZ - pitchAxisZ * normGravY;
-					float rollAxisY = pitchAxisZ * normGravX - pitchAxisX * normGravZ;
-					float rollAxisZ = pitchAxisX * normGravY - pitchAxisY * normGravX;
-
-					// normalize
-					float rollAxisLengthSquared = rollAxisX * rollAxisX + rollAxisY * rollAxisY + rollAxisZ * rollAxisZ;
-					if (rollAxisLengthSquared > 0.f)
-					{
-						float rollAxisLength = sqrtf(rollAxisLengthSquared);
-						lengthReciprocal = 1.f / rollAxisLength;
-						rollAxisX *= lengthReciprocal;
-						rollAxisY *= lengthReciprocal;
-						rollAxisZ *= lengthReciprocal;
-
-						// get global roll factor (dot)
-						gyroX = rollAxisX * inGyroX + rollAxisY * inGyroY + rollAxisZ * inGyroZ;
-						// by the way, pinch because we rely on a good pitch vector here
-						gyroX *= sideReduction;
-					}
-				}
-			}
+	bool blockGyro = false;
+	bool lockMouse = false;
+	bool leftAny = false;
+	bool rightAny = false;
+	bool motionAny = false;
 
-			if (gyroSpace == GyroSpace::WORLD_TURN)
-			{
-				gyroX += worldYaw;
-			}
-		}
-	}
 	float gyroLength = sqrt(gyroX * gyroX + gyroY * gyroY);
 	// do gyro smoothing
 	// convert gyro smooth time to number of samples
-	auto tick_time = SettingsManager::get<float>(SettingID::TICK_TIME)->value();
-	auto numGyroSamples = jc->getSetting(SettingID::GYRO_SMOOTH_TIME) * 1000.f / tick_time;
+	auto numGyroSamples = jc->getSetting(SettingID::GYRO_SMOOTH_TIME) * 1000.f / jc->_tickTime;
 	if (numGyroSamples < 1)
 		numGyroSamples = 1; // need at least 1 sample
 	auto threshold = jc->getSetting(SettingID::GYRO_SMOOTH_THRESHOLD);
@@ -643,8 +597,8 @@ void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE l
 		break;
 	case GyroIgnoreMode::LEFT_STICK:
 	{
-		float leftX = jsl->GetLeftX(jc->_handle);
-		float leftY = jsl->GetLeftY(jc->_handle);
+		float leftX = jsl->GetLeftX(leftHandle);
+		float leftY = jsl->GetLeftY(leftHandle);
 		float leftLength = sqrtf(leftX * leftX + leftY * leftY);
 		float deadzoneInner = jc->getSetting(SettingID::LEFT_STICK_DEADZONE_INNER);
 		float deadzoneOuter = jc->getSetting(SettingID::LEFT_STICK_DEADZONE_OUTER);
@@ -683,8 +637,8 @@ void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE l
 	break;
 	case GyroIgnoreMode::RIGHT_STICK:
 	{
-		float rightX = jsl->GetRightX(jc->_handle);
-		float rightY = jsl->GetRightY(jc->_handle);
+		float rightX = jsl->GetRightX(rightHandle);
+		float rightY = jsl->GetRightY(rightHandle);
 		float rightLength = sqrtf(rightX * rightX + rightY * rightY);
 		float deadzoneInner = jc->getSetting(SettingID::RIGHT_STICK_DEADZONE_INNER);
 		float deadzoneOuter = jc->getSetting(SettingID::RIGHT_STICK_DEADZONE_OUTER);
@@ -855,40 +809,40 @@ void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE l
 	jc->gyroXVelocity = gyroXVelocity;
 	jc->gyroYVelocity = gyroYVelocity;
 
-	jc->_timeNow = chrono::steady_clock::now();
+	jc->_timeNow = jc->_context->clock->now();
 
 	// sticks!
 	jc->processed_gyro_stick = false;
-	ControllerOrientation controllerOrientation = jc->getSetting<ControllerOrientation>(SettingID::CONTROLLER_ORIENTATION);
 	// account for os mouse speed and convert from radians to degrees because gyro reports in degrees per second
 	float mouseCalibrationFactor = 180.0f / M_PI / os_mouse_speed;
-	if (jc->_splitType != JS_SPLIT_TYPE_RIGHT)
+	if (leftHalf)
 	{
 		// let's do these sticks... don't want to constantly send input, so we need to compare them to last time
 		auto axisSign = jc->getSetting<AxisSignPair>(SettingID::LEFT_STICK_AXIS);
-		float calX = jsl->GetLeftX(jc->_handle) * float(axisSign.first);
-		float calY = jsl->GetLeftY(jc->_handle) * float(axisSign.second);
+		float calX = jsl->GetLeftX(leftHandle) * float(axisSign.first);
+		float calY = jsl->GetLeftY(leftHandle) * float(axisSign.second);
 
 		jc->processStick(calX, calY, jc->_leftStick, mouseCalibrationFactor, deltaTime, leftAny, lockMouse, camSpeedX, camSpeedY);
 		jc->_leftStick.lastX = calX;
 		jc->_leftStick.lastY = calY;
 	}
 
-	if (jc->_splitType != JS_SPLIT_TYPE_LEFT)
+	if (rightHalf)
 	{
 		auto axisSign = jc->getSetting<AxisSignPair>(SettingID::RIGHT_STICK_AXIS);
-		float calX = jsl->GetRightX(jc->_handle) * float(axisSign.first);
-		float calY = jsl->GetRightY(jc->_handle) * float(axisSign.second);
+		float calX = jsl->GetRightX(rightHandle) * float(axisSign.first);
+		float calY = jsl->GetRightY(rightHandle) * float(axisSign.second);
 
 		jc->processStick(calX, calY, jc->_rightStick, mouseCalibrationFactor, deltaTime, rightAny, lockMouse, camSpeedX, camSpeedY);
 		jc->_rightStick.lastX = calX;
 		jc->_rightStick.lastY = calY;
 	}
 
-	if (jc->_splitType == JS_SPLIT_TYPE_FULL ||
-	  (jc->_splitType & (int)jc->getSetting<JoyconMask>(SettingID::JOYCON_MOTION_MASK)) == 0)
+	if (motionHalf)
 	{
-		Quat neutralQuat = Quat(jc->neutralQuatW, jc->neutralQuatX, jc->neutralQuatY, jc->neutralQuatZ);
+		// The orientation is the one of the half giving the motion
+		ControllerOrientation controllerOrientation = motionHalf->getSetting<ControllerOrientation>(SettingID::CONTROLLER_ORIENTATION);
+		Quat neutralQuat = Quat(motionHalf->neutralQuatW, motionHalf->neutralQuatX, motionHalf->neutralQuatY, motionHalf->neutralQuatZ);
 		Vec grav = Vec(inGravX, inGravY, inGravZ) * neutralQuat.Inverse();
 
 		float lastCalX = jc->_motionStick.lastX;
@@ -949,35 +903,18 @@ void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE l
 				}
 				float motionDZInner = jc->getSetting(SettingID::MOTION_DEADZONE_INNER);
 				float motionDZOuter = jc->getSetting(SettingID::MOTION_DEADZONE_OUTER);
-				float remappedLeanAngle = pow(clamp((absLeanAngle - motionDZInner) / (180.f - motionDZOuter - motionDZInner), 0.f, 1.f), jc->getSetting(SettingID::STICK_POWER));
+				float remappedLeanAngle = jc->getStickPowerCurve()(clamp((absLeanAngle - motionDZInner) / (180.f - motionDZOuter - motionDZInner), 0.f, 1.f));
 
 				// now actually convert to output stick value, taking deadzones and power curve into account
-				float undeadzoneInner, undeadzoneOuter, unpower;
-				if (isLeft)
-				{
-					undeadzoneInner = jc->getSetting(SettingID::LEFT_STICK_UNDEADZONE_INNER);
-					undeadzoneOuter = jc->getSetting(SettingID::LEFT_STICK_UNDEADZONE_OUTER);
-					unpower = jc->getSetting(SettingID::LEFT_STICK_UNPOWER);
-				}
-				else
-				{
-					undeadzoneInner = jc->getSetting(SettingID::RIGHT_STICK_UNDEADZONE_INNER);
-					undeadzoneOuter = jc->getSetting(SettingID::RIGHT_STICK_UNDEADZONE_OUTER);
-					unpower = jc->getSetting(SettingID::RIGHT_STICK_UNPOWER);
-				}
-
-				float livezoneSize = 1.f - undeadzoneOuter - undeadzoneInner;
-				if (livezoneSize > 0.f)
+				const VirtualStickCurve &virtualStick = jc->getVirtualStickCurve(isLeft);
+				if (virtualStick.livezoneSize > 0.f)
 				{
 					// unpower curve
-					if (unpower != 0.f)
-					{
-						remappedLeanAngle = pow(remappedLeanAngle, 1.f / unpower);
-					}
+					remappedLeanAngle = virtualStick.inverse(remappedLeanAngle);
 
 					if (remappedLeanAngle < 1.f)
 					{
-						remappedLeanAngle = undeadzoneInner + remappedLeanAngle * livezoneSize;
+						remappedLeanAngle = virtualStick.undeadzoneInner + remappedLeanAngle * virtualStick.livezoneSize;
 					}
 
 					float signedStickValue = leanSign * remappedLeanAngle;
@@ -988,10 +925,19 @@ void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE l
 		}
 	}
 
-	int buttons = jsl->GetButtons(jc->_handle);
+	// Touch is read with the rest of the input, and only from devices that have a touchpad
+	TOUCH_STATE touchState{};
+	if (jc->_touchpadSize)
+	{
+		touchState = jsl->GetTouchState(jc->_handle);
+	}
+
+	int leftButtons = jsl->GetButtons(leftHandle);
+	int rightButtons = rightHandle == leftHandle ? leftButtons : jsl->GetButtons(rightHandle);
 	// button mappings
-	if (jc->_splitType != JS_SPLIT_TYPE_RIGHT)
+	if (leftHalf)
 	{
+		int buttons = leftButtons;
 		jc->handleButtonChange(ButtonID::UP, buttons & (1 << JSOFFSET_UP));
 		jc->handleButtonChange(ButtonID::DOWN, buttons & (1 << JSOFFSET_DOWN));
 		jc->handleButtonChange(ButtonID::LEFT, buttons & (1 << JSOFFSET_LEFT));
@@ -1000,11 +946,11 @@ void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE l
 		jc->handleButtonChange(ButtonID::MINUS, buttons & (1 << JSOFFSET_MINUS));
 		jc->handleButtonChange(ButtonID::L3, buttons & (1 << JSOFFSET_LCLICK));
 
-		float lTrigger = jsl->GetLeftTrigger(jc->_handle);
+		float lTrigger = jsl->GetLeftTrigger(leftHandle);
 		jc->handleTriggerChange(ButtonID::ZL, ButtonID::ZLF, jc->getSetting<TriggerMode>(SettingID::ZL_MODE), lTrigger, jc->_leftEffect);
 
-		bool touch = jsl->GetTouchDown(jc->_handle, false) || jsl->GetTouchDown(jc->_handle, true);
-		switch (jc->_controllerType)
+		bool touch = touchState.t0Down || touchState.t1Down;
+		switch (leftHalf->_controllerType)
 		{
 		case JS_TYPE_DS:
 			// JSL mapps mic button on the SL index
@@ -1037,21 +983,31 @@ void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE l
 		default: // Switch Pro controllers and left joycon
 		{
 			jc->handleButtonChange(ButtonID::CAPTURE, buttons & (1 << JSOFFSET_CAPTURE));
-			jc->handleButtonChange(ButtonID::LSL, buttons & (1 << JSOFFSET_SL));
-			jc->handleButtonChange(ButtonID::LSR, buttons & (1 << JSOFFSET_SR));
+			if (leftHalf->_splitType != JS_SPLIT_TYPE_LEFT) // The bumpers of the joycon are handled below
+			{
+				jc->handleButtonChange(ButtonID::LSL, buttons & (1 << JSOFFSET_SL));
+				jc->handleButtonChange(ButtonID::LSR, buttons & (1 << JSOFFSET_SR));
+			}
 		}
 		break;
 		}
 	}
-	else // split type IS right
+	if (leftHalf && leftHalf->_splitType == JS_SPLIT_TYPE_LEFT)
+	{
+		// Left joycon bumpers
+		jc->handleButtonChange(ButtonID::LSL, leftButtons & (1 << JSOFFSET_SL));
+		jc->handleButtonChange(ButtonID::LSR, leftButtons & (1 << JSOFFSET_SR));
+	}
+	if (rightHalf && rightHalf->_splitType == JS_SPLIT_TYPE_RIGHT)
 	{
 		// Right joycon bumpers
-		jc->handleButtonChange(ButtonID::RSL, buttons & (1 << JSOFFSET_SL));
-		jc->handleButtonChange(ButtonID::RSR, buttons & (1 << JSOFFSET_SR));
+		jc->handleButtonChange(ButtonID::RSL, rightButtons & (1 << JSOFFSET_SL));
+		jc->handleButtonChange(ButtonID::RSR, rightButtons & (1 << JSOFFSET_SR));
 	}
 
-	if (jc->_splitType != JS_SPLIT_TYPE_LEFT)
+	if (rightHalf)
 	{
+		int buttons = rightButtons;
 		jc->handleButtonChange(ButtonID::E, buttons & (1 << JSOFFSET_E));
 		jc->handleButtonChange(ButtonID::S, buttons & (1 << JSOFFSET_S));
 		jc->handleButtonChange(ButtonID::N, buttons & (1 << JSOFFSET_N));
@@ -1061,14 +1017,14 @@ void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE l
 		jc->handleButtonChange(ButtonID::HOME, buttons & (1 << JSOFFSET_HOME));
 		jc->handleButtonChange(ButtonID::R3, buttons & (1 << JSOFFSET_RCLICK));
 
-		float rTrigger = jsl->GetRightTrigger(jc->_handle);
+		float rTrigger = jsl->GetRightTrigger(rightHandle);
 		jc->handleTriggerChange(ButtonID::ZR, ButtonID::ZRF, jc->getSetting<TriggerMode>(SettingID::ZR_MODE), rTrigger, jc->_rightEffect);
 	}
-	else
+
+	if (jc->_touchpadSize)
 	{
-		// Left joycon bumpers
-		jc->handleButtonChange(ButtonID::LSL, buttons & (1 << JSOFFSET_SL));
-		jc->handleButtonChange(ButtonID::LSR, buttons & (1 << JSOFFSET_SR));
+		processTouch(jc.get(), touchState, jc->_lastTouch, deltaTime);
+		jc->_lastTouch = touchState;
 	}
 
 	auto at = jc->getSetting<Switch>(SettingID::ADAPTIVE_TRIGGER);
@@ -1116,9 +1072,7 @@ void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE l
 	}
 
 	// optionally ignore the gyro of one of the joycons
-	if (!lockMouse && gyroOutput == GyroOutput::MOUSE &&
-	  (jc->_splitType == JS_SPLIT_TYPE_FULL ||
-	    (jc->_splitType & (int)jc->getSetting<JoyconMask>(SettingID::JOYCON_GYRO_MASK)) == 0))
+	if (!lockMouse && gyroOutput == GyroOutput::MOUSE && useGyro)
 	{
 		// COUT << "GX: %0.4f GY: %0.4f GZ: %0.4f\n", imuState.gyroX, imuState.gyroY, imuState.gyroZ);
 		float mouseCalibration = jc->getSetting(SettingID::REAL_WORLD_CALIBRATION) / os_mouse_speed / jc->getSetting(SettingID::IN_GAME_SENS);
@@ -1139,11 +1093,50 @@ void joyShockPollCallback(int jcHandle, JOY_SHOCK_STATE state, JOY_SHOCK_STATE l
 	{
 		jc->_context->nn = (jc->_context->nn + 1) % 22;
 	}
+
+	// At rest, nothing the mapping does depends on time: no button is pressed or waiting on a timer, the sticks
+	// don't move the camera and no flick is animating, and the controller is still. The backend may then tick it
+	// less often until its input changes. The gyro keeps feeding the calibration, averaged over the longer ticks.
+	bool atRest = false;
+	if (jc->_settings->value<float>(SettingID::IDLE_TICK_TIME).value_or(0.f) > 0.f)
+	{
+		static constexpr float REST_GYRO_SPEED = 2.f; // Degrees per second
+		auto released = [](const DigitalButton &button)
+		{
+			return button.getState() == BtnState::NoPress;
+		};
+		auto flickDone = [](const Stick &stick)
+		{
+			return !stick.is_flicking && (stick.flick_percent_done >= 1.f || stick.delta_flick == 0.f);
+		};
+		atRest = calibratedGyroSpeed < REST_GYRO_SPEED && camSpeedX == 0.f && camSpeedY == 0.f && !leftAny && !rightAny && !motionAny &&
+		  !touchState.t0Down && !touchState.t1Down && jc->_context->nn == 0 &&
+		  flickDone(jc->_leftStick) && flickDone(jc->_rightStick) && flickDone(jc->_motionStick) &&
+		  all_of(jc->_buttons.begin(), jc->_buttons.end(), released) && all_of(jc->_gridButtons.begin(), jc->_gridButtons.end(), released);
+	}
+	setIdle(*jc, atRest);
+	jc->_atRest = atRest;
+
+	float processing = ((float)chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - processingStart).count()) / 1000000.0f;
+	jc->_tickStats.totalProcessing += processing;
+	jc->_tickStats.maxProcessing = max(jc->_tickStats.maxProcessing, processing);
 	jc->_context->callback_lock.unlock();
 }
 
+// Keep the gyro calibration of the current devices for the next time they connect
+void saveGyroCalibrations()
+{
+	for (auto &[handle, js] : handle_to_joyshock)
+	{
+		lock_guard guard(js->_context->callback_lock);
+		gyroCalibrations.store(js->_identity, *js->_motion);
+	}
+	gyroCalibrations.save();
+}
+
 void connectDevices(bool mergeJoycons = true)
 {
+	saveGyroCalibrations();
 	handle_to_joyshock.clear();
 	this_thread::sleep_for(100ms);
 	int numConnected = jsl->ConnectDevices();
@@ -1164,18 +1157,27 @@ void connectDevices(bool mergeJoycons = true)
 			auto otherJoyCon = find_if(handle_to_joyshock.begin(), handle_to_joyshock.end(),
 			  [type](auto &pair)
 			  {
+				  if (pair.second->_pairedHalf || pair.second->_passive)
+					  return false; // Already in a pair
 				  return type == JS_SPLIT_TYPE_LEFT && pair.second->_splitType == JS_SPLIT_TYPE_RIGHT ||
 				    type == JS_SPLIT_TYPE_RIGHT && pair.second->_splitType == JS_SPLIT_TYPE_LEFT;
 			  });
 			if (mergeJoycons && otherJoyCon != handle_to_joyshock.end())
 			{
-				// The second JC points to the same common _buttons as the other one.
+				// The second JC points to the same common _buttons as the other one, and maps the input of both.
 				COUT << "Found a joycon pair!\n";
-				handle_to_joyshock[handle] = make_shared<JoyShock>(handle, type, otherJoyCon->second->_context);
+				auto joyshock = make_shared<JoyShock>(handle, type, mapperClock, otherJoyCon->second->_context);
+				joyshock->_pairedHalf = otherJoyCon->second;
+				otherJoyCon->second->_passive = true;
+				handle_to_joyshock[handle] = joyshock;
 			}
 			else
 			{
-				handle_to_joyshock[handle] = make_shared<JoyShock>(handle, type);
+				handle_to_joyshock[handle] = make_shared<JoyShock>(handle, type, mapperClock);
+			}
+			if (gyroCalibrations.restore(handle_to_joyshock[handle]->_identity, *handle_to_joyshock[handle]->_motion))
+			{
+				COUT << "Restored the last gyro calibration of device " << handle << '\n';
 			}
 		}
 	}
@@ -1252,6 +1254,8 @@ bool do_NO_GYRO_BUTTON()
 
 bool do_RESET_MAPPINGS(CmdRegistry *registry)
 {
+	// Resetting and then loading OnReset.txt often changes settings twice
+	NotificationBatch notificationBatch;
 	COUT << "Resetting all mappings to defaults\n";
 	static constexpr auto callReset = [](JSMButton &map)
 	{
@@ -1267,6 +1271,8 @@ bool do_RESET_MAPPINGS(CmdRegistry *registry)
 	last_flick_and_rotation = 0.0f;
 	if (registry)
 	{
+		// What the files loaded before set is gone: they are no longer reloaded when they change
+		registry->clearLoadedFiles();
 		if (!registry->loadConfigFile("OnReset.txt"))
 		{
 			COUT << "There is no ";
@@ -1277,6 +1283,37 @@ bool do_RESET_MAPPINGS(CmdRegistry *registry)
 	return true;
 }
 
+// The state do_RESET_MAPPINGS and the config files loaded after it build, for the registry to bring it back
+class FrozenConfig : public CmdRegistry::ConfigStateIf
+{
+public:
+	FrozenConfig()
+	  : _settings(SettingsManager::freeze())
+	{
+		for (auto &mapping : mappings)
+			_mappings.push_back(mapping.freeze());
+		for (auto &mapping : grid_mappings)
+			_gridMappings.push_back(mapping.freeze());
+	}
+
+	void restore() const override
+	{
+		os_mouse_speed = 1.0f;
+		last_flick_and_rotation = 0.0f;
+		// Settings first: GRID_SIZE makes the grid buttons
+		SettingsManager::thaw(*_settings);
+		for (size_t i = 0; i < mappings.size() && i < _mappings.size(); ++i)
+			mappings[i].thaw(*_mappings[i]);
+		for (size_t i = 0; i < grid_mappings.size() && i < _gridMappings.size(); ++i)
+			grid_mappings[i].thaw(*_gridMappings[i]);
+	}
+
+private:
+	shared_ptr<const SettingsSnapshot> _settings;
+	vector<shared_ptr<const FrozenVariable>> _mappings;
+	vector<shared_ptr<const FrozenVariable>> _gridMappings;
+};
+
 bool do_RECONNECT_CONTROLLERS(string_view arguments, std::function<void()> loadOnReconnect)
 {
 	static bool mergeJoycons = true;
@@ -1299,7 +1336,6 @@ bool do_RECONNECT_CONTROLLERS(string_view arguments, std::function<void()> loadO
 	jsl->DisconnectAndDisposeAll();
 	connectDevices(mergeJoycons);
 	jsl->SetCallback(&joyShockPollCallback);
-	jsl->SetTouchCallback(&touchCallback);
 
 	if (loadOnReconnect)
 		loadOnReconnect();
@@ -1360,6 +1396,7 @@ bool do_FINISH_GYRO_CALIBRATION()
 		iter->second->_motion->PauseContinuousCalibration();
 	}
 	devicesCalibrating = false;
+	saveGyroCalibrations();
 	return true;
 }
 
@@ -1488,6 +1525,11 @@ void beforeShowTrayMenu()
 		  { SettingsManager::get<Switch>(SettingID::AUTOCONNECT)->set(isChecked ? Switch::ON : Switch::OFF); },
 		  bind(&PollingThread::isRunning, autoConnectThread.get()));
 
+		tray->AddMenuItem(
+		  U("AutoReload"), [](bool isChecked)
+		  { SettingsManager::get<Switch>(SettingID::AUTORELOAD)->set(isChecked ? Switch::ON : Switch::OFF); },
+		  bind(&PollingThread::isRunning, autoReloadThread.get()));
+
 		if (whitelister && whitelister->IsAvailable())
 		{
 			tray->AddMenuItem(
@@ -1543,15 +1585,142 @@ void beforeShowTrayMenu()
 	}
 }
 
+// Options given on the command line, besides config files and the JSM directory
+struct CommandLineOptions
+{
+	string recordTrace;       // --record-trace <file>: write the controller input to the file
+	string replayTrace;       // --replay <file>: map the input trace instead of the controllers, then quit
+	vector<string> configs;   // --config <file>: with --replay, load the config file before mapping. Can be repeated
+	string capture;           // --capture <file>: with --replay, write the output events to the file
+	string golden;            // --golden <file>: with --replay, compare the output events with the file
+	float tolerance = 0.001f; // --tolerance <value>: largest difference between the numbers of the golden and the captured output
+	bool daemon = false;      // --daemon: (Linux) no console and no tray. Commands only come from the FIFO and the control socket
+	bool invalid = false;     // An option has a value it can't use
+	set<int> consumed;        // Arguments that belong to these options
+};
+
+template<typename Char>
+CommandLineOptions parseCommandLine(int argc, Char **argv)
+{
+	CommandLineOptions options;
+	auto argument = [argv](int index)
+	{
+		basic_string_view<Char> text(argv[index]);
+		return string(text.begin(), text.end());
+	};
+	for (int i = 0; i < argc; ++i)
+	{
+		string name = argument(i);
+#ifndef _WIN32
+		if (name == "--daemon")
+		{
+			options.daemon = true;
+			options.consumed.insert(i);
+			continue;
+		}
+#endif
+		if (i + 1 == argc)
+			break; // The other options have a value
+		string *value = name == "--record-trace" ? &options.recordTrace :
+		  name == "--replay"                     ? &options.replayTrace :
+		  name == "--config"                     ? &options.configs.emplace_back() :
+		  name == "--capture"                    ? &options.capture :
+		  name == "--golden"                     ? &options.golden :
+		                                           nullptr;
+		if (value)
+		{
+			*value = argument(i + 1);
+		}
+		else if (name == "--tolerance")
+		{
+			string text = argument(i + 1);
+			size_t end = 0;
+			try
+			{
+				options.tolerance = stof(text, &end);
+			}
+			catch (const logic_error &)
+			{
+				end = 0; // Not a number, or out of range
+			}
+			if (end == 0 || end != text.size())
+			{
+				CERR << "--tolerance expects a number, not " << text << '\n';
+				options.invalid = true;
+			}
+		}
+		else
+		{
+			continue;
+		}
+		options.consumed.insert(i);
+		options.consumed.insert(++i);
+	}
+	return options;
+}
+
+// Map an input trace with a simulated clock, as fast as possible, and check what comes out against a golden output.
+// Returns 0 if the output matches, 1 if it doesn't and 2 if the replay couldn't run.
+int runReplay(CmdRegistry &commandRegistry, const CommandLineOptions &options, TraceReplay &replay)
+{
+	auto clock = make_shared<SimulatedClock>();
+	mapperClock = clock;
+	jsl->SetCallback(&joyShockPollCallback);
+
+	OutputCapture capture(clock);
+	OutputCapture::setActive(&capture);
+	connectDevices(true);
+	for (auto &config : options.configs)
+	{
+		commandRegistry.loadConfigFile(config);
+	}
+	SettingsManager::publish();
+
+	auto start = chrono::steady_clock::now();
+	size_t recordCount = replay.run(*clock);
+	float seconds = chrono::duration<float>(chrono::steady_clock::now() - start).count();
+	handle_to_joyshock.clear(); // The virtual controllers record into the capture
+	OutputCapture::setActive(nullptr);
+	COUT << "Mapped " << recordCount << " ticks in " << seconds << " seconds\n";
+
+	string capturePath = !options.capture.empty() ? options.capture :
+	  !options.golden.empty()                     ? options.golden + ".actual" :
+	                                                string();
+	if (!capturePath.empty() && !capture.save(capturePath))
+	{
+		return 2;
+	}
+	if (options.golden.empty())
+	{
+		return 0;
+	}
+	stringstream report;
+	bool same = OutputCapture::compare(options.golden, capturePath, options.tolerance, report);
+	if (same)
+	{
+		COUT << report.str();
+		return 0;
+	}
+	CERR << report.str();
+	return 1;
+}
+
 // Perform all cleanup tasks when JSM is exiting
 void cleanUp()
 {
+	// These threads run commands: stop them before the command registry of main() goes away
+	if (autoLoadThread)
+		autoLoadThread->Join();
+	if (autoReloadThread)
+		autoReloadThread->Join();
 	if (tray)
 	{
 		tray->Hide();
 	}
 	HideConsole();
 	jsl->DisconnectAndDisposeAll();
+	setMouseOutputRate(0.f);
+	saveGyroCalibrations();
 	handle_to_joyshock.clear(); // Destroy Vigem Gamepads
 	ReleaseConsole();
 }
@@ -1626,6 +1795,22 @@ float filterTickTime(float c, float next)
 	return max(1.f, min(100.f, round(next)));
 }
 
+float filterReportInterval(float c, float next)
+{
+	// The only intervals the DS4 supports
+	return next <= 1.5f ? 1.f : next <= 3.f ? 2.f : 4.f;
+}
+
+float filterMouseOutputRate(float c, float next)
+{
+	return next <= 0.f ? 0.f : max(125.f, min(8000.f, round(next)));
+}
+
+float filterIdleTickTime(float c, float next)
+{
+	return next <= 0.f ? 0.f : max(10.f, min(1000.f, round(next)));
+}
+
 Mapping filterMapping(Mapping current, Mapping next)
 {
 	auto virtual_controller = SettingsManager::getV<ControllerScheme>(SettingID::VIRTUAL_CONTROLLER);
@@ -1752,8 +1937,11 @@ void updateRingModeFromStickMode(JSMVariable<RingMode> *stickRingMode, const Sti
 	}
 }
 
-ControllerScheme updateVirtualController(ControllerScheme prevScheme, ControllerScheme nextScheme)
+// Recreating the virtual controllers is expensive, so it is done in a deferrable listener rather than in the filter:
+// a batch of commands that changes the scheme several times only recreates them for the final value.
+void updateVirtualController(JSMVariable<ControllerScheme> *virtualController, const ControllerScheme &nextScheme)
 {
+	static ControllerScheme appliedScheme = ControllerScheme::NONE; // Last scheme all controllers got created with
 	string error;
 	bool success = true;
 	for (auto &js : handle_to_joyshock)
@@ -1768,7 +1956,7 @@ ControllerScheme updateVirtualController(ControllerScheme prevScheme, Controller
 			}
 			else
 			{
-				js.second->_context->_vigemController.reset(Gamepad::getNew(nextScheme, bind(&JoyShock::onVirtualControllerNotification, js.second.get(), placeholders::_1, placeholders::_2, placeholders::_3)));
+				js.second->_context->_vigemController.reset(OutputCapture::newGamepad(nextScheme, bind(&JoyShock::onVirtualControllerNotification, js.second.get(), placeholders::_1, placeholders::_2, placeholders::_3)));
 				success &= js.second->_context->_vigemController && js.second->_context->_vigemController->isInitialized(&error);
 				if (!error.empty())
 				{
@@ -1783,7 +1971,15 @@ ControllerScheme updateVirtualController(ControllerScheme prevScheme, Controller
 			}
 		}
 	}
-	return success ? nextScheme : prevScheme;
+	if (success)
+	{
+		appliedScheme = nextScheme;
+	}
+	else
+	{
+		// Notifies this listener again, which brings the controllers back to the previous scheme
+		virtualController->set(appliedScheme);
+	}
 }
 
 void onVirtualControllerChange(const ControllerScheme &newScheme)
@@ -2056,7 +2252,7 @@ public:
 };
 
 // Contains all settings that can be modeshifted. They should be accessed only via Joyshock::getSetting
-void initJsmSettings(CmdRegistry *commandRegistry)
+void initJsmSettings(CmdRegistry *commandRegistry, bool startThreads)
 {
 	auto left_ring_mode = new JSMSetting<RingMode>(SettingID::LEFT_RING_MODE, RingMode::OUTER);
 	left_ring_mode->setFilter(&filterInvalidValue<RingMode, RingMode::INVALID>);
@@ -2460,6 +2656,30 @@ void initJsmSettings(CmdRegistry *commandRegistry)
 	commandRegistry->add((new JSMAssignment<float>("TICK_TIME", *tick_time))
 	                       ->setHelp("Sets the time in milliseconds that JoyShockMaper waits before reading from each controller again."));
 
+	auto device_tick_time = new JSMSetting<Switch>(SettingID::DEVICE_TICK_TIME, Switch::OFF);
+	device_tick_time->setFilter(&filterInvalidValue<Switch, Switch::INVALID>);
+	SettingsManager::add(device_tick_time);
+	commandRegistry->add((new JSMAssignment<Switch>("DEVICE_TICK_TIME", *device_tick_time))
+	                       ->setHelp("When ON, each controller is read as often as it sends reports, instead of every TICK_TIME. Controllers that don't tell their report rate still use TICK_TIME."));
+
+	auto ds4_report_interval = new JSMSetting<float>(SettingID::DS4_REPORT_INTERVAL, 4.f);
+	ds4_report_interval->setFilter(&filterReportInterval);
+	SettingsManager::add(ds4_report_interval);
+	commandRegistry->add((new JSMAssignment<float>("DS4_REPORT_INTERVAL", *ds4_report_interval))
+	                       ->setHelp("Sets the time in milliseconds between the reports a DualShock 4 sends over bluetooth: 1, 2 or 4. Use it with DEVICE_TICK_TIME to read the controller more often."));
+
+	auto mouse_output_rate = new JSMSetting<float>(SettingID::MOUSE_OUTPUT_RATE, 0.f);
+	mouse_output_rate->setFilter(&filterMouseOutputRate)->addOnChangeListener(&setMouseOutputRate);
+	SettingsManager::add(mouse_output_rate);
+	commandRegistry->add((new JSMAssignment<float>("MOUSE_OUTPUT_RATE", *mouse_output_rate))
+	                       ->setHelp("Sets how many times per second the mouse motion of each tick is sent, in even slices, between 125 and 8000. 0 sends it all at once when the controller is read. A key or click sends the motion left first."));
+
+	auto idle_tick_time = new JSMSetting<float>(SettingID::IDLE_TICK_TIME, 0.f);
+	idle_tick_time->setFilter(&filterIdleTickTime);
+	SettingsManager::add(idle_tick_time);
+	commandRegistry->add((new JSMAssignment<float>("IDLE_TICK_TIME", *idle_tick_time))
+	                       ->setHelp("Sets the time in milliseconds between ticks of a controller at rest, between 10 and 1000. The controller is read at full rate again as soon as its input changes. 0 always reads it every TICK_TIME."));
+
 	auto light_bar = new JSMSetting<Color>(SettingID::LIGHT_BAR, 0xFFFFFF);
 	// light_bar needs no filter or listener. The callback polls and updates the color.
 	SettingsManager::add(light_bar);
@@ -2472,19 +2692,26 @@ void initJsmSettings(CmdRegistry *commandRegistry)
 	commandRegistry->add((new JSMAssignment<FloatXY>(*scroll_sens))
 	                       ->setHelp("Scrolling sensitivity for sticks."));
 
-	auto autoloadSwitch = new JSMVariable<Switch>(Switch::ON);
+	// The threads start on, unless a replay needs the input trace to be the only thing mapped
+	auto autoloadSwitch = new JSMVariable<Switch>(startThreads ? Switch::ON : Switch::OFF);
 	autoLoadThread.reset(new JSM::AutoLoad(commandRegistry, autoloadSwitch->value() == Switch::ON)); // Start by default
-	autoloadSwitch->setFilter(&filterInvalidValue<Switch, Switch::INVALID>)->addOnChangeListener(bind(&updateThread, autoLoadThread.get(), placeholders::_1));
+	autoloadSwitch->setFilter(&filterInvalidValue<Switch, Switch::INVALID>)->addOnChangeListener(bind(&updateThread, autoLoadThread.get(), placeholders::_1), false, true);
 	SettingsManager::add(SettingID::AUTOLOAD, autoloadSwitch);
 	auto *autoloadCmd = new JSMAssignment<Switch>("AUTOLOAD", *autoloadSwitch);
 	commandRegistry->add(autoloadCmd);
 
-	auto autoConnectSwitch = new JSMVariable<Switch>(Switch::ON);
+	auto autoConnectSwitch = new JSMVariable<Switch>(startThreads ? Switch::ON : Switch::OFF);
 	autoConnectThread.reset(new JSM::AutoConnect(jsl, autoConnectSwitch->value() == Switch::ON)); // Start by default
-	autoConnectSwitch->setFilter(&filterInvalidValue<Switch, Switch::INVALID>)->addOnChangeListener(bind(&updateThread, autoConnectThread.get(), placeholders::_1));
+	autoConnectSwitch->setFilter(&filterInvalidValue<Switch, Switch::INVALID>)->addOnChangeListener(bind(&updateThread, autoConnectThread.get(), placeholders::_1), false, true);
 	SettingsManager::add(SettingID::AUTOCONNECT, autoConnectSwitch);
 	commandRegistry->add((new JSMAssignment<Switch>("AUTOCONNECT", *autoConnectSwitch))->setHelp("Enable or disable device hotplugging. Valid values are ON and OFF."));
 
+	auto autoReloadSwitch = new JSMVariable<Switch>(startThreads ? Switch::ON : Switch::OFF);
+	autoReloadThread.reset(new JSM::AutoReload(commandRegistry, autoReloadSwitch->value() == Switch::ON)); // Start by default
+	autoReloadSwitch->setFilter(&filterInvalidValue<Switch, Switch::INVALID>)->addOnChangeListener(bind(&updateThread, autoReloadThread.get(), placeholders::_1), false, true);
+	SettingsManager::add(SettingID::AUTORELOAD, autoReloadSwitch);
+	commandRegistry->add((new JSMAssignment<Switch>("AUTORELOAD", *autoReloadSwitch))->setHelp("Apply the assignments that change in the loaded configuration files as soon as they are saved. Valid values are ON and OFF."));
+
 	auto grid_size = new JSMVariable(FloatXY{ 2.f, 1.f });
 	grid_size->setFilter([](auto current, auto next)
 	  {
@@ -2543,14 +2770,15 @@ void initJsmSettings(CmdRegistry *commandRegistry)
 			return true; 
 		}, nullptr, 1000, hide_minimized->value() == Switch::ON)); // Start by default
 	hide_minimized->setFilter(&filterInvalidValue<Switch, Switch::INVALID>);
-	hide_minimized->addOnChangeListener(bind(&updateThread, minimizeThread.get(), placeholders::_1));
+	hide_minimized->addOnChangeListener(bind(&updateThread, minimizeThread.get(), placeholders::_1), false, true);
 	SettingsManager::add(SettingID::HIDE_MINIMIZED, hide_minimized);
 	commandRegistry->add((new JSMAssignment<Switch>("HIDE_MINIMIZED", *hide_minimized))
 	                       ->setHelp("JSM will be hidden in the notification area when minimized if this setting is ON. Otherwise it stays in the taskbar."));
 
 	auto virtual_controller = new JSMVariable<ControllerScheme>(ControllerScheme::NONE);
-	virtual_controller->setFilter(&updateVirtualController);
-	virtual_controller->addOnChangeListener(&onVirtualControllerChange);
+	virtual_controller->setFilter(&filterInvalidValue<ControllerScheme, ControllerScheme::INVALID>);
+	virtual_controller->addOnChangeListener(bind(&updateVirtualController, virtual_controller, placeholders::_1), false, true);
+	virtual_controller->addOnChangeListener(&onVirtualControllerChange, false, true);
 	SettingsManager::add(SettingID::VIRTUAL_CONTROLLER, virtual_controller);
 	commandRegistry->add((new JSMAssignment<ControllerScheme>(magic_enum::enum_name(SettingID::VIRTUAL_CONTROLLER).data(), *virtual_controller))
 	                       ->setHelp("Sets the vigem virtual controller type. Can be NONE (default), XBOX (360) or DS4 (PS4)."));
@@ -2709,7 +2937,7 @@ void initJsmSettings(CmdRegistry *commandRegistry)
 	auto currentWorkingDir = new JSMVariable<PathString>(GetCWD());
 	currentWorkingDir->setFilter([](PathString current, PathString next) -> PathString
 	  { return SetCWD(string(next)) ? next : current; });
-	currentWorkingDir->addOnChangeListener(bind(&refreshAutoLoadHelp, autoloadCmd), true);
+	currentWorkingDir->addOnChangeListener(bind(&refreshAutoLoadHelp, autoloadCmd), true, true);
 	SettingsManager::add(SettingID::JSM_DIRECTORY, currentWorkingDir);
 	commandRegistry->add((new JSMAssignment<PathString>("JSM_DIRECTORY", *currentWorkingDir))
 	                       ->setHelp("If AUTOLOAD doesn't work properly, set this value to the path to the directory holding the JoyShockMapper.exe file. Make sure a folder named \"AutoLoad\" exists there."));
@@ -2754,6 +2982,133 @@ void initJsmSettings(CmdRegistry *commandRegistry)
 
 }
 
+#ifndef _WIN32
+float startupTimeMs = 0.f; // From the start of the process to the main loop
+
+static const char *controllerTypeName(int controllerType)
+{
+	switch (controllerType)
+	{
+	case JS_TYPE_JOYCON_LEFT:
+		return "JOYCON_LEFT";
+	case JS_TYPE_JOYCON_RIGHT:
+		return "JOYCON_RIGHT";
+	case JS_TYPE_PRO_CONTROLLER:
+		return "PRO_CONTROLLER";
+	case JS_TYPE_DS4:
+		return "DS4";
+	case JS_TYPE_DS:
+		return "DS";
+	case JS_TYPE_XBOXONE:
+		return "XBOXONE";
+	case JS_TYPE_XBOXONE_ELITE:
+		return "XBOXONE_ELITE";
+	case JS_TYPE_XBOX_SERIES:
+		return "XBOX_SERIES";
+	default:
+		return "UNKNOWN";
+	}
+}
+
+// Answers the control socket queries, which are not commands of the registry.
+// Returns false if the query is unknown.
+static bool processControlQuery(CmdRegistry &commandRegistry, string_view query, ostream &out)
+{
+	if (query == "?SETTINGS")
+	{
+		// Each setting displays its own current value. Button assignments are bindings, not settings.
+		vector<string_view> names;
+		commandRegistry.GetCommandList(names);
+		names.erase(unique(names.begin(), names.end()), names.end());
+		for (auto name : names)
+		{
+			auto variable = commandRegistry.GetVariable(name);
+			if (variable && !dynamic_cast<const JSMButton *>(variable))
+			{
+				commandRegistry.processLine(string(name));
+			}
+		}
+		return true;
+	}
+	if (query == "?DEVICES")
+	{
+		for (auto &[handle, jc] : handle_to_joyshock)
+		{
+			if (!jc)
+				continue;
+			lock_guard guard(jc->_context->callback_lock);
+			static constexpr const char *splitNames[] = { "NONE", "LEFT", "RIGHT", "FULL" };
+			out << handle << ' ' << controllerTypeName(jc->_controllerType) << ' ' << splitNames[clamp(jc->_splitType, 0, 3)]
+			    << " VIRTUAL_CONTROLLER=" << jc->getSetting<ControllerScheme>(SettingID::VIRTUAL_CONTROLLER)
+			    << " poll_rate=" << jsl->GetPollRate(handle) << " stick_step=" << jsl->GetStickStep(handle)
+			    << " trigger_step=" << jsl->GetTriggerStep(handle) << '\n';
+		}
+		return true;
+	}
+	if (query == "?PROCESS")
+	{
+		out << "startup_ms=" << startupTimeMs << " rss_kb=" << GetResidentMemoryKb() << '\n';
+		return true;
+	}
+	if (query == "?STATS")
+	{
+		// Timings are reset on every query, so clients get the figures of the period since their last one
+		for (auto &[handle, jc] : handle_to_joyshock)
+		{
+			if (!jc)
+				continue;
+			lock_guard guard(jc->_context->callback_lock);
+			auto stats = exchange(jc->_tickStats, {});
+			int ticks = max(stats.ticks, 1);
+			out << handle << " ticks=" << stats.ticks
+			    << " interval_ms=" << stats.totalInterval * 1000.f / ticks << '/' << stats.maxInterval * 1000.f
+			    << " processing_ms=" << stats.totalProcessing * 1000.f / ticks << '/' << stats.maxProcessing * 1000.f << '\n';
+		}
+		return true;
+	}
+	return false;
+}
+
+// Run a batch of lines received from the control socket, one after the other without any other command
+// in between. The response has one status line per line of the batch, "OK <line>" or "ERR <line>",
+// each followed by the output of the line prefixed with "| ". An empty line terminates the response.
+static string processControlBatch(CmdRegistry &commandRegistry, string_view batch)
+{
+	stringstream response;
+	while (!batch.empty())
+	{
+		auto eol = batch.find('\n');
+		string line(batch.substr(0, eol));
+		batch.remove_prefix(eol == string_view::npos ? batch.size() : eol + 1);
+
+		// Only what this thread logs goes to the client: the input thread and the others keep logging to the console
+		stringstream output;
+		bool succeeded = true;
+		Log::setThreadCapture(&output);
+		if (line.starts_with('?'))
+		{
+			succeeded = processControlQuery(commandRegistry, line, output);
+			if (!succeeded)
+				CERR << "Unknown query: " << line << '\n';
+		}
+		else
+		{
+			succeeded = commandRegistry.processLine(line);
+		}
+		Log::setThreadCapture(nullptr);
+
+		response << (succeeded ? "OK " : "ERR ") << line << '\n';
+		for (string text; getline(output, text);)
+		{
+			if (!text.empty())
+				response << "| " << text << '\n';
+		}
+	}
+	response << '\n';
+	return response.str();
+}
+#endif
+
 #ifdef _WIN32
 int __stdcall wWinMain(HINSTANCE hInstance, HINSTANCE prevInstance, LPWSTR cmdLine, int cmdShow)
 {
@@ -2769,25 +3124,36 @@ int __stdcall wWinMain(HINSTANCE hInstance, HINSTANCE prevInstance, LPWSTR cmdLi
 #else
 int main(int argc, char *argv[])
 {
-#if !defined(_WIN32)
-	if (pipe(input_pipe_fd) == -1)
-	{
-		perror("pipe");
-		exit(EXIT_FAILURE);
-	}
-	if (dup2(input_pipe_fd[0], STDIN_FILENO) == -1)
-	{
-		perror("dup2");
-		exit(EXIT_FAILURE);
-	}
-#endif
 	static_cast<void>(argc);
 	static_cast<void>(argv);
 	void *trayIconData = nullptr;
 	string module(argv[0]);
 #endif // _WIN32
-	jsl.reset(JslWrapper::getNew());
-	whitelister.reset(Whitelister::getNew(false));
+	CommandLineOptions commandLine = parseCommandLine(argc, argv);
+	// A replay takes its controllers from the trace and captures what it outputs. It leaves the system alone:
+	// no controller backend, console, command FIFO, control socket, background thread or uinput device.
+	shared_ptr<TraceReplay> replay;
+	if (!commandLine.replayTrace.empty())
+	{
+		InputTrace trace;
+		if (commandLine.invalid || !trace.load(commandLine.replayTrace))
+		{
+#ifdef _WIN32
+			LocalFree(argv);
+#endif
+			return 2;
+		}
+		replay.reset(TraceReplay::getNew(move(trace)));
+	}
+	if (replay)
+	{
+		jsl = replay;
+	}
+	else
+	{
+		jsl.reset(JslWrapper::getNew());
+		whitelister.reset(Whitelister::getNew(false));
+	}
 
 	grid_mappings.reserve(int(ButtonID::T25) - FIRST_TOUCH_BUTTON); // This makes sure the items will never get copied and cause crashes
 	mappings.reserve(MAPPING_SIZE);
@@ -2797,25 +3163,34 @@ int main(int argc, char *argv[])
 		newButton.setFilter(&filterMapping);
 		mappings.push_back(newButton);
 	}
+	// The input thread reads the bindings from the published settings
+	SettingsManager::addButtons(&mappings);
+	SettingsManager::addButtons(&grid_mappings);
 	// console
-	initConsole();
+	if (!commandLine.daemon && !replay)
+	{
+		initConsole();
+	}
 	#ifndef _WIN32
-	// Set up the console to receive commands from the pipe
-	// This is only needed on non-Windows platforms
-	// The pipe is created in the main function
-	// and the console is set up in initConsole()
-	// The pipe is used to receive commands from the console
-	// to the main thread
-	initFifoCommandListener();
+	// Also accept commands written to /tmp/jsm_command_fifo, and batches sent to the control socket.
+	// The console, the FIFO, the socket and signals are all waited on by the main loop.
+	if (!replay)
+	{
+		initFifoCommandListener();
+		initControlSocket();
+	}
 	#endif
 	COUT_BOLD << "Welcome to JoyShockMapper version " << version << "!\n";
 	// if (whitelister) COUT << "JoyShockMapper was successfully whitelisted!\n";
 	//  Threads need to be created before listeners
 	CmdRegistry commandRegistry;
-	initJsmSettings(&commandRegistry);
+	initJsmSettings(&commandRegistry, !replay);
+	SettingsManager::publish();
 
 	for (int i = argc - 1; i >= 0; --i)
 	{
+		if (commandLine.consumed.contains(i))
+			continue;
 #if _WIN32
 		string arg(&argv[i][0], &argv[i][wcslen(argv[i])]);
 #else
@@ -2828,17 +3203,6 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	if (autoLoadThread && autoLoadThread->isRunning())
-	{
-		COUT << "AUTOLOAD is available. Files in ";
-		COUT_INFO << AUTOLOAD_FOLDER();
-		COUT << " folder will get loaded automatically when a matching application is in focus.\n";
-	}
-	else
-	{
-		CERR << "AutoLoad is unavailable\n";
-	}
-
 	// Add all button mappings as commands
 	assert(MAPPING_SIZE == buttonHelpMap.size() && "Please update the button help map in ButtonHelp.cpp");
 	for (auto &mapping : mappings)
@@ -2853,6 +3217,8 @@ int main(int argc, char *argv[])
 
 	// Add Macro commands
 	commandRegistry.add((new JSMMacro("RESET_MAPPINGS"))->SetMacro(bind(&do_RESET_MAPPINGS, &commandRegistry))->setHelp("Delete all custom bindings and reset to default,\nand run script OnReset.txt in JSM_DIRECTORY."));
+	commandRegistry.setStateCapture([]()
+	  { return make_shared<FrozenConfig>(); });
 	commandRegistry.add((new JSMMacro("NO_GYRO_BUTTON"))->SetMacro(bind(&do_NO_GYRO_BUTTON))->setHelp("Enable gyro at all times, without any GYRO_OFF binding."));
 	commandRegistry.add((new JSMMacro("RECONNECT_CONTROLLERS"))->SetMacro(bind(&do_RECONNECT_CONTROLLERS, placeholders::_2, [&commandRegistry]()
 		{
@@ -2892,10 +3258,46 @@ int main(int argc, char *argv[])
 
 	Mapping::_isCommandValid = bind(&CmdRegistry::isCommandValid, &commandRegistry, placeholders::_1);
 
+	if (replay)
+	{
+		int result = runReplay(commandRegistry, commandLine, *replay);
+#ifdef _WIN32
+		LocalFree(argv);
+#endif
+		cleanUp();
+		return result;
+	}
+	if (autoLoadThread && autoLoadThread->isRunning())
+	{
+		COUT << "AUTOLOAD is available. Files in ";
+		COUT_INFO << AUTOLOAD_FOLDER();
+		COUT << " folder will get loaded automatically when a matching application is in focus.\n";
+	}
+	else
+	{
+		CERR << "AutoLoad is unavailable\n";
+	}
+
+	if (!commandLine.recordTrace.empty())
+	{
+		traceRecorder = make_unique<InputTraceRecorder>();
+		if (traceRecorder->open(commandLine.recordTrace))
+		{
+			COUT << "Recording the controller input to " << commandLine.recordTrace << '\n';
+		}
+		else
+		{
+			traceRecorder.reset();
+		}
+	}
+
+	gyroCalibrations.load(string(BASE_JSM_CONFIG_FOLDER()) + "GyroCalibrations.bin");
 	connectDevices();
 	jsl->SetCallback(&joyShockPollCallback);
-	jsl->SetTouchCallback(&touchCallback);
-	tray.reset(TrayIcon::getNew(trayIconData, &beforeShowTrayMenu));
+	if (!commandLine.daemon)
+	{
+		tray.reset(TrayIcon::getNew(trayIconData, &beforeShowTrayMenu));
+	}
 	if (tray)
 	{
 		tray->Show();
@@ -2915,6 +3317,8 @@ int main(int argc, char *argv[])
 
 	for (int i = 0; i < argc; ++i)
 	{
+		if (commandLine.consumed.contains(i))
+			continue;
 #if _WIN32
 		string arg(&argv[i][0], &argv[i][wcslen(argv[i])]);
 #else
@@ -2926,6 +3330,16 @@ int main(int argc, char *argv[])
 			SettingsManager::getV<Switch>(SettingID::AUTOLOAD)->set(Switch::OFF);
 		}
 	}
+	// Everything set up so far becomes visible to the input thread
+	SettingsManager::publish();
+#ifndef _WIN32
+	startupTimeMs = GetProcessAgeMs();
+	if (commandLine.daemon)
+	{
+		COUT << "Running as a daemon. Started in " << startupTimeMs << " ms, using " << GetResidentMemoryKb() << " kB of memory.\n";
+	}
+#endif
+
 	// The main loop is simple and reads like pseudocode
 	string enteredCommand;
 	while (!quit)
@@ -2933,16 +3347,24 @@ int main(int argc, char *argv[])
 		#if _WIN32
 			getline(cin, enteredCommand);
         #else
-			std::unique_lock<std::mutex> lock(commandQueueMutex);
-			commandQueueCV.wait(lock, []{ return !commandQueue.empty(); });
-
-			Command cmd = commandQueue.front();
-			commandQueue.pop();
-			lock.unlock();
-			enteredCommand = cmd.text;
+			Command command = WaitForCommand();
+			if (command.source == CommandSource::SOCKET)
+			{
+				string response;
+				{
+					// The whole batch is published as one settings snapshot, before the client gets its response
+					SettingsManager::Transaction transaction;
+					response = processControlBatch(commandRegistry, command.text);
+				}
+				ReplyToCommand(command, response);
+				continue;
+			}
+			enteredCommand = move(command.text);
         #endif
 		
 
+		// A command may load whole config files: the input thread only sees the result once it's complete
+		SettingsManager::Transaction transaction;
 		commandRegistry.processLine(enteredCommand);
 	}
 #ifdef _WIN32
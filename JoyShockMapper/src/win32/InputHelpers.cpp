@@ -1,6 +1,9 @@
 #include "InputHelpers.h"
+#include "OutputCapture.h"
 #include <thread>
 
+#include <map>
+#include <set>
 #include <unordered_map>
 
 static float accumulatedX = 0;
@@ -58,6 +61,7 @@ unordered_map<WORD, tuple<DWORD, DWORD, DWORD>> mouseMaps = {
 // send mouse button
 int pressMouse(KeyCode vkKey, bool isPressed)
 {
+	flushMouseMove(); // A click lands where the motion before it leads
 	// https://docs.microsoft.com/en-us/windows/win32/api/winuser/ns-winuser-mouseinput
 	auto val = mouseMaps[vkKey.code];
 
@@ -113,11 +117,12 @@ bool isExtendedKey(KeyCode key)
 // send key press
 int pressKey(KeyCode vkKey, bool pressed)
 {
-	if (vkKey.code == 0)
+	if (vkKey.code == 0 || OutputCapture::captureKey(vkKey, pressed))
 		return 0;
 	if (vkKey.code <= V_WHEEL_DOWN) // Highest mouse ID
 		return pressMouse(vkKey, pressed);
 
+	flushMouseMove();
 	INPUT input;
 	memset(&input, 0, sizeof(INPUT));
 	input.type = INPUT_KEYBOARD;
@@ -143,7 +148,7 @@ int pressKey(KeyCode vkKey, bool pressed)
 	return SendInput(1, &input, sizeof(input));
 }
 
-void moveMouse(float x, float y)
+void sendMouseMove(float x, float y)
 {
 	accumulatedX += x;
 	accumulatedY += y;
@@ -154,6 +159,8 @@ void moveMouse(float x, float y)
 	accumulatedX -= applicableX;
 	accumulatedY -= applicableY;
 	//COUT << setprecision(4) << accumulatedX << ' ' << accumulatedY << '\n';
+	if (applicableX == 0 && applicableY == 0)
+		return;
 
 	INPUT input;
 	input.type = INPUT_MOUSE;
@@ -167,6 +174,9 @@ void moveMouse(float x, float y)
 
 void setMouseNorm(float x, float y)
 {
+	if (OutputCapture::captureMouseAbsolute(x, y))
+		return;
+	flushMouseMove();
 	INPUT input;
 	input.type = INPUT_MOUSE;
 	input.mi.mouseData = 0;
@@ -322,6 +332,152 @@ vector<string> ListDirectory(string directory)
 	return fileListing;
 }
 
+// Foreground change notifications are delivered to the thread that installed the hook, while it pumps messages
+static thread_local bool foregroundChanged = false;
+
+static void CALLBACK onForegroundChanged(HWINEVENTHOOK, DWORD, HWND, LONG, LONG, DWORD, DWORD)
+{
+	foregroundChanged = true;
+}
+
+bool WaitForActiveWindowChange(unsigned int timeoutMs)
+{
+	struct Hook
+	{
+		HWINEVENTHOOK handle = SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND, nullptr,
+		  &onForegroundChanged, 0, 0, WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS);
+		~Hook()
+		{
+			if (handle)
+				UnhookWinEvent(handle);
+		}
+	};
+	static thread_local Hook hook;
+	if (!hook.handle)
+	{
+		Sleep(timeoutMs);
+		return true;
+	}
+
+	foregroundChanged = false;
+	auto deadline = GetTickCount64() + timeoutMs;
+	for (auto now = GetTickCount64(); !foregroundChanged && now < deadline; now = GetTickCount64())
+	{
+		MsgWaitForMultipleObjects(0, nullptr, FALSE, DWORD(deadline - now), QS_ALLINPUT);
+		MSG msg;
+		while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
+		{
+			TranslateMessage(&msg);
+			DispatchMessage(&msg);
+		}
+	}
+	return foregroundChanged;
+}
+
+struct DirectoryWatcher::Impl
+{
+	HANDLE handle = INVALID_HANDLE_VALUE;
+};
+
+DirectoryWatcher::DirectoryWatcher(string_view directory)
+  : _impl(make_unique<Impl>())
+{
+	_impl->handle = FindFirstChangeNotificationA(string(directory).c_str(), FALSE, FILE_NOTIFY_CHANGE_FILE_NAME);
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+	if (_impl->handle != INVALID_HANDLE_VALUE)
+	{
+		FindCloseChangeNotification(_impl->handle);
+	}
+}
+
+bool DirectoryWatcher::hasChanged()
+{
+	if (_impl->handle == INVALID_HANDLE_VALUE)
+	{
+		// Not watching anything, so we can't tell
+		return true;
+	}
+	if (WaitForSingleObject(_impl->handle, 0) == WAIT_OBJECT_0)
+	{
+		FindNextChangeNotification(_impl->handle);
+		return true;
+	}
+	return false;
+}
+
+struct FileWatcher::Impl
+{
+	set<string> watched;
+	// Change notification of a directory, with the paths given to watch() for the files in it
+	map<string, pair<HANDLE, vector<string>>> directories;
+};
+
+FileWatcher::FileWatcher()
+  : _impl(make_unique<Impl>())
+{
+}
+
+FileWatcher::~FileWatcher()
+{
+	for (auto &[directory, watch] : _impl->directories)
+	{
+		FindCloseChangeNotification(watch.first);
+	}
+}
+
+void FileWatcher::watch(string_view path)
+{
+	string file(path);
+	if (!_impl->watched.insert(file).second)
+		return;
+	auto slash = file.find_last_of("\\/");
+	string directory = slash == string::npos ? "." : file.substr(0, slash + 1);
+	auto found = _impl->directories.find(directory);
+	if (found == _impl->directories.end())
+	{
+		HANDLE handle = FindFirstChangeNotificationA(directory.c_str(), FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+		if (handle == INVALID_HANDLE_VALUE)
+			return;
+		found = _impl->directories.emplace(directory, make_pair(handle, vector<string>())).first;
+	}
+	found->second.second.push_back(file);
+}
+
+vector<string> FileWatcher::changedFiles()
+{
+	// Notifications don't tell which file changed: report all the files of the directory
+	vector<string> changed;
+	for (auto &[directory, watch] : _impl->directories)
+	{
+		if (WaitForSingleObject(watch.first, 0) == WAIT_OBJECT_0)
+		{
+			FindNextChangeNotification(watch.first);
+			changed.insert(changed.end(), watch.second.begin(), watch.second.end());
+		}
+	}
+	return changed;
+}
+
+bool FileWatcher::wait(unsigned int timeoutMs)
+{
+	vector<HANDLE> handles;
+	for (auto &[directory, watch] : _impl->directories)
+	{
+		if (handles.size() < MAXIMUM_WAIT_OBJECTS)
+			handles.push_back(watch.first);
+	}
+	if (handles.empty())
+	{
+		Sleep(timeoutMs);
+		return false;
+	}
+	DWORD result = WaitForMultipleObjects(DWORD(handles.size()), handles.data(), FALSE, timeoutMs);
+	return result < WAIT_OBJECT_0 + handles.size();
+}
+
 string GetCWD()
 {
 	string cwd(MAX_PATH, '\0');
@@ -0,0 +1,35 @@
+#include "StickCurve.h"
+
+#include <cmath>
+#include <cstdio>
+
+// The stick curves of the usual UNPOWER values, and of their inverses, must use the table and stay within
+// its error bound everywhere, not only at the points setExponent() checks.
+int main()
+{
+	static constexpr float MAX_ERROR = 0.00025f;
+	static constexpr int SAMPLES = 100000;
+	bool passed = true;
+	for (float unpower : { 1.5f, 2.f, 2.5f, 3.f })
+	{
+		for (float exponent : { unpower, 1.f / unpower })
+		{
+			PowerCurve curve;
+			curve.setExponent(exponent);
+			float maxError = 0.f;
+			for (int i = 0; i <= SAMPLES; ++i)
+			{
+				// Evenly spaced in x, and in the roots of x the table uses, which are dense near 0 where the curves are steep
+				float linear = float(i) / SAMPLES;
+				for (float x : { linear, linear * linear, linear * linear * linear * linear })
+				{
+					maxError = max(maxError, abs(curve(x) - pow(x, exponent)));
+				}
+			}
+			bool ok = curve.usesTable() && maxError <= MAX_ERROR;
+			printf("%s exponent %g: %s, largest error %g\n", ok ? "OK " : "ERR", exponent, curve.usesTable() ? "table" : "pow()", maxError);
+			passed &= ok;
+		}
+	}
+	return passed ? 0 : 1;
+}
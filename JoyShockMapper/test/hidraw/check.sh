@@ -0,0 +1,74 @@
+#!/bin/sh
+# Hidraw parser test: feed the report fixtures to JoyShockMapper through JSM_HIDRAW_DEVICES stand-ins,
+# record the parsed input with --record-trace and compare it with the golden trace, times aside.
+# Usage: check.sh <JoyShockMapper> <fixture dir> <actual trace>
+set -e
+JSM=$1
+FIXTURES=$2
+ACTUAL=$3
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+for type in ds4 ds pro; do
+	mkfifo "$WORK/$type"
+done
+rm -f "$ACTUAL"
+JSM_HIDRAW_DEVICES="ds4:$WORK/ds4;ds:$WORK/ds;pro:$WORK/pro" "$JSM" --daemon --record-trace "$ACTUAL" > "$WORK/log" 2>&1 &
+PID=$!
+
+# Opening a FIFO waits for JSM to open the other end
+exec 3> "$WORK/ds4" 4> "$WORK/ds" 5> "$WORK/pro"
+sleep 0.5
+
+# One report per line, sent with its length as a 16 bit little endian number. Each report gets a tick of its own.
+send()
+{
+	grep -v '^#' "$FIXTURES/$1.reports" | while read -r report; do
+		[ -n "$report" ] || continue
+		set -- $report
+		frame=$(printf '\\%03o\\%03o' $(($# & 255)) $(($# >> 8)))
+		for byte in "$@"; do
+			frame="$frame$(printf '\\%03o' "0x$byte")"
+		done
+		printf "$frame"
+		sleep 0.05
+	done
+}
+send ds4 >&3
+send ds >&4
+send pro >&5
+sleep 0.2
+kill -TERM $PID
+wait $PID || true
+exec 3>&- 4>&- 5>&-
+
+awk -v tolerance=0.0001 '
+	function abs(x) { return x < 0 ? -x : x }
+	/^#/ || NF == 0 { next }
+	FNR == NR { golden[++count] = $0; next }
+	{
+		++line
+		if (line > count || NF != split(golden[line], expected))
+		{
+			print "Entry " line ": expected \"" golden[line] "\", got \"" $0 "\""
+			failed = 1
+			next
+		}
+		for (i = ($1 == "DEVICE" ? 1 : 2); i <= NF; ++i)
+		{
+			if ($i != expected[i] && ($1 == "DEVICE" || abs($i - expected[i]) > tolerance))
+			{
+				print "Entry " line ", field " i ": expected " expected[i] ", got " $i
+				failed = 1
+			}
+		}
+	}
+	END {
+		if (line != count)
+		{
+			print "Expected " count " entries, got " line
+			failed = 1
+		}
+		exit failed
+	}' "$FIXTURES/hidraw.golden" "$ACTUAL" || { cat "$WORK/log"; exit 1; }
+echo "The parsed input matches $FIXTURES/hidraw.golden"